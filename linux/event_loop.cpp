@@ -0,0 +1,63 @@
+//
+//  event_loop.cpp
+//  robotcontrold
+//
+
+#include "event_loop.h"
+
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <assert.h>
+#include <system_error>
+
+namespace rbt {
+    CEventLoop::CEventLoop()
+        : m_fdEpoll(epoll_create1(EPOLL_CLOEXEC))
+        , m_bRunning(false)
+    {
+        if(m_fdEpoll < 0) throw std::system_error(errno, std::system_category(), "epoll_create1");
+    }
+    
+    CEventLoop::~CEventLoop() {
+        close(m_fdEpoll);
+    }
+    
+    void CEventLoop::add(int fd, std::function<void()> fnReadable) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if(epoll_ctl(m_fdEpoll, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            throw std::system_error(errno, std::system_category(), "epoll_ctl");
+        }
+        m_mapfdfn[fd] = std::move(fnReadable);
+    }
+    
+    void CEventLoop::remove(int fd) {
+        epoll_ctl(m_fdEpoll, EPOLL_CTL_DEL, fd, nullptr);
+        m_mapfdfn.erase(fd);
+    }
+    
+    void CEventLoop::run() {
+        m_bRunning = true;
+        
+        epoll_event aev[16];
+        while(m_bRunning) {
+            int const cev = epoll_wait(m_fdEpoll, aev, sizeof(aev)/sizeof(aev[0]), -1);
+            if(cev < 0) {
+                if(EINTR==errno) continue;
+                throw std::system_error(errno, std::system_category(), "epoll_wait");
+            }
+            
+            for(int i=0; i<cev && m_bRunning; ++i) {
+                // A previous callback may have removed this fd
+                auto itfdfn = m_mapfdfn.find(aev[i].data.fd);
+                if(itfdfn != m_mapfdfn.end()) {
+                    auto fn = itfdfn->second; // copy, callback may remove itself
+                    fn();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,37 @@
+//
+//  event_loop.h
+//  robotcontrold
+//
+//  Minimal epoll based event loop used by the headless Linux controller.
+//
+
+#ifndef event_loop_h
+#define event_loop_h
+
+#include "../robotcontrol2/nonmoveable.h"
+
+#include <functional>
+#include <unordered_map>
+
+namespace rbt {
+    struct CEventLoop : rbt::nonmoveable {
+        CEventLoop();
+        ~CEventLoop();
+        
+        // fnReadable is called from run() whenever fd becomes readable
+        // or is closed by the other side. Callbacks may add or remove fds.
+        void add(int fd, std::function<void()> fnReadable);
+        void remove(int fd);
+        
+        // Dispatches events until stop() is called
+        void run();
+        void stop() { m_bRunning = false; }
+        
+    private:
+        int m_fdEpoll;
+        bool m_bRunning;
+        std::unordered_map<int, std::function<void()>> m_mapfdfn;
+    };
+}
+
+#endif /* event_loop_h */
@@ -0,0 +1,144 @@
+//
+//  fake_rover.cpp
+//  robotcontrold
+//
+//  Stand-in for the rover firmware. Runs the rover simulator in real time,
+//  sends SSensorPackets at the rate of the real rover and executes the
+//  SRobotCommands it receives. Without a floor plan, the rover drives through
+//  an empty 4m x 3m room.
+//  Reports the round trip time from sending a sensor packet to receiving a command.
+//
+//  Usage: fake_rover unix:<path> | udp:host:port [floor plan image] [cm per pixel]
+//
+
+#include "../robotcontrol2/robot_controller_c.h"
+#include "../robotcontrol2/rover_simulator.h"
+#include "../robotcontrol2/sensor_packet.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+    int Connect(std::string const& strSpec) {
+        if(0==strSpec.compare(0, 5, "unix:")) {
+            int const fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            std::strncpy(addr.sun_path, strSpec.c_str() + 5, sizeof(addr.sun_path) - 1);
+            if(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                close(fd);
+                return -1;
+            }
+            return fd;
+        } else if(0==strSpec.compare(0, 4, "udp:")) {
+            auto const ichPort = strSpec.rfind(':');
+            int const fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(std::stoi(strSpec.substr(ichPort + 1)));
+            if(ichPort<=4
+            || 1!=inet_pton(AF_INET, strSpec.substr(4, ichPort - 4).c_str(), &addr.sin_addr)
+            || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                close(fd);
+                return -1;
+            }
+            return fd;
+        }
+        return -1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2 || 4 < argc) {
+        std::cerr << "Usage: " << argv[0] << " unix:<path> | udp:host:port [floor plan image] [cm per pixel]" << std::endl;
+        return 1;
+    }
+    
+    int const nScale = argc==4 ? std::stoi(argv[3]) : 5;
+    cv::Mat matnFloorPlan;
+    if(argc < 3) {
+        matnFloorPlan = cv::Mat(300 / nScale, 400 / nScale, CV_8UC1, cv::Scalar(255));
+        cv::rectangle(matnFloorPlan, cv::Rect(0, 0, matnFloorPlan.cols, matnFloorPlan.rows), cv::Scalar(0));
+    } else {
+        matnFloorPlan = cv::imread(argv[2], cv::IMREAD_GRAYSCALE);
+        if(matnFloorPlan.empty()) {
+            std::cerr << "Could not read " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+    
+    int const fd = Connect(argv[1]);
+    if(fd < 0) {
+        std::cerr << "Could not connect to " << argv[1] << std::endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    
+    rbt::CRoverSimulator rover(matnFloorPlan, nScale,
+                               rbt::point<double>(matnFloorPlan.cols * nScale / 2.0, matnFloorPlan.rows * nScale / 2.0), 0,
+                               std::random_device()());
+    
+    auto const tStart = std::chrono::steady_clock::now();
+    auto const dtPacket = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(rbt::CRoverSimulator::c_fLoopTime)
+    );
+    auto tNextPacket = tStart;
+    rbt::CSensorPacketBuilder packetbuilder;
+    auto tLastSent = tStart;
+    
+    long long cCommands = 0;
+    double fTotalLatency = 0;
+    double fMaxLatency = 0;
+    
+    for(;;) {
+        auto const tNow = std::chrono::steady_clock::now();
+        if(tNextPacket <= tNow) {
+            auto const data = rover.step();
+            if(packetbuilder.add(data, static_cast<std::uint32_t>(std::llround(rover.time() * 1000000)))) {
+                auto const packet = packetbuilder.pop();
+                ssize_t const cb = sensorPacketSize(packet.m_cReadings);
+                if(cb!=send(fd, &packet, cb, 0)) break;
+                tLastSent = std::chrono::steady_clock::now();
+            }
+            tNextPacket += dtPacket;
+        }
+        
+        pollfd pfd = {fd, POLLIN, 0};
+        auto const nTimeout = std::chrono::duration_cast<std::chrono::milliseconds>(tNextPacket - std::chrono::steady_clock::now()).count();
+        if(0 < poll(&pfd, 1, std::max<int>(0, nTimeout))) {
+            SRobotCommand rcmd;
+            if(sizeof(rcmd)!=recv(fd, &rcmd, sizeof(rcmd), MSG_WAITALL)) break;
+            
+            auto const tReceived = std::chrono::steady_clock::now();
+            double const fLatency = std::chrono::duration<double, std::milli>(tReceived - tLastSent).count();
+            ++cCommands;
+            fTotalLatency += fLatency;
+            fMaxLatency = std::max(fMaxLatency, fLatency);
+            if(0==cCommands%50) {
+                std::cout << cCommands << " commands, round trip avg " << fTotalLatency / cCommands
+                          << " ms, max " << fMaxLatency << " ms" << std::endl;
+            }
+            
+            rover.receivedCommand(rcmd);
+        }
+    }
+    
+    std::cout << "Connection closed" << std::endl;
+    close(fd);
+    return 0;
+}
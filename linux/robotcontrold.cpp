@@ -0,0 +1,201 @@
+//
+//  robotcontrold.cpp
+//  robotcontrold
+//
+//  Headless Linux controller. Receives sensor data from the rover over
+//  one of the transports in transport.h, feeds it to the robot controller's
+//  mapping thread and sends the resulting commands back. The event loop
+//  never waits for map updates.
+//
+//  Usage: robotcontrold <transport> [<state file>]
+//    e.g. robotcontrold serial:/dev/ttyACM0@57600
+//         robotcontrold udp:5000
+//         robotcontrold unix:/tmp/rover.sock /var/lib/robotcontrold/state
+//
+//  With a state file, the controller continues from the state saved there
+//  and saves its state every 10 s, see robot_save_state. If the file exists
+//  but can't be read, robotcontrold exits without overwriting it.
+//
+
+#include "event_loop.h"
+#include "transport.h"
+
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace {
+    char const* c_aszStage[] = {
+        "sensor packet", "arc rasterization", "robot footprint", "erosion",
+        "cost map", "color conversion", "distance transform", "ray scan",
+        "speculative plan", "information gain", "coverage", "sonar filter",
+        "checkpoint"
+    };
+    static_assert(sizeof(c_aszStage)/sizeof(c_aszStage[0])==stage_count, "Missing stage name");
+    
+    void PrintStageStatistics(CRobotController* probot, std::ostream& os) {
+        SRobotStats stats;
+        robot_get_stats(probot, &stats);
+        for(int i=0; i<stage_count; ++i) {
+            auto const& stagestats = stats.m_astage[i];
+            if(0==stagestats.m_cSamples) continue;
+            os << "  " << std::setw(20) << std::left << c_aszStage[i] << std::right
+               << " n " << std::setw(8) << stagestats.m_cSamples
+               << " avg " << std::setw(7) << stagestats.m_nMeanNanoseconds / 1000 << " us"
+               << " p50 " << std::setw(7) << stagestats.m_nP50Nanoseconds / 1000 << " us"
+               << " p99 " << std::setw(7) << stagestats.m_nP99Nanoseconds / 1000 << " us"
+               << " max " << std::setw(7) << stagestats.m_nMaxNanoseconds / 1000 << " us" << std::endl;
+        }
+        os << "  " << stats.m_cCellsTouched << " cells touched, " << stats.m_cRaysWalked << " rays walked, "
+            << stats.m_cArenaOverflows << " arena overflows, " << stats.m_cMapScrolls << " map scrolls, "
+            << stats.m_cTilesDecayed << " tiles decayed, " << stats.m_cReadingsRejected << " readings rejected, "
+            << stats.m_cSpeculativeHits << " of " << stats.m_cSpeculativePlans << " speculative targets used" << std::endl;
+    }
+    
+    // Time between receiving a sensor data record and having written the
+    // resulting command to the transport. Commands are attributed to
+    // the most recent sensor data record.
+    struct SLatencyStatistics {
+        void add(std::chrono::steady_clock::duration dt) {
+            long long const nMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(dt).count();
+            ++m_cCommands;
+            m_nTotalMicroseconds += nMicroseconds;
+            m_nMaxMicroseconds = std::max(m_nMaxMicroseconds, nMicroseconds);
+        }
+        
+        void print(std::ostream& os) {
+            os << m_cPackets << " packets, " << m_cReadings << " sonar readings, " << m_cOverflows << " merged, " << m_cCommands << " commands";
+            if(0<m_cCommands) {
+                os << ", latency avg " << m_nTotalMicroseconds / m_cCommands << " us"
+                   << ", max " << m_nMaxMicroseconds << " us";
+            }
+            os << std::endl;
+        }
+        
+        long long m_cPackets = 0;
+        long long m_cReadings = 0;
+        long long m_cOverflows = 0;
+        long long m_cCommands = 0;
+        long long m_nTotalMicroseconds = 0;
+        long long m_nMaxMicroseconds = 0;
+    };
+}
+
+int main(int argc, char* argv[]) {
+    if(argc!=2 && argc!=3) {
+        std::cerr << "Usage: " << argv[0] << " serial:<device>[@baud] | udp:[host:]port | unix:<path> [<state file>]" << std::endl;
+        return 1;
+    }
+    
+    try {
+        rbt::CEventLoop evloop;
+        auto ptransport = rbt::MakeTransport(argv[1]);
+        
+        // Shut down cleanly on SIGINT and SIGTERM.
+        // Block the signals before the mapping thread is started, so it inherits the mask.
+        sigset_t sigset;
+        sigemptyset(&sigset);
+        sigaddset(&sigset, SIGINT);
+        sigaddset(&sigset, SIGTERM);
+        sigprocmask(SIG_BLOCK, &sigset, nullptr);
+        int const fdSignal = signalfd(-1, &sigset, SFD_NONBLOCK | SFD_CLOEXEC);
+        if(fdSignal < 0) throw std::system_error(errno, std::system_category(), "signalfd");
+        evloop.add(fdSignal, [&] { evloop.stop(); });
+        
+        char const* szState = 3==argc ? argv[2] : nullptr;
+        std::unique_ptr<CRobotController, decltype(&robot_delete_controller)> probot(
+            szState ? robot_load_state(szState) : nullptr, robot_delete_controller);
+        if(probot) {
+            std::cout << "Continuing from " << szState << std::endl;
+        } else {
+            // Don't overwrite a checkpoint that exists but can't be read, e.g., from another map size
+            if(szState && 0==access(szState, F_OK)) throw std::runtime_error(std::string("Could not read state file ") + szState);
+            probot.reset(robot_new_controller(400, 400, /*nScale*/5)); // = Map of 20m x 20m map
+        }
+        SLatencyStatistics stats;
+        auto tReceived = std::chrono::steady_clock::now();
+        
+        // The mapping thread signals new commands through an eventfd
+        int fdCommand = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(fdCommand < 0) throw std::system_error(errno, std::system_category(), "eventfd");
+        robot_start_mapping_thread(probot.get(), [](void* pvContext) {
+            std::uint64_t const n = 1;
+            ssize_t cb;
+            do {
+                cb = write(*static_cast<int const*>(pvContext), &n, sizeof(n));
+            } while(cb < 0 && EINTR==errno);
+            // EAGAIN means the counter is saturated, so the event loop is woken up anyway
+            if(cb < 0 && EAGAIN!=errno) {
+                std::cerr << "Command notification failed: " << std::system_category().message(errno) << std::endl;
+            }
+        }, &fdCommand);
+        
+        evloop.add(fdCommand, [&] {
+            std::uint64_t n;
+            ssize_t cb;
+            do {
+                cb = read(fdCommand, &n, sizeof(n));
+            } while(cb < 0 && EINTR==errno);
+            // EAGAIN means another wakeup already reset the counter, poll anyway
+            if(cb < 0 && EAGAIN!=errno) {
+                std::cerr << "Command notification failed: " << std::system_category().message(errno) << std::endl;
+            }
+            
+            SRobotCommand rcmd;
+            while(robot_poll_command(probot.get(), &rcmd)) {
+                if(ptransport->send(rcmd)) {
+                    stats.add(std::chrono::steady_clock::now() - tReceived);
+                } else {
+                    std::cerr << "Could not send command" << std::endl;
+                }
+            }
+        });
+        
+        ptransport->attach(evloop, [&](SSensorPacket const& packet) {
+            tReceived = std::chrono::steady_clock::now();
+            ++stats.m_cPackets;
+            stats.m_cReadings += packet.m_cReadings;
+            if(!robot_post_sensor_packet(probot.get(), &packet, sensorPacketSize(packet.m_cReadings))) ++stats.m_cOverflows;
+        });
+        
+        // Print statistics and save the state every 10 s
+        int const fdTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if(fdTimer < 0) throw std::system_error(errno, std::system_category(), "timerfd_create");
+        itimerspec its = {{10, 0}, {10, 0}};
+        if(timerfd_settime(fdTimer, 0, &its, nullptr) < 0) throw std::system_error(errno, std::system_category(), "timerfd_settime");
+        evloop.add(fdTimer, [&] {
+            std::uint64_t cExpirations;
+            if(sizeof(cExpirations)==read(fdTimer, &cExpirations, sizeof(cExpirations))) {
+                stats.print(std::cout);
+                PrintStageStatistics(probot.get(), std::cout);
+                if(szState) robot_save_state(probot.get(), szState);
+            }
+        });
+        
+        std::cout << "Waiting for rover on " << argv[1] << std::endl;
+        evloop.run();
+        
+        stats.print(std::cout);
+        PrintStageStatistics(probot.get(), std::cout);
+        probot.reset();
+        close(fdCommand);
+        close(fdTimer);
+        close(fdSignal);
+    } catch(std::exception const& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+//
+//  simulate.cpp
+//  robotcontrold
+//
+//  Runs the robot controller against the rover simulator as fast as possible
+//  and reports map building throughput, CPU time and heap allocations per sensor packet.
+//  Fails if the controller still allocates from the heap once it has warmed up.
+//
+//  Usage: simulate <floor plan image> [options]
+//    --scale <cm per pixel>   floor plan resolution (default 5)
+//    --start <x>,<y>          start position in cm (default center of floor plan)
+//    --minutes <n>            simulated mission time (default 10)
+//    --seed <n>               random seed of the simulator (default 1)
+//    --grid <w>,<h>,<scale>   size and resolution of the controller's map (default 400,400,5)
+//    --scrolling <0|1>        map follows the robot (default 0)
+//    --map <file>             write final greyscale map to file
+//
+
+#include "../robotcontrol2/robot_controller_c.h"
+#include "../robotcontrol2/rover_simulator.h"
+#include "../robotcontrol2/sensor_packet.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+namespace {
+    // Heap allocations of all threads. operator new, cv::fastMalloc and the C library
+    // all end up in the functions below.
+    std::atomic<long long> g_cAllocations{0};
+    
+    void CountAllocation() {
+        g_cAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Replaces the allocation functions of glibc, which keeps the originals available as __libc_*
+extern "C" {
+    void* __libc_malloc(size_t cb);
+    void* __libc_calloc(size_t c, size_t cb);
+    void* __libc_realloc(void* pv, size_t cb);
+    void* __libc_memalign(size_t cbAlign, size_t cb);
+    void __libc_free(void* pv);
+    
+    void* malloc(size_t cb) {
+        CountAllocation();
+        return __libc_malloc(cb);
+    }
+    
+    void* calloc(size_t c, size_t cb) {
+        CountAllocation();
+        return __libc_calloc(c, cb);
+    }
+    
+    void* realloc(void* pv, size_t cb) {
+        CountAllocation();
+        return __libc_realloc(pv, cb);
+    }
+    
+    void* memalign(size_t cbAlign, size_t cb) {
+        CountAllocation();
+        return __libc_memalign(cbAlign, cb);
+    }
+    
+    void* aligned_alloc(size_t cbAlign, size_t cb) {
+        return memalign(cbAlign, cb);
+    }
+    
+    int posix_memalign(void** ppv, size_t cbAlign, size_t cb) {
+        *ppv = memalign(cbAlign, cb);
+        return *ppv ? 0 : ENOMEM;
+    }
+    
+    void free(void* pv) {
+        __libc_free(pv);
+    }
+}
+
+namespace {
+    double ThreadCpuMicroseconds() {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+    }
+    
+    // Area of all cells that are no longer unknown, in m^2
+    double MappedArea(CRobotController* probot) {
+        auto const bitmap = robot_get_map(probot, greyscale);
+        size_t cKnown = 0;
+        for(size_t y = 0; y < bitmap.m_nHeight; ++y) {
+            auto const* pb = bitmap.m_pbImage + y * bitmap.m_cbBytesPerRow;
+            cKnown += std::count_if(pb, pb + bitmap.m_nWidth, [](unsigned char b) { return b!=128; });
+        }
+        return cKnown * bitmap.m_nScale * bitmap.m_nScale / 10000.0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <floor plan> [--scale n] [--start x,y] [--minutes n] [--seed n] [--grid w,h,scale] [--scrolling 0|1] [--map file]" << std::endl;
+        return 1;
+    }
+    
+    auto const matnFloorPlan = cv::imread(argv[1], cv::IMREAD_GRAYSCALE);
+    if(matnFloorPlan.empty()) {
+        std::cerr << "Could not read " << argv[1] << std::endl;
+        return 1;
+    }
+    
+    int nScale = 5;
+    rbt::point<double> ptfStart = rbt::point<double>::invalid();
+    double fMinutes = 10;
+    unsigned int nSeed = 1;
+    int anGrid[] = {400, 400, 5};
+    bool bScrolling = false;
+    char const* szMap = nullptr;
+    for(int i = 2; i + 1 < argc; i += 2) {
+        if(0==std::strcmp(argv[i], "--scale")) nScale = std::stoi(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--start")) {
+            std::string const str(argv[i+1]);
+            auto const ichComma = str.find(',');
+            ptfStart = rbt::point<double>(std::stod(str.substr(0, ichComma)), std::stod(str.substr(ichComma + 1)));
+        }
+        else if(0==std::strcmp(argv[i], "--minutes")) fMinutes = std::stod(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--seed")) nSeed = std::stoul(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--grid")) {
+            if(3!=std::sscanf(argv[i+1], "%d,%d,%d", &anGrid[0], &anGrid[1], &anGrid[2])) {
+                std::cerr << "Invalid grid " << argv[i+1] << std::endl;
+                return 1;
+            }
+        }
+        else if(0==std::strcmp(argv[i], "--scrolling")) bScrolling = 0!=std::stoi(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--map")) szMap = argv[i+1];
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if(rbt::point<double>::invalid()==ptfStart) {
+        ptfStart = rbt::point<double>(matnFloorPlan.cols * nScale / 2.0, matnFloorPlan.rows * nScale / 2.0);
+    }
+    
+    rbt::CRoverSimulator sim(matnFloorPlan, nScale, ptfStart, 0, nSeed);
+    rbt::CSensorPacketBuilder packetbuilder;
+    auto* probot = bScrolling
+        ? robot_new_scrolling_controller(anGrid[0], anGrid[1], anGrid[2])
+        : robot_new_controller(anGrid[0], anGrid[1], anGrid[2]);
+    if(!probot) {
+        std::cerr << "Invalid grid " << anGrid[0] << "," << anGrid[1] << "," << anGrid[2] << std::endl;
+        return 1;
+    }
+    
+    long long cPackets = 0;
+    double fCpuTotal = 0;
+    double fCpuMax = 0;
+    
+    // Steady state starts after the warm-up of the controller and the first 360 degree turn
+    double const fSteadyState = 60;
+    long long cPacketsSteadyState = 0;
+    long long cAllocationsSteadyState = 0;
+    
+    auto const tStart = std::chrono::steady_clock::now();
+    double fNextReport = 60;
+    while(sim.time() < fMinutes * 60) {
+        auto const data = sim.step();
+        if(!packetbuilder.add(data, static_cast<std::uint32_t>(std::llround(sim.time() * 1000000)))) continue;
+        auto const packet = packetbuilder.pop();
+        
+        SRobotCommand rcmd;
+        bool bSend = false;
+        double const fCpuStart = ThreadCpuMicroseconds();
+        auto const cAllocationsStart = g_cAllocations.load(std::memory_order_relaxed);
+        robot_received_sensor_packet(probot, &packet, sensorPacketSize(packet.m_cReadings), &rcmd, &bSend);
+        auto const cAllocations = g_cAllocations.load(std::memory_order_relaxed) - cAllocationsStart;
+        double const fCpu = ThreadCpuMicroseconds() - fCpuStart;
+        
+        if(fSteadyState <= sim.time()) {
+            ++cPacketsSteadyState;
+            cAllocationsSteadyState += cAllocations;
+        }
+        ++cPackets;
+        fCpuTotal += fCpu;
+        fCpuMax = std::max(fCpuMax, fCpu);
+        
+        if(bSend) sim.receivedCommand(rcmd);
+        
+        if(fNextReport <= sim.time()) {
+            std::cout << std::fixed << std::setprecision(2)
+                << "t = " << sim.time() / 60 << " min"
+                << ", mapped " << MappedArea(probot) << " m^2"
+                << ", collisions " << sim.collisions() << std::endl;
+            fNextReport += 60;
+        }
+    }
+    double const fWallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+    double const fMapped = MappedArea(probot);
+    
+    std::cout << std::fixed << std::setprecision(2)
+        << "Mapped " << fMapped << " m^2 in " << sim.time() / 60 << " simulated minutes"
+        << " = " << fMapped / (sim.time() / 60) << " m^2/min" << std::endl
+        << cPackets << " packets, CPU per packet avg " << fCpuTotal / cPackets << " us, max " << fCpuMax << " us" << std::endl
+        << "Heap allocations per packet after " << fSteadyState << " s: "
+        << static_cast<double>(cAllocationsSteadyState) / std::max(1LL, cPacketsSteadyState) << std::endl
+        << "Simulation ran " << sim.time() / fWallSeconds << "x faster than real time" << std::endl;
+    
+    if(szMap) {
+        auto const bitmap = robot_get_map(probot, greyscale);
+        cv::imwrite(szMap, cv::Mat(bitmap.m_nHeight, bitmap.m_nWidth, CV_8UC1, bitmap.m_pbImage, bitmap.m_cbBytesPerRow));
+    }
+    robot_delete_controller(probot);
+    
+    if(0 < cAllocationsSteadyState) {
+        std::cerr << cAllocationsSteadyState << " heap allocations after " << fSteadyState << " s, expected none" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+//
+//  spsc_queue_test.cpp
+//  robotcontrold
+//
+//  Stress test of CSpscQueue. A producer thread pushes increasing sequence numbers
+//  as fast as it can while the consumer pops them, so the queue overflows constantly.
+//  Fails if the consumer ever pops an element that is not newer than the previous one,
+//  a torn element, or, with overflow_policy::coalesce, not the last element pushed.
+//
+//  Usage: spsc_queue_test [rounds]
+//
+
+#include "../robotcontrol2/spsc_queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+namespace {
+    struct SElement {
+        std::uint64_t m_nSequence;
+        std::uint64_t m_nCheck; // ~m_nSequence, detects torn copies
+        std::uint64_t m_cCoalesced;
+    };
+    
+    template<std::size_t N>
+    bool Run(rbt::overflow_policy epolicy, std::uint64_t cElements) {
+        rbt::CSpscQueue<SElement, N> queue(epolicy, [](SElement& elemInto, SElement const& elem) {
+            elemInto = {elem.m_nSequence, elem.m_nCheck, elemInto.m_cCoalesced + 1};
+        });
+        
+        std::atomic<bool> bDone{false};
+        std::thread threadProducer([&] {
+            for(std::uint64_t n = 1; n <= cElements; ++n) queue.push(SElement{n, ~n, 0});
+            bDone = true;
+        });
+        
+        std::uint64_t nLast = 0;
+        bool bOk = true;
+        for(;;) {
+            bool const bProducerDone = bDone; // read before pop, so nothing is pushed after the last empty pop
+            SElement elem;
+            if(queue.pop(elem)) {
+                if(elem.m_nSequence <= nLast || elem.m_nCheck != ~elem.m_nSequence) {
+                    std::cout << "FAILED: popped " << elem.m_nSequence << " after " << nLast << std::endl;
+                    bOk = false;
+                    break;
+                }
+                nLast = elem.m_nSequence;
+            } else if(bProducerDone) {
+                break;
+            }
+        }
+        threadProducer.join();
+        
+        if(bOk && rbt::overflow_policy::coalesce == epolicy && nLast != cElements) {
+            std::cout << "FAILED: last element " << cElements << " lost, popped " << nLast << std::endl;
+            bOk = false;
+        }
+        return bOk;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int const cRounds = 2 <= argc ? std::atoi(argv[1]) : 200;
+    std::uint64_t const cElements = 100000;
+    for(int i = 0; i < cRounds; ++i) {
+        if(!Run<1>(rbt::overflow_policy::coalesce, cElements)
+        || !Run<4>(rbt::overflow_policy::coalesce, cElements)
+        || !Run<64>(rbt::overflow_policy::coalesce, cElements)
+        || !Run<4>(rbt::overflow_policy::drop_oldest, cElements)) {
+            return 1;
+        }
+    }
+    std::cout << "Passed " << cRounds << " rounds" << std::endl;
+    return 0;
+}
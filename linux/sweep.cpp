@@ -0,0 +1,258 @@
+//
+//  sweep.cpp
+//  robotcontrold
+//
+//  Runs the robot controller against the rover simulator for every combination
+//  of the given tuning constants, in parallel on all cores, and ranks the combinations
+//  by map accuracy against the floor plan. The controllers plan their next targets
+//  synchronously instead of on a background thread, so the maps and scores of each run
+//  only depend on the parameters and the seed. Only the CPU time per packet, which
+//  breaks ties, varies between sweeps.
+//
+//  Usage: sweep <floor plan image> [options] [parameters]
+//    --scale <cm per pixel>   floor plan resolution (default 5)
+//    --start <x>,<y>          start position in cm (default center of floor plan)
+//    --minutes <n>            simulated mission time per run (default 10)
+//    --seed <n>               random seed of the simulator (default 1)
+//    --grid <w>,<h>,<scale>   size and resolution of the controller's map (default 400,400,5)
+//    --jobs <n>               parallel runs (default number of cores)
+//    --top <n>                number of combinations to report (default 20)
+//
+//  Parameters are comma-separated lists of values, see SRobotParameters. Defaults are
+//  robot_default_parameters().
+//    --tolerance <cm,...>     m_fSonarDistanceTolerance
+//    --free <log-odds,...>    m_fLogOddsFree
+//    --occupied <log-odds,...>  m_fLogOddsOccupied
+//    --threshold <p,...>      m_nFreeThreshold as a fraction of 255, e.g., 0.4
+//    --exploration <cm,...>   m_nMaxExplorationDistance
+//    --visited <factor,...>   m_fExplorationDistanceTolerance
+//
+
+#include "../robotcontrol2/robot_controller_c.h"
+#include "../robotcontrol2/rover_simulator.h"
+#include "../robotcontrol2/sensor_packet.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Covers all work of a controller, it plans on the calling thread
+    double ThreadCpuMicroseconds() {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+    }
+    
+    std::vector<double> ParseList(char const* sz) {
+        std::vector<double> vecf;
+        std::stringstream ss(sz);
+        std::string str;
+        while(std::getline(ss, str, ',')) vecf.push_back(std::stod(str));
+        return vecf;
+    }
+    
+    struct SRun {
+        SRobotParameters m_params;
+        double m_fCorrect = 0; // m^2 of known cells classified like the floor plan
+        double m_fWrong = 0; // m^2 of known cells classified differently
+        double m_fCpuPerPacket = 0; // us
+        int m_cCollisions = 0;
+        
+        double score() const { return m_fCorrect - m_fWrong; }
+    };
+    
+    struct SSetup {
+        cv::Mat m_matnFloorPlan;
+        int m_nScale;
+        rbt::point<double> m_ptfStart;
+        double m_fMinutes;
+        unsigned int m_nSeed;
+        int m_anGrid[3];
+    };
+    
+    // Compares the known cells of the controller's map with the floor plan. The controller's
+    // world coordinates are relative to the start position, yaw 0 is the same in both.
+    void CompareWithFloorPlan(SSetup const& setup, CRobotController* probot, SRun& run) {
+        auto const bitmap = robot_get_map(probot, greyscale);
+        double const fCellArea = bitmap.m_nScale * bitmap.m_nScale / 10000.0;
+        for(size_t y = 0; y < bitmap.m_nHeight; ++y) {
+            auto const* pb = bitmap.m_pbImage + y * bitmap.m_cbBytesPerRow;
+            for(size_t x = 0; x < bitmap.m_nWidth; ++x) {
+                if(128==pb[x]) continue;
+                
+                auto const fX = bitmap.m_nCenterX + (static_cast<double>(x) - bitmap.m_nWidth / 2.0) * bitmap.m_nScale + setup.m_ptfStart.x;
+                auto const fY = bitmap.m_nCenterY + (static_cast<double>(y) - bitmap.m_nHeight / 2.0) * bitmap.m_nScale + setup.m_ptfStart.y;
+                int const xPlan = static_cast<int>(std::floor(fX / setup.m_nScale));
+                int const yPlan = static_cast<int>(std::floor(fY / setup.m_nScale));
+                bool const bObstaclePlan = xPlan < 0 || setup.m_matnFloorPlan.cols <= xPlan || yPlan < 0 || setup.m_matnFloorPlan.rows <= yPlan
+                    || setup.m_matnFloorPlan.at<std::uint8_t>(yPlan, xPlan) < 128;
+                bool const bObstacle = pb[x] < run.m_params.m_nFreeThreshold;
+                (bObstacle==bObstaclePlan ? run.m_fCorrect : run.m_fWrong) += fCellArea;
+            }
+        }
+    }
+    
+    void Simulate(SSetup const& setup, SRun& run) {
+        rbt::CRoverSimulator sim(setup.m_matnFloorPlan, setup.m_nScale, setup.m_ptfStart, 0, setup.m_nSeed);
+        rbt::CSensorPacketBuilder packetbuilder;
+        auto* probot = robot_new_tuned_controller(setup.m_anGrid[0], setup.m_anGrid[1], setup.m_anGrid[2], false, run.m_params, /*bSynchronousPlanning*/true);
+        
+        long long cPackets = 0;
+        double fCpuTotal = 0;
+        while(sim.time() < setup.m_fMinutes * 60) {
+            auto const data = sim.step();
+            if(!packetbuilder.add(data, static_cast<std::uint32_t>(std::llround(sim.time() * 1000000)))) continue;
+            auto const packet = packetbuilder.pop();
+            
+            SRobotCommand rcmd;
+            bool bSend = false;
+            double const fCpuStart = ThreadCpuMicroseconds();
+            robot_received_sensor_packet(probot, &packet, sensorPacketSize(packet.m_cReadings), &rcmd, &bSend);
+            fCpuTotal += ThreadCpuMicroseconds() - fCpuStart;
+            ++cPackets;
+            
+            if(bSend) sim.receivedCommand(rcmd);
+        }
+        
+        run.m_fCpuPerPacket = fCpuTotal / std::max(1LL, cPackets);
+        run.m_cCollisions = sim.collisions();
+        CompareWithFloorPlan(setup, probot, run);
+        robot_delete_controller(probot);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <floor plan> [--scale n] [--start x,y] [--minutes n] [--seed n] [--grid w,h,scale] [--jobs n] [--top n]"
+            " [--tolerance cm,...] [--free log-odds,...] [--occupied log-odds,...] [--threshold p,...] [--exploration cm,...] [--visited factor,...]" << std::endl;
+        return 1;
+    }
+    
+    SSetup setup{cv::imread(argv[1], cv::IMREAD_GRAYSCALE), 5, rbt::point<double>::invalid(), 10, 1, {400, 400, 5}};
+    if(setup.m_matnFloorPlan.empty()) {
+        std::cerr << "Could not read " << argv[1] << std::endl;
+        return 1;
+    }
+    
+    auto const paramsDefault = robot_default_parameters();
+    std::vector<double> vecfTolerance{paramsDefault.m_fSonarDistanceTolerance};
+    std::vector<double> vecfFree{paramsDefault.m_fLogOddsFree};
+    std::vector<double> vecfOccupied{paramsDefault.m_fLogOddsOccupied};
+    std::vector<double> vecfThreshold{paramsDefault.m_nFreeThreshold / 255.0};
+    std::vector<double> vecfExploration{static_cast<double>(paramsDefault.m_nMaxExplorationDistance)};
+    std::vector<double> vecfVisited{paramsDefault.m_fExplorationDistanceTolerance};
+    int cJobs = std::max(1u, std::thread::hardware_concurrency());
+    int cTop = 20;
+    for(int i = 2; i + 1 < argc; i += 2) {
+        if(0==std::strcmp(argv[i], "--scale")) setup.m_nScale = std::stoi(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--start")) {
+            std::string const str(argv[i+1]);
+            auto const ichComma = str.find(',');
+            setup.m_ptfStart = rbt::point<double>(std::stod(str.substr(0, ichComma)), std::stod(str.substr(ichComma + 1)));
+        }
+        else if(0==std::strcmp(argv[i], "--minutes")) setup.m_fMinutes = std::stod(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--seed")) setup.m_nSeed = std::stoul(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--grid")) {
+            if(3!=std::sscanf(argv[i+1], "%d,%d,%d", &setup.m_anGrid[0], &setup.m_anGrid[1], &setup.m_anGrid[2])) {
+                std::cerr << "Invalid grid " << argv[i+1] << std::endl;
+                return 1;
+            }
+        }
+        else if(0==std::strcmp(argv[i], "--jobs")) cJobs = std::max(1, std::stoi(argv[i+1]));
+        else if(0==std::strcmp(argv[i], "--top")) cTop = std::stoi(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--tolerance")) vecfTolerance = ParseList(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--free")) vecfFree = ParseList(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--occupied")) vecfOccupied = ParseList(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--threshold")) vecfThreshold = ParseList(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--exploration")) vecfExploration = ParseList(argv[i+1]);
+        else if(0==std::strcmp(argv[i], "--visited")) vecfVisited = ParseList(argv[i+1]);
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if(rbt::point<double>::invalid()==setup.m_ptfStart) {
+        setup.m_ptfStart = rbt::point<double>(setup.m_matnFloorPlan.cols * setup.m_nScale / 2.0, setup.m_matnFloorPlan.rows * setup.m_nScale / 2.0);
+    }
+    
+    // The size of a fixed map doesn't depend on the parameters, check it before starting the workers
+    if(auto* probot = robot_new_tuned_controller(setup.m_anGrid[0], setup.m_anGrid[1], setup.m_anGrid[2], false, paramsDefault, true)) {
+        robot_delete_controller(probot);
+    } else {
+        std::cerr << "Invalid grid " << setup.m_anGrid[0] << "," << setup.m_anGrid[1] << "," << setup.m_anGrid[2] << std::endl;
+        return 1;
+    }
+    
+    std::vector<SRun> vecrun;
+    for(double fTolerance : vecfTolerance) {
+        for(double fFree : vecfFree) {
+            for(double fOccupied : vecfOccupied) {
+                for(double fThreshold : vecfThreshold) {
+                    for(double fExploration : vecfExploration) {
+                        for(double fVisited : vecfVisited) {
+                            SRun run;
+                            run.m_params = {
+                                fTolerance,
+                                fFree,
+                                fOccupied,
+                                static_cast<unsigned char>(std::lround(std::min(std::max(fThreshold, 0.0), 1.0) * 255)),
+                                static_cast<int>(std::lround(fExploration)),
+                                fVisited
+                            };
+                            vecrun.push_back(run);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    // Controllers don't share state, so every worker simulates whole runs on its own
+    std::cout << "Simulating " << vecrun.size() << " combinations on " << cJobs << " threads" << std::endl;
+    std::atomic<std::size_t> iRunNext{0};
+    std::vector<std::thread> vecthread;
+    for(int i = 0; i < cJobs; ++i) {
+        vecthread.emplace_back([&] {
+            for(auto iRun = iRunNext++; iRun < vecrun.size(); iRun = iRunNext++) {
+                Simulate(setup, vecrun[iRun]);
+            }
+        });
+    }
+    for(auto& thread : vecthread) thread.join();
+    
+    std::stable_sort(vecrun.begin(), vecrun.end(), [](SRun const& lhs, SRun const& rhs) {
+        return lhs.score() > rhs.score() || (lhs.score() == rhs.score() && lhs.m_fCpuPerPacket < rhs.m_fCpuPerPacket);
+    });
+    
+    // Score is the correctly minus the wrongly mapped area, so both mapping more and mapping correctly count
+    std::cout << "rank  score m^2  correct  wrong  cpu us  coll  tolerance   free  occupied  threshold  exploration  visited" << std::endl;
+    for(int i = 0; i < std::min(cTop, static_cast<int>(vecrun.size())); ++i) {
+        auto const& run = vecrun[i];
+        std::cout << std::fixed << std::setprecision(2)
+            << std::setw(4) << i + 1
+            << std::setw(11) << run.score()
+            << std::setw(9) << run.m_fCorrect
+            << std::setw(7) << run.m_fWrong
+            << std::setw(8) << run.m_fCpuPerPacket
+            << std::setw(6) << run.m_cCollisions
+            << std::setw(11) << run.m_params.m_fSonarDistanceTolerance
+            << std::setw(7) << run.m_params.m_fLogOddsFree
+            << std::setw(10) << run.m_params.m_fLogOddsOccupied
+            << std::setw(11) << run.m_params.m_nFreeThreshold / 255.0
+            << std::setw(13) << run.m_params.m_nMaxExplorationDistance
+            << std::setw(9) << run.m_params.m_fExplorationDistanceTolerance << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+//
+//  transport.cpp
+//  robotcontrold
+//
+
+#include "transport.h"
+
+#include <stdexcept>
+
+namespace rbt {
+    std::unique_ptr<ITransport> MakeTransport(std::string const& strSpec) {
+        auto const ichColon = strSpec.find(':');
+        if(std::string::npos==ichColon) {
+            throw std::runtime_error("Invalid transport " + strSpec);
+        }
+        
+        auto const strScheme = strSpec.substr(0, ichColon);
+        auto const strArg = strSpec.substr(ichColon + 1);
+        
+        if("serial"==strScheme) {
+            auto const ichAt = strArg.rfind('@');
+            if(std::string::npos==ichAt) {
+                return MakeSerialTransport(strArg, 57600);
+            } else {
+                return MakeSerialTransport(strArg.substr(0, ichAt), std::stoi(strArg.substr(ichAt + 1)));
+            }
+        } else if("udp"==strScheme) {
+            auto const ichPort = strArg.rfind(':');
+            if(std::string::npos==ichPort) {
+                return MakeUdpTransport("0.0.0.0", std::stoi(strArg));
+            } else {
+                return MakeUdpTransport(strArg.substr(0, ichPort), std::stoi(strArg.substr(ichPort + 1)));
+            }
+        } else if("unix"==strScheme) {
+            return MakeUnixTransport(strArg);
+        }
+        throw std::runtime_error("Unknown transport " + strScheme);
+    }
+}
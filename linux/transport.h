@@ -0,0 +1,80 @@
+//
+//  transport.h
+//  robotcontrold
+//
+//  Transports connecting the headless controller to the rover.
+//  The rover side sends SSensorPackets and receives SRobotCommand records,
+//  exactly as over the BLE link used by the Mac application.
+//
+
+#ifndef transport_h
+#define transport_h
+
+#include "../robotcontrol2/robot_controller_c.h"
+#include "../robotcontrol2/nonmoveable.h"
+#include "../robotcontrol2/sensor_packet.h"
+#include "event_loop.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rbt {
+    struct ITransport : rbt::nonmoveable {
+        virtual ~ITransport() {}
+        
+        // Registers the transport's file descriptors with evloop.
+        // fnReceived is called for every complete sensor packet.
+        virtual void attach(CEventLoop& evloop, std::function<void(SSensorPacket const&)> fnReceived) = 0;
+        
+        // Returns false if no rover is connected or the command could not be written
+        virtual bool send(SRobotCommand const& rcmd) = 0;
+    };
+    
+    // Creates transport from a specification string:
+    //  serial:/dev/ttyUSB0[@57600]  UART connected to the rover
+    //  udp:[host:]port              rover sends one packet per datagram to host:port
+    //  unix:/path/to/socket         local stream socket, e.g. for the simulated rover
+    // Throws std::runtime_error if the transport can't be opened.
+    std::unique_ptr<ITransport> MakeTransport(std::string const& strSpec);
+    
+    std::unique_ptr<ITransport> MakeSerialTransport(std::string const& strDevice, int nBaud);
+    std::unique_ptr<ITransport> MakeUdpTransport(std::string const& strHost, int nPort);
+    std::unique_ptr<ITransport> MakeUnixTransport(std::string const& strPath);
+    
+    // Stream transports (serial, unix socket) have no record boundaries.
+    // The packet header tells the packet size. If the header is invalid, e.g. after
+    // connecting in the middle of a packet, we skip a byte at a time until we're in sync again.
+    struct CPacketBuffer {
+        template<typename Func>
+        void append(char const* pb, size_t cb, Func foreach) {
+            m_vecb.insert(m_vecb.end(), pb, pb + cb);
+            
+            size_t ib = 0;
+            while(ib + 2 <= m_vecb.size()) {
+                auto const nVersion = static_cast<unsigned char>(m_vecb[ib]);
+                auto const cReadings = static_cast<unsigned char>(m_vecb[ib + 1]);
+                if(c_nSensorPacketVersion!=nVersion || cReadings < 1 || c_cMaxSonarReadings < cReadings) {
+                    ++ib;
+                    continue;
+                }
+                
+                auto const cbPacket = sensorPacketSize(cReadings);
+                if(m_vecb.size() < ib + cbPacket) break;
+                
+                SSensorPacket packet;
+                if(decodeSensorPacket(m_vecb.data() + ib, cbPacket, packet)) foreach(packet);
+                ib += cbPacket;
+            }
+            m_vecb.erase(m_vecb.begin(), m_vecb.begin() + ib);
+        }
+        
+        void clear() { m_vecb.clear(); }
+        
+    private:
+        std::vector<char> m_vecb;
+    };
+}
+
+#endif /* transport_h */
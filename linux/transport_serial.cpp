@@ -0,0 +1,88 @@
+//
+//  transport_serial.cpp
+//  robotcontrold
+//
+//  UART connection to the rover, e.g. when the controller runs on a
+//  single-board computer mounted next to the Arduino.
+//
+
+#include "transport.h"
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <system_error>
+#include <stdexcept>
+#include <iostream>
+
+namespace rbt {
+    namespace {
+        speed_t BaudRate(int nBaud) {
+            switch(nBaud) {
+                case 9600: return B9600;
+                case 19200: return B19200;
+                case 38400: return B38400;
+                case 57600: return B57600;
+                case 115200: return B115200;
+                case 230400: return B230400;
+                default: throw std::runtime_error("Unsupported baud rate " + std::to_string(nBaud));
+            }
+        }
+        
+        struct CSerialTransport : ITransport {
+            CSerialTransport(std::string const& strDevice, int nBaud)
+                : m_fd(open(strDevice.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC))
+            {
+                if(m_fd < 0) throw std::system_error(errno, std::system_category(), strDevice);
+                
+                termios tio;
+                if(tcgetattr(m_fd, &tio) < 0) {
+                    close(m_fd);
+                    throw std::system_error(errno, std::system_category(), "tcgetattr");
+                }
+                cfmakeraw(&tio);
+                cfsetispeed(&tio, BaudRate(nBaud));
+                cfsetospeed(&tio, BaudRate(nBaud));
+                tio.c_cflag |= CLOCAL | CREAD;
+                
+                // Discard anything the rover sent before we opened the port
+                // so the first record starts on a record boundary
+                if(tcsetattr(m_fd, TCSANOW, &tio) < 0 || tcflush(m_fd, TCIOFLUSH) < 0) {
+                    close(m_fd);
+                    throw std::system_error(errno, std::system_category(), "tcsetattr");
+                }
+            }
+            
+            ~CSerialTransport() {
+                close(m_fd);
+            }
+            
+            void attach(CEventLoop& evloop, std::function<void(SSensorPacket const&)> fnReceived) override {
+                evloop.add(m_fd, [this, fnReceived] {
+                    char ab[256];
+                    ssize_t cb;
+                    while(0 < (cb = read(m_fd, ab, sizeof(ab)))) {
+                        m_recbuf.append(ab, cb, fnReceived);
+                    }
+                    if(cb < 0 && EAGAIN!=errno && EINTR!=errno) {
+                        std::cerr << "Serial read failed: " << std::system_category().message(errno) << std::endl;
+                    }
+                });
+            }
+            
+            bool send(SRobotCommand const& rcmd) override {
+                return sizeof(rcmd)==write(m_fd, &rcmd, sizeof(rcmd));
+            }
+            
+        private:
+            int m_fd;
+            CPacketBuffer m_recbuf;
+        };
+    }
+    
+    std::unique_ptr<ITransport> MakeSerialTransport(std::string const& strDevice, int nBaud) {
+        return std::make_unique<CSerialTransport>(strDevice, nBaud);
+    }
+}
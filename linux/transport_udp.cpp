@@ -0,0 +1,84 @@
+//
+//  transport_udp.cpp
+//  robotcontrold
+//
+//  Datagram connection to the rover, e.g. via a WiFi bridge.
+//  Each datagram carries exactly one SSensorPacket, or an SSensorData
+//  record from older firmware. Commands are sent to the address the
+//  last sensor packet came from.
+//
+
+#include "transport.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <system_error>
+#include <stdexcept>
+#include <iostream>
+
+namespace rbt {
+    namespace {
+        struct CUdpTransport : ITransport {
+            CUdpTransport(std::string const& strHost, int nPort)
+                : m_fd(socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0))
+                , m_bPeer(false)
+            {
+                if(m_fd < 0) throw std::system_error(errno, std::system_category(), "socket");
+                
+                sockaddr_in addr = {};
+                addr.sin_family = AF_INET;
+                addr.sin_port = htons(nPort);
+                if(1!=inet_pton(AF_INET, strHost.c_str(), &addr.sin_addr)) {
+                    close(m_fd);
+                    throw std::runtime_error("Invalid IPv4 address " + strHost);
+                }
+                if(bind(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                    close(m_fd);
+                    throw std::system_error(errno, std::system_category(), "bind");
+                }
+            }
+            
+            ~CUdpTransport() {
+                close(m_fd);
+            }
+            
+            void attach(CEventLoop& evloop, std::function<void(SSensorPacket const&)> fnReceived) override {
+                evloop.add(m_fd, [this, fnReceived] {
+                    char ab[sizeof(SSensorPacket)];
+                    sockaddr_in addrPeer;
+                    socklen_t cbAddr = sizeof(addrPeer);
+                    ssize_t cb;
+                    while(0 <= (cb = recvfrom(m_fd, ab, sizeof(ab), 0, reinterpret_cast<sockaddr*>(&addrPeer), &cbAddr))) {
+                        SSensorPacket packet;
+                        if(decodeSensorPacket(ab, cb, packet)) {
+                            m_addrPeer = addrPeer;
+                            m_bPeer = true;
+                            fnReceived(packet);
+                        } else {
+                            std::cerr << "Ignoring datagram of " << cb << " bytes" << std::endl;
+                        }
+                        cbAddr = sizeof(addrPeer);
+                    }
+                });
+            }
+            
+            bool send(SRobotCommand const& rcmd) override {
+                return m_bPeer
+                    && sizeof(rcmd)==sendto(m_fd, &rcmd, sizeof(rcmd), 0, reinterpret_cast<sockaddr const*>(&m_addrPeer), sizeof(m_addrPeer));
+            }
+            
+        private:
+            int m_fd;
+            bool m_bPeer;
+            sockaddr_in m_addrPeer;
+        };
+    }
+    
+    std::unique_ptr<ITransport> MakeUdpTransport(std::string const& strHost, int nPort) {
+        return std::make_unique<CUdpTransport>(strHost, nPort);
+    }
+}
@@ -0,0 +1,110 @@
+//
+//  transport_unix.cpp
+//  robotcontrold
+//
+//  Local stream socket the simulated rover (fake_rover) connects to.
+//  Only one rover can be connected at a time, a new connection replaces the old one.
+//
+
+#include "transport.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <cstring>
+#include <system_error>
+#include <stdexcept>
+#include <iostream>
+
+namespace rbt {
+    namespace {
+        struct CUnixTransport : ITransport {
+            CUnixTransport(std::string const& strPath)
+                : m_strPath(strPath)
+                , m_fdListen(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0))
+                , m_fdConnection(-1)
+                , m_pevloop(nullptr)
+            {
+                if(m_fdListen < 0) throw std::system_error(errno, std::system_category(), "socket");
+                
+                sockaddr_un addr = {};
+                addr.sun_family = AF_UNIX;
+                if(sizeof(addr.sun_path) <= strPath.size()) {
+                    close(m_fdListen);
+                    throw std::runtime_error("Socket path too long " + strPath);
+                }
+                std::strcpy(addr.sun_path, strPath.c_str());
+                
+                unlink(strPath.c_str()); // remove stale socket of a previous run
+                if(bind(m_fdListen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+                || listen(m_fdListen, 1) < 0) {
+                    close(m_fdListen);
+                    throw std::system_error(errno, std::system_category(), strPath);
+                }
+            }
+            
+            ~CUnixTransport() {
+                Disconnect();
+                close(m_fdListen);
+                unlink(m_strPath.c_str());
+            }
+            
+            void attach(CEventLoop& evloop, std::function<void(SSensorPacket const&)> fnReceived) override {
+                m_pevloop = &evloop;
+                m_fnReceived = std::move(fnReceived);
+                evloop.add(m_fdListen, [this] { Accept(); });
+            }
+            
+            bool send(SRobotCommand const& rcmd) override {
+                return 0 <= m_fdConnection
+                    && sizeof(rcmd)==::send(m_fdConnection, &rcmd, sizeof(rcmd), MSG_NOSIGNAL);
+            }
+            
+        private:
+            void Accept() {
+                int const fd = accept4(m_fdListen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if(fd < 0) return;
+                
+                Disconnect();
+                std::cout << "Rover connected" << std::endl;
+                m_fdConnection = fd;
+                m_pevloop->add(m_fdConnection, [this] { Read(); });
+            }
+            
+            void Read() {
+                char ab[256];
+                ssize_t cb;
+                while(0 < (cb = recv(m_fdConnection, ab, sizeof(ab), 0))) {
+                    m_recbuf.append(ab, cb, m_fnReceived);
+                }
+                if(0==cb || (cb < 0 && EAGAIN!=errno && EINTR!=errno)) {
+                    std::cout << "Rover disconnected" << std::endl;
+                    Disconnect();
+                }
+            }
+            
+            void Disconnect() {
+                if(0 <= m_fdConnection) {
+                    m_pevloop->remove(m_fdConnection);
+                    close(m_fdConnection);
+                    m_fdConnection = -1;
+                    m_recbuf.clear();
+                }
+            }
+            
+            std::string const m_strPath;
+            int m_fdListen;
+            int m_fdConnection;
+            
+            CEventLoop* m_pevloop;
+            std::function<void(SSensorPacket const&)> m_fnReceived;
+            CPacketBuffer m_recbuf;
+        };
+    }
+    
+    std::unique_ptr<ITransport> MakeUnixTransport(std::string const& strPath) {
+        return std::make_unique<CUnixTransport>(strPath);
+    }
+}
@@ -105,10 +105,8 @@ class BLE : NSObject, CBCentralManagerDelegate, CBPeripheralDelegate {
     func peripheral(peripheral: CBPeripheral, didUpdateValueForCharacteristic characteristic: CBCharacteristic, error: NSError?)
     {
         assert(error==nil)
-        let data = charRX.value!
-        if(data.length==sizeof(SSensorData)) {
-            controller.receivedSensorData(UnsafePointer<SSensorData>(data.bytes).memory)
-        }
+        // SSensorPacket or SSensorData from older firmware, robot_received_sensor_packet tells them apart
+        controller.receivedSensorPacket(charRX.value!)
     }
     
     // Data interface
@@ -31,7 +31,7 @@ class RobotViewController: NSViewController {
         viewRender.becomeFirstResponder()
         viewRender.controller = self
         
-        m_robotcontroller = robot_new_controller();
+        m_robotcontroller = robot_new_controller(400, 400, /*nScale*/5); // = Map of 20m x 20m map
         
         m_ble = BLE(controller: self)
         
@@ -62,6 +62,10 @@ class RobotViewController: NSViewController {
     override func viewDidDisappear() {
         m_ble = nil
     }
+    
+    deinit {
+        robot_delete_controller(m_robotcontroller)
+    }
 
     override var representedObject: AnyObject? {
         didSet {
@@ -108,6 +112,22 @@ class RobotViewController: NSViewController {
         // TODO: Get current planned path from m_robotcontroller
     }
     
+    func receivedSensorPacket(data: NSData) {
+        log("Sensor packet of \(data.length) bytes\n")
+        
+        withTimer {
+            var rcmd = c_rcmdStop;
+            var bSend = false;
+            let pose = robot_received_sensor_packet(self.m_robotcontroller, data.bytes, data.length, &rcmd, &bSend)
+            self.m_apairptf.append( (CGPoint(x: pose.x, y: pose.y), CGFloat(pose.fYaw)) )
+            if bSend {
+                self.sendCommand(rcmd)
+            }
+        }
+        m_bezierpath.lineToPoint(m_apairptf.last!.0)
+        viewRender.needsDisplay = true
+    }
+    
     func positions() -> [(CGPoint, CGFloat)] {
         return m_apairptf
     }
@@ -116,22 +136,34 @@ class RobotViewController: NSViewController {
         let btnSelected = radiobtnShowMap.selectedCell() as! NSButtonCell
         let type = bitmap_type(UInt32(btnSelected.tag))
 
-        var bitmap = robot_get_map(m_robotcontroller, type)
-        if let bitmaprep = NSBitmapImageRep(bitmapDataPlanes: &bitmap.m_pbImage,
-            pixelsWide: bitmap.m_nWidth,
-            pixelsHigh: bitmap.m_nHeight,
-            bitsPerSample: 8,
-            samplesPerPixel: bitmap.m_cChannels,
-            hasAlpha: false,
-            isPlanar: false,
-            colorSpaceName: (bitmap.m_cChannels==3 ? NSDeviceRGBColorSpace : NSDeviceWhiteColorSpace),
-            bytesPerRow: bitmap.m_cbBytesPerRow,
-            bitsPerPixel: 0) {
-                
-            let sizeImage = bitmaprep.size * CGFloat(bitmap.m_nScale)
+        var bitmaprep : NSBitmapImageRep?
+        var nScale = 1
+        var ptCenter = NSPoint(x: 0, y: 0) // moves if the map scrolls
+        if type==greyscale {
+            bitmaprep = updateGreyscaleMap()
+            nScale = m_nScale
+            ptCenter = m_ptCenterGreyscale
+        } else {
+            var bitmap = robot_get_map(m_robotcontroller, type)
+            bitmaprep = NSBitmapImageRep(bitmapDataPlanes: &bitmap.m_pbImage,
+                pixelsWide: bitmap.m_nWidth,
+                pixelsHigh: bitmap.m_nHeight,
+                bitsPerSample: 8,
+                samplesPerPixel: bitmap.m_cChannels,
+                hasAlpha: false,
+                isPlanar: false,
+                colorSpaceName: (bitmap.m_cChannels==3 ? NSDeviceRGBColorSpace : NSDeviceWhiteColorSpace),
+                bytesPerRow: bitmap.m_cbBytesPerRow,
+                bitsPerPixel: 0)
+            nScale = bitmap.m_nScale
+            ptCenter = NSPoint(x: CGFloat(bitmap.m_nCenterX), y: CGFloat(bitmap.m_nCenterY))
+        }
+        
+        if let bitmaprep = bitmaprep {
+            let sizeImage = bitmaprep.size * CGFloat(nScale)
             bitmaprep.drawInRect(NSRect(
-                x: -sizeImage.width/2,
-                y: sizeImage.height/2,
+                x: ptCenter.x - sizeImage.width/2,
+                y: ptCenter.y + sizeImage.height/2,
                 width: sizeImage.width,
                 height: -sizeImage.height
             ))
@@ -150,6 +182,41 @@ class RobotViewController: NSViewController {
         }
     }
     
+    // Copies the tiles of the greyscale map that changed since the last call,
+    // starting with version 0, i.e., all tiles
+    func updateGreyscaleMap() -> NSBitmapImageRep? {
+        let changes = robot_get_map_changes(m_robotcontroller, m_nGreyscaleVersion)
+        defer { robot_release_map_changes(m_robotcontroller) }
+        
+        if m_bitmaprepGreyscale == nil {
+            m_bitmaprepGreyscale = NSBitmapImageRep(bitmapDataPlanes: nil,
+                pixelsWide: changes.m_bitmap.m_nWidth,
+                pixelsHigh: changes.m_bitmap.m_nHeight,
+                bitsPerSample: 8,
+                samplesPerPixel: 1,
+                hasAlpha: false,
+                isPlanar: false,
+                colorSpaceName: NSDeviceWhiteColorSpace,
+                bytesPerRow: changes.m_bitmap.m_nWidth,
+                bitsPerPixel: 0)
+            m_nScale = changes.m_bitmap.m_nScale
+        }
+        
+        if let bitmaprep = m_bitmaprepGreyscale {
+            for i in 0..<changes.m_cTiles {
+                let tile = changes.m_ptile[i]
+                for y in 0..<tile.m_nHeight {
+                    memcpy(bitmaprep.bitmapData + (tile.m_nY + y) * bitmaprep.bytesPerRow + tile.m_nX,
+                        tile.m_pbImage + y * changes.m_bitmap.m_cbBytesPerRow,
+                        tile.m_nWidth)
+                }
+            }
+        }
+        m_nGreyscaleVersion = changes.m_nVersion
+        m_ptCenterGreyscale = NSPoint(x: CGFloat(changes.m_bitmap.m_nCenterX), y: CGFloat(changes.m_bitmap.m_nCenterY))
+        return m_bitmaprepGreyscale
+    }
+    
     func log(msg: String) {
         print(msg, terminator: "")
         // textview.string? += msg
@@ -166,6 +233,11 @@ class RobotViewController: NSViewController {
 
     var m_cPath = [CGPoint]()
     
+    var m_bitmaprepGreyscale : NSBitmapImageRep?
+    var m_nGreyscaleVersion : UInt64 = 0
+    var m_nScale = 1
+    var m_ptCenterGreyscale = NSPoint(x: 0, y: 0)
+    
     var m_ble : BLE!
     
     @IBOutlet var viewRender: QuartzView!
@@ -0,0 +1,94 @@
+//
+//  arena.cpp
+//  robotcontrol2
+//
+
+#include "arena.h"
+
+#include <assert.h>
+#include <cstdint>
+#include <new>
+
+namespace rbt {
+    namespace {
+        std::size_t AlignUp(std::size_t n, std::size_t cbAlign) {
+            return (n + cbAlign - 1) / cbAlign * cbAlign;
+        }
+    }
+    
+    CArena::CArena(std::size_t cb, CStageStatistics& stats)
+        : m_pb(new unsigned char[cb])
+        , m_cb(cb)
+        , m_ib(0)
+        , m_poverflow(nullptr)
+        , m_stats(stats)
+    {}
+    
+    CArena::~CArena() {
+        reset();
+    }
+    
+    void* CArena::allocate(std::size_t cb, std::size_t cbAlign) {
+        auto const nAddress = reinterpret_cast<std::uintptr_t>(m_pb.get());
+        auto const ib = AlignUp(nAddress + m_ib, cbAlign) - nAddress;
+        if(ib + cb <= m_cb) {
+            m_ib = ib + cb;
+            return m_pb.get() + ib;
+        }
+        
+        // The arena is too small, this shows up in SRobotStats
+        RBT_COUNT(m_stats, m_cArenaOverflows, 1);
+        auto const cbHeader = AlignUp(sizeof(SOverflow), cbAlign);
+        auto* pb = static_cast<unsigned char*>(::operator new(cbHeader + cb + cbAlign));
+        auto* poverflow = reinterpret_cast<SOverflow*>(pb);
+        poverflow->m_pNext = m_poverflow;
+        m_poverflow = poverflow;
+        
+        auto const nAddressOverflow = reinterpret_cast<std::uintptr_t>(pb);
+        return pb + (AlignUp(nAddressOverflow + cbHeader, cbAlign) - nAddressOverflow);
+    }
+    
+    void CArena::reset() {
+        m_ib = 0;
+        while(m_poverflow) {
+            auto* poverflow = m_poverflow;
+            m_poverflow = poverflow->m_pNext;
+            ::operator delete(poverflow);
+        }
+    }
+    
+    cv::UMatData* CArenaMatAllocator::allocate(int dims, int const* sizes, int type, void* data, std::size_t* step,
+                                                int /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+        // Same layout as OpenCV's StdMatAllocator
+        std::size_t cbTotal = CV_ELEM_SIZE(type);
+        for(int i = dims - 1; 0 <= i; --i) {
+            if(step) {
+                if(data && CV_AUTOSTEP != step[i]) {
+                    assert(cbTotal <= step[i]);
+                    cbTotal = step[i];
+                } else {
+                    step[i] = cbTotal;
+                }
+            }
+            cbTotal *= sizes[i];
+        }
+        
+        auto* u = new (m_arena.allocate(sizeof(cv::UMatData), alignof(cv::UMatData))) cv::UMatData(this);
+        u->data = u->origdata = data
+            ? static_cast<uchar*>(data)
+            : static_cast<uchar*>(m_arena.allocate(cbTotal, 64)); // cache line, like cv::fastMalloc
+        u->size = cbTotal;
+        if(data) u->flags |= cv::UMatData::USER_ALLOCATED;
+        return u;
+    }
+    
+    bool CArenaMatAllocator::allocate(cv::UMatData* u, int /*accessFlags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+        return nullptr != u;
+    }
+    
+    void CArenaMatAllocator::deallocate(cv::UMatData* u) const {
+        if(u && 0 == u->refcount) {
+            u->~UMatData();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+//
+//  arena.h
+//  robotcontrol2
+//
+//  Monotonic allocator for the temporaries of one sensor packet. Memory is handed
+//  out from a single block that is allocated once and released all at once by reset().
+//  If the block is exhausted, the arena falls back to the heap and counts the allocation.
+//
+
+#ifndef arena_h
+#define arena_h
+
+#include "nonmoveable.h"
+#include "stage_statistics.h"
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <memory>
+
+namespace rbt {
+    struct CArena : rbt::nonmoveable {
+        CArena(std::size_t cb, CStageStatistics& stats);
+        ~CArena();
+        
+        void* allocate(std::size_t cb, std::size_t cbAlign = alignof(std::max_align_t));
+        
+        // Invalidates everything allocated since the last reset
+        void reset();
+        
+    private:
+        struct SOverflow {
+            SOverflow* m_pNext;
+        };
+        
+        std::unique_ptr<unsigned char[]> const m_pb;
+        std::size_t const m_cb;
+        std::size_t m_ib;
+        SOverflow* m_poverflow; // heap blocks, freed by reset
+        
+        CStageStatistics& m_stats;
+    };
+    
+    // Allocates cv::Mat data from a CArena. Deallocation is a no-op, the memory is
+    // reclaimed by CArena::reset, so all Mats must be released before the reset.
+    struct CArenaMatAllocator : cv::MatAllocator {
+        explicit CArenaMatAllocator(CArena& arena) : m_arena(arena) {}
+        
+        cv::UMatData* allocate(int dims, int const* sizes, int type, void* data, std::size_t* step,
+                               int flags, cv::UMatUsageFlags usageFlags) const override;
+        bool allocate(cv::UMatData* u, int accessFlags, cv::UMatUsageFlags usageFlags) const override;
+        void deallocate(cv::UMatData* u) const override;
+        
+    private:
+        CArena& m_arena;
+    };
+}
+
+#endif /* arena_h */
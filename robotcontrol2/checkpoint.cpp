@@ -0,0 +1,190 @@
+//
+//  checkpoint.cpp
+//  robotcontrol2
+//
+
+#include "checkpoint.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+
+namespace rbt {
+    namespace {
+        std::uint32_t const c_nMagic = 0x43544252; // "RBTC"
+        std::uint32_t const c_nVersion = 1;
+        
+        template<typename T>
+        void Write(std::ostream& os, T const& t) {
+            static_assert(std::is_trivially_copyable<T>::value, "Write raw bytes only");
+            os.write(reinterpret_cast<char const*>(&t), sizeof(T));
+        }
+        
+        template<typename T>
+        bool Read(std::istream& is, T& t) {
+            static_assert(std::is_trivially_copyable<T>::value, "Read raw bytes only");
+            return static_cast<bool>(is.read(reinterpret_cast<char*>(&t), sizeof(T)));
+        }
+        
+        // Calls foreach(iTile, rectn) for every tile, rectn is both-inclusive
+        template<typename Func>
+        void ForEachTile(rbt::size<int> const& szn, Func foreach) {
+            int const cTilesX = (szn.x + c_nMapTileSize - 1) / c_nMapTileSize;
+            int const cTilesY = (szn.y + c_nMapTileSize - 1) / c_nMapTileSize;
+            for(int iTile = 0; iTile < cTilesX * cTilesY; ++iTile) {
+                auto const x = iTile % cTilesX * c_nMapTileSize;
+                auto const y = iTile / cTilesX * c_nMapTileSize;
+                foreach(iTile, rbt::rect<int>{x, y, std::min(x + c_nMapTileSize, szn.x) - 1, std::min(y + c_nMapTileSize, szn.y) - 1});
+            }
+        }
+        
+        bool Empty(SCheckpoint const& checkpoint, rbt::rect<int> const& rectn) {
+            for(int y = rectn.bottom; y <= rectn.top; ++y) {
+                auto const* pfLogOdds = checkpoint.m_matfLogOdds.ptr<float>(y);
+                auto const* pnVisited = checkpoint.m_matnVisited.ptr<std::uint8_t>(y);
+                for(int x = rectn.left; x <= rectn.right; ++x) {
+                    if(0 != pfLogOdds[x] || 0 != pnVisited[x]) return false;
+                }
+            }
+            return true;
+        }
+    }
+    
+    CCheckpointWriter::CCheckpointWriter()
+        : m_thread([this] { run(); })
+    {}
+    
+    CCheckpointWriter::~CCheckpointWriter() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bStop = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+    
+    void CCheckpointWriter::request(std::string strPath) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_strPathRequest = std::move(strPath);
+        m_bRequested = true;
+    }
+    
+    bool CCheckpointWriter::requested() {
+        if(!m_bRequested) return false;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return !m_bWriting;
+    }
+    
+    void CCheckpointWriter::post() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::swap(m_checkpoint, m_checkpointWriting);
+            m_strPathWriting = std::move(m_strPathRequest);
+            m_bRequested = false;
+            m_bWriting = true;
+        }
+        m_cv.notify_one();
+    }
+    
+    void CCheckpointWriter::run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(true) {
+            m_cv.wait(lock, [this] { return m_bStop || m_bWriting; });
+            if(m_bWriting) {
+                // The mapping thread doesn't touch m_checkpointWriting while m_bWriting is set
+                lock.unlock();
+                if(!write(m_checkpointWriting, m_strPathWriting)) {
+                    std::cerr << "Could not write checkpoint " << m_strPathWriting << std::endl;
+                }
+                lock.lock();
+                m_bWriting = false;
+            }
+            if(m_bStop) return;
+        }
+    }
+    
+    bool CCheckpointWriter::write(SCheckpoint const& checkpoint, std::string const& strPath) {
+        auto const strPathTemp = strPath + ".tmp";
+        {
+            std::ofstream os(strPathTemp, std::ios::binary | std::ios::trunc);
+            Write(os, c_nMagic);
+            Write(os, c_nVersion);
+            Write(os, checkpoint.m_szn);
+            Write(os, checkpoint.m_nScale);
+            Write(os, checkpoint.m_bScrolling);
+            Write(os, checkpoint.m_params);
+            Write(os, checkpoint.m_szOffset);
+            Write(os, checkpoint.m_ptf);
+            Write(os, checkpoint.m_fYaw);
+            Write(os, checkpoint.m_nState);
+            Write(os, checkpoint.m_ptnTarget);
+            Write(os, static_cast<std::uint32_t>(checkpoint.m_vecptfPath.size()));
+            for(auto const& ptf : checkpoint.m_vecptfPath) Write(os, ptf);
+            
+            ForEachTile(checkpoint.m_szn, [&](int iTile, rbt::rect<int> const& rectn) {
+                if(Empty(checkpoint, rectn)) return;
+                
+                Write(os, static_cast<std::int32_t>(iTile));
+                for(int y = rectn.bottom; y <= rectn.top; ++y) {
+                    os.write(reinterpret_cast<char const*>(checkpoint.m_matfLogOdds.ptr<float>(y) + rectn.left), (rectn.right + 1 - rectn.left) * sizeof(float));
+                    os.write(reinterpret_cast<char const*>(checkpoint.m_matnVisited.ptr<std::uint8_t>(y) + rectn.left), rectn.right + 1 - rectn.left);
+                }
+            });
+            Write(os, static_cast<std::int32_t>(-1)); // end of tiles
+            
+            os.close();
+            if(!os) return false;
+        }
+        return 0 == std::rename(strPathTemp.c_str(), strPath.c_str());
+    }
+    
+    bool CCheckpointWriter::read(char const* szPath, SCheckpoint& checkpoint) {
+        std::ifstream is(szPath, std::ios::binary);
+        std::uint32_t nMagic = 0;
+        std::uint32_t nVersion = 0;
+        if(!Read(is, nMagic) || c_nMagic != nMagic || !Read(is, nVersion) || c_nVersion != nVersion) return false;
+        
+        std::uint32_t cPath = 0;
+        if(!Read(is, checkpoint.m_szn) || !Read(is, checkpoint.m_nScale) || !Read(is, checkpoint.m_bScrolling)
+        || !Read(is, checkpoint.m_params) || !Read(is, checkpoint.m_szOffset)
+        || !Read(is, checkpoint.m_ptf) || !Read(is, checkpoint.m_fYaw)
+        || !Read(is, checkpoint.m_nState) || !Read(is, checkpoint.m_ptnTarget)
+        || !Read(is, cPath)) {
+            return false;
+        }
+        if(checkpoint.m_szn.x <= 0 || checkpoint.m_szn.y <= 0 || 0 != checkpoint.m_szn.x % 2 || 0 != checkpoint.m_szn.y % 2
+        || checkpoint.m_nScale <= 0 || 100000 < cPath) {
+            return false;
+        }
+        
+        checkpoint.m_vecptfPath.resize(cPath);
+        for(auto& ptf : checkpoint.m_vecptfPath) {
+            if(!Read(is, ptf)) return false;
+        }
+        
+        checkpoint.m_matfLogOdds.create(checkpoint.m_szn.y, checkpoint.m_szn.x, CV_32FC1);
+        checkpoint.m_matfLogOdds.setTo(cv::Scalar(0));
+        checkpoint.m_matnVisited.create(checkpoint.m_szn.y, checkpoint.m_szn.x, CV_8UC1);
+        checkpoint.m_matnVisited.setTo(cv::Scalar(0));
+        
+        std::vector<rbt::rect<int>> vecrectnTile;
+        ForEachTile(checkpoint.m_szn, [&](int, rbt::rect<int> const& rectn) { vecrectnTile.push_back(rectn); });
+        while(true) {
+            std::int32_t iTile = 0;
+            if(!Read(is, iTile)) return false;
+            if(iTile < 0) return true;
+            if(rbt::numeric_cast<int>(vecrectnTile.size()) <= iTile) return false;
+            
+            auto const& rectn = vecrectnTile[iTile];
+            for(int y = rectn.bottom; y <= rectn.top; ++y) {
+                if(!is.read(reinterpret_cast<char*>(checkpoint.m_matfLogOdds.ptr<float>(y) + rectn.left), (rectn.right + 1 - rectn.left) * sizeof(float))
+                || !is.read(reinterpret_cast<char*>(checkpoint.m_matnVisited.ptr<std::uint8_t>(y) + rectn.left), rectn.right + 1 - rectn.left)) {
+                    return false;
+                }
+            }
+        }
+    }
+}
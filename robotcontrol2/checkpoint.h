@@ -0,0 +1,88 @@
+//
+//  checkpoint.h
+//  robotcontrol2
+//
+//  Checkpoints of the controller state, so a restarted host process can continue
+//  the mission where it stopped. The mapping thread copies its state into a
+//  SCheckpoint and a background thread writes it, so sensor data processing never
+//  waits for the file system. The file is written next to the target and renamed,
+//  i.e., a crash while writing leaves the previous checkpoint intact.
+//
+//  Map layers are stored per c_nMapTileSize x c_nMapTileSize tile and only tiles
+//  with known or visited cells are written.
+//
+
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include "robot_controller_c.h"
+#include "nonmoveable.h"
+#include "geometry.h"
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rbt {
+    struct SCheckpoint {
+        // Controller configuration
+        rbt::size<int> m_szn{0, 0};
+        int m_nScale;
+        bool m_bScrolling;
+        SRobotParameters m_params;
+        
+        // Occupancy grid
+        rbt::size<int> m_szOffset{0, 0}; // world position of the grid center in pixels
+        cv::Mat m_matfLogOdds; // CV_32FC1
+        cv::Mat m_matnVisited; // CV_8UC1
+        
+        // Robot pose in world coordinates
+        rbt::point<double> m_ptf;
+        double m_fYaw;
+        
+        // Exploration strategy, in world coordinates
+        int m_nState;
+        rbt::point<int> m_ptnTarget; // point<int>::invalid() if there is none
+        std::vector<rbt::point<double>> m_vecptfPath;
+    };
+    
+    struct CCheckpointWriter : rbt::nonmoveable {
+        CCheckpointWriter();
+        ~CCheckpointWriter(); // finishes writing a posted checkpoint
+        
+        // Any thread. The next checkpoint is written to strPath.
+        void request(std::string strPath);
+        
+        // Mapping thread. True if a checkpoint has been requested and the previous one has been written.
+        // Then fill checkpoint() and post() it.
+        bool requested();
+        SCheckpoint& checkpoint() { return m_checkpoint; }
+        void post();
+        
+        static bool read(char const* szPath, SCheckpoint& checkpoint);
+        
+    private:
+        void run();
+        static bool write(SCheckpoint const& checkpoint, std::string const& strPath);
+        
+        SCheckpoint m_checkpoint; // mapping thread only, keeps its buffers for the next checkpoint
+        std::atomic<bool> m_bRequested{false};
+        
+        std::mutex m_mutex; // guards all members below
+        std::condition_variable m_cv;
+        std::string m_strPathRequest;
+        SCheckpoint m_checkpointWriting;
+        std::string m_strPathWriting;
+        bool m_bWriting = false; // m_checkpointWriting is posted or being written
+        bool m_bStop = false;
+        
+        std::thread m_thread; // declared last, so it starts after all other members are initialized
+    };
+}
+
+#endif /* checkpoint_h */
@@ -0,0 +1,191 @@
+//
+//  cost_map.cpp
+//  robotcontrol2
+//
+
+#include "cost_map.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <opencv2/imgproc.hpp>
+
+namespace rbt {
+    namespace {
+        double const c_fCostDecay = 0.1; // per cm beyond the robot radius
+        float const c_fFar = 1e20f; // squared distance of cells without an obstacle in the window
+        
+        rbt::rect<int> Grow(rbt::rect<int> const& rectn, int n, rbt::size<int> const& szn) {
+            return rbt::rect<int>{
+                std::max(rectn.left - n, 0),
+                std::max(rectn.bottom - n, 0),
+                std::min(rectn.right + n, szn.x - 1),
+                std::min(rectn.top + n, szn.y - 1)
+            };
+        }
+        
+        cv::Rect ToCvRect(rbt::rect<int> const& rectn) { // both-inclusive
+            return cv::Rect(rectn.left, rectn.bottom, rectn.right + 1 - rectn.left, rectn.top + 1 - rectn.bottom);
+        }
+    }
+    
+    CCostMap::CCostMap(rbt::size<int> const& szn, int nScale, double fRobotRadius, std::uint8_t nFreeThreshold, CArena& arena, CStageStatistics& stats)
+    :   m_szn(szn),
+        m_nInflationRadius(rbt::numeric_cast<int>(std::ceil((fRobotRadius + c_nInflationDistance) / nScale))),
+        m_nFreeThreshold(nFreeThreshold),
+        m_matnStatic(szn.y, szn.x, CV_8UC1, cv::Scalar(0)),
+        m_matnOccupancy(szn.y, szn.x, CV_8UC1, cv::Scalar(0)),
+        m_matnVisited(szn.y, szn.x, CV_8UC1, cv::Scalar(0)),
+        m_matnCost(szn.y, szn.x, CV_8UC1, cv::Scalar(0)),
+        m_vecfLine(std::max(szn.x, szn.y)),
+        m_vecfLineDistance(std::max(szn.x, szn.y)),
+        m_veciParabola(std::max(szn.x, szn.y)),
+        m_vecfBoundary(std::max(szn.x, szn.y) + 1),
+        m_rectnDirty(rbt::rect<int>::empty()),
+        m_rectnChanged(rbt::rect<int>::empty()),
+        m_matallocator(arena),
+        m_stats(stats)
+    {
+        m_vecnCost.resize(m_nInflationRadius * c_nSubcells + 1);
+        for(int i = 0; i < rbt::numeric_cast<int>(m_vecnCost.size()); ++i) {
+            auto const fDistance = static_cast<double>(i) * nScale / c_nSubcells; // cm
+            if(0==i) {
+                m_vecnCost[i] = c_nCostLethal;
+            } else if(fDistance <= fRobotRadius) {
+                m_vecnCost[i] = c_nCostInscribed;
+            } else if(fDistance <= fRobotRadius + c_nInflationDistance) {
+                auto const nCost = std::lround((c_nCostInscribed - 1) * std::exp(-c_fCostDecay * (fDistance - fRobotRadius)));
+                m_vecnCost[i] = rbt::numeric_cast<std::uint8_t>(std::max(nCost, 1l));
+            } else {
+                m_vecnCost[i] = 0;
+            }
+        }
+    }
+    
+    void CCostMap::setStaticObstacles(cv::Mat const& matnObstacles) {
+        assert(matnObstacles.type()==CV_8UC1 && matnObstacles.cols==m_szn.x && matnObstacles.rows==m_szn.y);
+        cv::compare(matnObstacles, 0, m_matnStatic, cv::CMP_NE);
+        m_rectnDirty = rbt::rect<int>{0, 0, m_szn.x - 1, m_szn.y - 1};
+    }
+    
+    void CCostMap::scroll(rbt::size<int> const& sz) {
+        rbt::scroll(m_matnStatic, sz, cv::Scalar(0));
+        rbt::scroll(m_matnOccupancy, sz, cv::Scalar(0));
+        rbt::scroll(m_matnVisited, sz, cv::Scalar(0));
+        m_rectnDirty = rbt::rect<int>{0, 0, m_szn.x - 1, m_szn.y - 1};
+    }
+    
+    void CCostMap::visited(rbt::point<int> const& ptnFrom, rbt::point<int> const& ptnTo, int nRadius) {
+        cv::line(m_matnVisited, ptnFrom, ptnTo, 1, /*thickness*/ 2*nRadius);
+    }
+    
+    void CCostMap::setVisitedMask(cv::Mat const& matnVisited) {
+        assert(matnVisited.type()==CV_8UC1 && matnVisited.cols==m_szn.x && matnVisited.rows==m_szn.y);
+        matnVisited.copyTo(m_matnVisited);
+    }
+    
+    rbt::rect<int> CCostMap::takeChanges() {
+        auto const rectn = m_rectnChanged;
+        m_rectnChanged = rbt::rect<int>::empty();
+        return rectn;
+    }
+    
+    bool CCostMap::blocked(cv::Mat const& matnCost, rbt::point<int> const& ptnFrom, rbt::point<int> const& ptnTo) {
+        cv::LineIterator itpt(matnCost, ptnFrom, ptnTo);
+        for(int i = 0; i < itpt.count; ++i, ++itpt) {
+            if(c_nCostInscribed <= matnCost.at<std::uint8_t>(itpt.pos())) return true;
+        }
+        return false;
+    }
+    
+    cv::Mat const& CCostMap::Costs() {
+        if(m_rectnDirty.left <= m_rectnDirty.right) {
+            compose();
+        }
+        return m_matnCost;
+    }
+    
+    void CCostMap::compose() {
+        RBT_TIME_STAGE(m_stats, stage_cost_map);
+        
+        // Costs change within the inflation radius of changed cells. Their closest obstacles
+        // lie within the inflation radius again, all others are too far to matter.
+        auto const rectnCost = Grow(m_rectnDirty, m_nInflationRadius, m_szn);
+        auto const rectnWindow = Grow(rectnCost, m_nInflationRadius, m_szn);
+        auto const rectWindow = ToCvRect(rectnWindow);
+        m_rectnDirty = rbt::rect<int>::empty();
+        m_rectnChanged |= rbt::point<int>(rectnCost.left, rectnCost.bottom);
+        m_rectnChanged |= rbt::point<int>(rectnCost.right, rectnCost.top);
+        
+        // Exact Euclidean distance to the closest obstacle of the window like cv::distanceTransform
+        // with CV_DIST_MASK_PRECISE, which allocates its temporaries on the heap
+        cv::Mat matfSqrDistance;
+        matfSqrDistance.allocator = &m_matallocator;
+        matfSqrDistance.create(rectWindow.height, rectWindow.width, CV_32FC1);
+        {
+            RBT_TIME_STAGE(m_stats, stage_distance_transform);
+            for(int x = 0; x < rectWindow.width; ++x) {
+                for(int y = 0; y < rectWindow.height; ++y) {
+                    auto const pt = rbt::point<int>(rectWindow.x + x, rectWindow.y + y);
+                    bool const bObstacle = m_matnStatic.at<std::uint8_t>(pt.y, pt.x) || m_matnOccupancy.at<std::uint8_t>(pt.y, pt.x);
+                    m_vecfLine[y] = bObstacle ? 0.0f : c_fFar;
+                }
+                DistanceTransformLine(rectWindow.height);
+                for(int y = 0; y < rectWindow.height; ++y) {
+                    matfSqrDistance.at<float>(y, x) = m_vecfLineDistance[y];
+                }
+            }
+            for(int y = 0; y < rectWindow.height; ++y) {
+                auto* pfSqrDistance = matfSqrDistance.ptr<float>(y);
+                std::copy(pfSqrDistance, pfSqrDistance + rectWindow.width, m_vecfLine.begin());
+                DistanceTransformLine(rectWindow.width);
+                std::copy(m_vecfLineDistance.begin(), m_vecfLineDistance.begin() + rectWindow.width, pfSqrDistance);
+            }
+        }
+        
+        auto const fMaxDistance = static_cast<float>(m_vecnCost.size()) / c_nSubcells;
+        auto const fMaxSqrDistance = fMaxDistance * fMaxDistance;
+        for(int y = rectnCost.bottom; y <= rectnCost.top; ++y) {
+            auto const* pfSqrDistance = matfSqrDistance.ptr<float>(y - rectnWindow.bottom) - rectnWindow.left;
+            auto* pnCost = m_matnCost.ptr<std::uint8_t>(y);
+            for(int x = rectnCost.left; x <= rectnCost.right; ++x) {
+                pnCost[x] = pfSqrDistance[x] < fMaxSqrDistance
+                    ? m_vecnCost[static_cast<int>(std::sqrt(pfSqrDistance[x]) * c_nSubcells)]
+                    : 0;
+            }
+        }
+    }
+    
+    void CCostMap::DistanceTransformLine(int n) {
+        auto const& f = m_vecfLine;
+        auto& v = m_veciParabola;
+        auto& z = m_vecfBoundary;
+        auto const Intersection = [&](int q, int p) { // of the parabolas with vertices at q and p
+            return ((f[q] + rbt::sqr(q)) - (f[p] + rbt::sqr(p))) / (2.0f * (q - p));
+        };
+        
+        int k = 0;
+        v[0] = 0;
+        z[0] = std::numeric_limits<float>::lowest();
+        z[1] = std::numeric_limits<float>::max();
+        for(int q = 1; q < n; ++q) {
+            auto s = Intersection(q, v[k]);
+            while(s <= z[k]) {
+                --k;
+                s = Intersection(q, v[k]);
+            }
+            ++k;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = std::numeric_limits<float>::max();
+        }
+        
+        k = 0;
+        for(int q = 0; q < n; ++q) {
+            while(z[k + 1] < q) ++k;
+            m_vecfLineDistance[q] = rbt::sqr(q - v[k]) + f[v[k]];
+        }
+    }
+}
@@ -0,0 +1,102 @@
+//
+//  cost_map.h
+//  robotcontrol2
+//
+//  Layered cost map for the planners, one uint8 cost per grid cell:
+//
+//  static layer: obstacles known in advance, e.g., from a floor plan
+//  occupancy layer: cells of the greyscale map darker than the free threshold
+//  visited layer: cells the robot has already passed, does not add to the cost
+//  inflation layer: cost by distance to the closest obstacle of the first two layers,
+//  c_nCostLethal on the obstacle, c_nCostInscribed within the robot radius, then
+//  decaying exponentially to 0 at c_nInflationDistance beyond the robot radius.
+//
+//  Layers only record the bounding rect of changed cells. The costs are composed
+//  lazily when queried and only within that rect, grown by the inflation radius.
+//
+
+#ifndef cost_map_h
+#define cost_map_h
+
+#include "geometry.h"
+#include "stage_statistics.h"
+#include "erosion.h"
+#include "arena.h"
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace rbt {
+    std::uint8_t const c_nCostLethal = 254; // obstacle
+    std::uint8_t const c_nCostInscribed = 253; // robot centered here touches an obstacle
+    int const c_nInflationDistance = 25; // cm beyond the robot radius with cost > 0
+    
+    struct CCostMap {
+        // fRobotRadius in cm. Greyscale values below nFreeThreshold are obstacles.
+        // Scratch maps of compose() are allocated from arena.
+        CCostMap(rbt::size<int> const& szn, int nScale, double fRobotRadius, std::uint8_t nFreeThreshold, CArena& arena, CStageStatistics& stats);
+        
+        // matnObstacles is CV_8UC1 of the map size, non-zero cells are obstacles
+        void setStaticObstacles(cv::Mat const& matnObstacles);
+        
+        // Must be called whenever a pixel of the greyscale map changes
+        void changed(rbt::point<int> const& pt, std::uint8_t nOld, std::uint8_t nNew) {
+            if((nOld < m_nFreeThreshold) != (nNew < m_nFreeThreshold)) {
+                m_matnOccupancy.at<std::uint8_t>(pt.y, pt.x) = nNew < m_nFreeThreshold ? 255 : 0;
+                m_rectnDirty |= pt;
+            }
+        }
+        
+        // Moves all layers by -sz, see rbt::scroll. Cells scrolled in are free and not visited.
+        void scroll(rbt::size<int> const& sz);
+        
+        // Marks the cells within nRadius of the line from ptnFrom to ptnTo as visited
+        void visited(rbt::point<int> const& ptnFrom, rbt::point<int> const& ptnTo, int nRadius);
+        void setVisitedMask(cv::Mat const& matnVisited); // CV_8UC1 of the map size, see VisitedMask()
+        
+        cv::Mat const& Costs(); // CV_8UC1
+        std::uint8_t cost(rbt::point<int> const& pt) { return Costs().at<std::uint8_t>(pt.y, pt.x); }
+        cv::Mat const& VisitedMask() const { return m_matnVisited; } // CV_8UC1, 1 if visited
+        int InflationRadius() const { return m_nInflationRadius; } // costs depend on cells this close
+        
+        // Bounding rect of the costs composed since the last call, may be rect<int>::empty()
+        rbt::rect<int> takeChanges();
+        
+        // True if the robot can't drive in a straight line from ptnFrom to ptnTo
+        static bool blocked(cv::Mat const& matnCost, rbt::point<int> const& ptnFrom, rbt::point<int> const& ptnTo);
+        
+    private:
+        void compose();
+        // Squared Euclidean distance transform of the first n values of m_vecfLine into
+        // m_vecfLineDistance, see Felzenszwalb and Huttenlocher, Distance Transforms of Sampled Functions
+        void DistanceTransformLine(int n);
+        
+        static int const c_nSubcells = 4;
+        
+        rbt::size<int> const m_szn;
+        int const m_nInflationRadius; // cells with cost > 0 around an obstacle
+        std::uint8_t const m_nFreeThreshold;
+        std::vector<std::uint8_t> m_vecnCost; // by distance in 1/c_nSubcells cells
+        
+        cv::Mat m_matnStatic;
+        cv::Mat m_matnOccupancy;
+        cv::Mat m_matnVisited;
+        cv::Mat m_matnCost;
+        
+        // Buffers of DistanceTransformLine, allocated once
+        std::vector<float> m_vecfLine;
+        std::vector<float> m_vecfLineDistance;
+        std::vector<int> m_veciParabola; // lower envelope of parabolas, by their vertex
+        std::vector<float> m_vecfBoundary; // where the parabolas of the lower envelope intersect
+        
+        rbt::rect<int> m_rectnDirty;
+        rbt::rect<int> m_rectnChanged; // see takeChanges()
+        
+        CArenaMatAllocator m_matallocator;
+        CStageStatistics& m_stats;
+    };
+}
+
+#endif /* cost_map_h */
@@ -0,0 +1,198 @@
+//
+//  coverage_planner.cpp
+//  robotcontrol2
+//
+
+#include "coverage_planner.h"
+#include "cost_map.h"
+#include "robot_controller_c.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <limits>
+
+namespace rbt {
+    namespace {
+        int const c_nEndTolerance = 30; // cm
+        double const c_fVisitedLane = 0.9; // lanes with this fraction of cells visited are done
+        
+        bool Overlap(int nBeginA, int nEndA, int nBeginB, int nEndB) { // both-inclusive
+            return nBeginA <= nEndB && nBeginB <= nEndA;
+        }
+    }
+    
+    CCoveragePlanner::CCoveragePlanner(rbt::size<int> const& szn, int nScale, CStageStatistics& stats)
+    :   m_nLaneSpacing(std::max(1, static_cast<int>(c_fSonarMaxDistance / nScale))),
+        m_nEndTolerance(std::max(1, c_nEndTolerance / nScale)),
+        m_vecvecsegment(szn.x),
+        m_rectnDirty{0, 0, szn.x - 1, szn.y - 1},
+        m_stats(stats)
+    {}
+    
+    void CCoveragePlanner::update(cv::Mat const& matnCost, rbt::rect<int> const& rectnChanged) {
+        if(rectnChanged.left <= rectnChanged.right) {
+            m_rectnDirty |= rbt::point<int>(rectnChanged.left, rectnChanged.bottom);
+            m_rectnDirty |= rbt::point<int>(rectnChanged.right, rectnChanged.top);
+        }
+        if(m_rectnDirty.right < m_rectnDirty.left) return;
+        RBT_TIME_STAGE(m_stats, stage_coverage);
+        auto const rectnDirty = m_rectnDirty;
+        m_rectnDirty = rbt::rect<int>::empty();
+        
+        int const cColumns = rbt::numeric_cast<int>(m_vecvecsegment.size());
+        m_veciCellRemoved.clear();
+        auto RemoveCellsIn = [&](int x) {
+            if(x < 0 || cColumns <= x) return;
+            for(auto const& segment : m_vecvecsegment[x]) {
+                if(0 <= segment.m_iCell) m_veciCellRemoved.push_back(segment.m_iCell);
+            }
+        };
+        
+        int xChangedBegin = std::numeric_limits<int>::max();
+        int xChangedEnd = std::numeric_limits<int>::lowest();
+        auto& vecsegment = m_vecsegmentColumn;
+        for(int x = std::max(rectnDirty.left, 0); x <= std::min(rectnDirty.right, cColumns - 1); ++x) {
+            vecsegment.clear();
+            for(int y = 0; y < matnCost.rows; ++y) {
+                if(matnCost.at<std::uint8_t>(y, x) < c_nCostInscribed) {
+                    if(vecsegment.empty() || vecsegment.back().m_nYEnd + 1 < y) {
+                        vecsegment.push_back({y, y, -1});
+                    } else {
+                        vecsegment.back().m_nYEnd = y;
+                    }
+                }
+            }
+            
+            auto& vecsegmentCached = m_vecvecsegment[x];
+            if(!std::equal(vecsegment.begin(), vecsegment.end(), vecsegmentCached.begin(), vecsegmentCached.end(),
+                           [](SSegment const& lhs, SSegment const& rhs) {
+                               return lhs.m_nYBegin == rhs.m_nYBegin && lhs.m_nYEnd == rhs.m_nYEnd;
+                           }))
+            {
+                // Cells ending or beginning next to a changed column may now continue
+                RemoveCellsIn(x - 1);
+                RemoveCellsIn(x);
+                RemoveCellsIn(x + 1);
+                vecsegmentCached = vecsegment;
+                xChangedBegin = std::min(xChangedBegin, x);
+                xChangedEnd = std::max(xChangedEnd, x);
+            }
+        }
+        if(xChangedEnd < xChangedBegin) return;
+        
+        std::sort(m_veciCellRemoved.begin(), m_veciCellRemoved.end());
+        m_veciCellRemoved.erase(std::unique(m_veciCellRemoved.begin(), m_veciCellRemoved.end()), m_veciCellRemoved.end());
+        
+        int xLinkBegin = std::max(xChangedBegin - 1, 0);
+        int xLinkEnd = std::min(xChangedEnd + 1, cColumns - 1);
+        for(int iCell : m_veciCellRemoved) {
+            xLinkBegin = std::min(xLinkBegin, m_veccell[iCell].m_nXBegin);
+            xLinkEnd = std::max(xLinkEnd, m_veccell[iCell].m_nXEnd);
+            removeCell(iCell);
+        }
+        link(xLinkBegin, xLinkEnd);
+    }
+    
+    void CCoveragePlanner::removeCell(int iCell) {
+        auto const& cell = m_veccell[iCell];
+        for(int x = cell.m_nXBegin; x <= cell.m_nXEnd; ++x) {
+            for(auto& segment : m_vecvecsegment[x]) {
+                if(iCell == segment.m_iCell) segment.m_iCell = -1;
+            }
+        }
+        m_veclane.erase(std::remove_if(m_veclane.begin(), m_veclane.end(), [&](SLane const& lane) {
+            return iCell == lane.m_iCell;
+        }), m_veclane.end());
+        m_veciCellFree.push_back(iCell);
+    }
+    
+    void CCoveragePlanner::link(int xBegin, int xEnd) {
+        auto& veciCellNew = m_veciCellNew;
+        veciCellNew.clear();
+        for(int x = xBegin; x <= xEnd; ++x) {
+            for(auto& segment : m_vecvecsegment[x]) {
+                if(0 <= segment.m_iCell) continue;
+                
+                // Continue the cell of the previous column if the segments overlap one to one
+                // and that cell is being rebuilt. Other cells ended there before and still do.
+                SSegment const* psegmentPrev = nullptr;
+                int cOverlaps = 0;
+                if(xBegin < x) {
+                    for(auto const& segmentPrev : m_vecvecsegment[x - 1]) {
+                        if(Overlap(segment.m_nYBegin, segment.m_nYEnd, segmentPrev.m_nYBegin, segmentPrev.m_nYEnd)) {
+                            psegmentPrev = &segmentPrev;
+                            ++cOverlaps;
+                        }
+                    }
+                }
+                if(1 == cOverlaps
+                && std::find(veciCellNew.begin(), veciCellNew.end(), psegmentPrev->m_iCell) != veciCellNew.end()
+                && x - 1 == m_veccell[psegmentPrev->m_iCell].m_nXEnd
+                && 1 == std::count_if(m_vecvecsegment[x].begin(), m_vecvecsegment[x].end(), [&](SSegment const& segmentNext) {
+                    return Overlap(segmentNext.m_nYBegin, segmentNext.m_nYEnd, psegmentPrev->m_nYBegin, psegmentPrev->m_nYEnd);
+                })) {
+                    segment.m_iCell = psegmentPrev->m_iCell;
+                    m_veccell[segment.m_iCell].m_nXEnd = x;
+                } else {
+                    if(m_veciCellFree.empty()) {
+                        segment.m_iCell = rbt::numeric_cast<int>(m_veccell.size());
+                        m_veccell.push_back({x, x});
+                    } else {
+                        segment.m_iCell = m_veciCellFree.back();
+                        m_veciCellFree.pop_back();
+                        m_veccell[segment.m_iCell] = {x, x};
+                    }
+                    veciCellNew.push_back(segment.m_iCell);
+                }
+            }
+        }
+        for(int iCell : veciCellNew) addLanes(iCell);
+    }
+    
+    void CCoveragePlanner::addLanes(int iCell) {
+        auto const& cell = m_veccell[iCell];
+        auto const nWidth = cell.m_nXEnd + 1 - cell.m_nXBegin;
+        // Lanes are centered in the cell, a cell narrower than the lane spacing gets one lane
+        auto const cLanes = std::max(1, (nWidth + m_nLaneSpacing / 2) / m_nLaneSpacing);
+        auto const xFirst = cell.m_nXBegin + (nWidth - (cLanes - 1) * m_nLaneSpacing) / 2;
+        for(int i = 0; i < cLanes; ++i) {
+            auto const x = std::min(xFirst + i * m_nLaneSpacing, cell.m_nXEnd);
+            for(auto const& segment : m_vecvecsegment[x]) {
+                if(iCell == segment.m_iCell && m_nEndTolerance < segment.m_nYEnd - segment.m_nYBegin) {
+                    m_veclane.push_back({
+                        rbt::point<int>(x, segment.m_nYBegin),
+                        rbt::point<int>(x, segment.m_nYEnd),
+                        iCell
+                    });
+                }
+            }
+        }
+    }
+    
+    bool CCoveragePlanner::visited(SLane const& lane, cv::Mat const& matnVisited) const {
+        int cVisited = 0;
+        for(int y = lane.m_ptnBegin.y; y <= lane.m_ptnEnd.y; ++y) {
+            if(matnVisited.at<std::uint8_t>(y, lane.m_ptnBegin.x)) ++cVisited;
+        }
+        return c_fVisitedLane * (lane.m_ptnEnd.y + 1 - lane.m_ptnBegin.y) <= cVisited;
+    }
+    
+    rbt::point<int> CCoveragePlanner::NextTarget(rbt::point<int> const& ptn, cv::Mat const& matnCost, cv::Mat const& matnVisited) const {
+        rbt::point<int> ptnBest = rbt::point<int>::invalid();
+        int nSqrDistanceBest = std::numeric_limits<int>::max();
+        for(auto const& lane : m_veclane) {
+            if(visited(lane, matnVisited)) continue;
+            
+            for(auto const& pairptn : {std::make_pair(lane.m_ptnBegin, lane.m_ptnEnd), std::make_pair(lane.m_ptnEnd, lane.m_ptnBegin)}) {
+                auto const nSqrDistance = (pairptn.first - ptn).SqrAbs();
+                if(nSqrDistance <= rbt::sqr(m_nEndTolerance)) {
+                    if(!CCostMap::blocked(matnCost, ptn, pairptn.second)) return pairptn.second; // sweep along this lane
+                } else if(nSqrDistance < nSqrDistanceBest && !CCostMap::blocked(matnCost, ptn, pairptn.first)) {
+                    nSqrDistanceBest = nSqrDistance;
+                    ptnBest = pairptn.first;
+                }
+            }
+        }
+        return ptnBest;
+    }
+}
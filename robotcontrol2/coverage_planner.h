@@ -0,0 +1,79 @@
+//
+//  coverage_planner.h
+//  robotcontrol2
+//
+//  Boustrophedon decomposition of the free space of the cost map for systematic coverage.
+//  The free cells of every column form segments. Segments of neighboring columns belong
+//  to the same cell as long as they overlap one to one, where segments split or merge
+//  new cells begin. Each cell is swept by vertical lanes c_fSonarMaxDistance apart, so
+//  the sideways sonars see everything between two lanes.
+//
+//  The decomposition is cached. update() recomputes the segments of the columns that
+//  changed, and only the cells with segments in or next to columns whose segments changed.
+//
+
+#ifndef coverage_planner_h
+#define coverage_planner_h
+
+#include "nonmoveable.h"
+#include "geometry.h"
+#include "stage_statistics.h"
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+namespace rbt {
+    struct CCoveragePlanner : rbt::nonmoveable {
+        CCoveragePlanner(rbt::size<int> const& szn, int nScale, CStageStatistics& stats);
+        
+        // rectnChanged is the region of matnCost changed since the last update, see CCostMap::takeChanges.
+        // The first update decomposes the whole map.
+        void update(cv::Mat const& matnCost, rbt::rect<int> const& rectnChanged);
+        
+        // The other end of the lane the robot is at the end of, if that lane hasn't been visited.
+        // Else the closest end of a lane that hasn't been visited and can be reached in a straight line.
+        // point<int>::invalid() if there is none.
+        rbt::point<int> NextTarget(rbt::point<int> const& ptn, cv::Mat const& matnCost, cv::Mat const& matnVisited) const;
+        
+        int cells() const { return rbt::numeric_cast<int>(m_veccell.size() - m_veciCellFree.size()); }
+    
+    private:
+        struct SSegment {
+            int m_nYBegin; // both-inclusive
+            int m_nYEnd;
+            int m_iCell; // -1 while unassigned
+        };
+        struct SCell {
+            int m_nXBegin; // both-inclusive
+            int m_nXEnd;
+        };
+        struct SLane {
+            rbt::point<int> m_ptnBegin;
+            rbt::point<int> m_ptnEnd;
+            int m_iCell;
+        };
+        
+        void removeCell(int iCell);
+        void link(int xBegin, int xEnd); // assigns cells to unassigned segments
+        void addLanes(int iCell);
+        bool visited(SLane const& lane, cv::Mat const& matnVisited) const;
+        
+        int const m_nLaneSpacing; // pixels
+        int const m_nEndTolerance; // pixels, robot is at the end of a lane
+        std::vector<std::vector<SSegment>> m_vecvecsegment; // per column, sorted by y
+        std::vector<SCell> m_veccell;
+        std::vector<int> m_veciCellFree; // indices of removed cells in m_veccell
+        std::vector<SLane> m_veclane;
+        rbt::rect<int> m_rectnDirty; // columns not yet updated, initially the whole map
+        
+        // Temporaries of update() and link(), keep their capacity
+        std::vector<SSegment> m_vecsegmentColumn;
+        std::vector<int> m_veciCellRemoved;
+        std::vector<int> m_veciCellNew;
+        
+        CStageStatistics& m_stats;
+    };
+}
+
+#endif /* coverage_planner_h */
@@ -11,32 +11,106 @@
 #include <iostream>
 
 namespace rbt {
+    namespace {
+        double const c_fPursuitLookahead = 30; // cm
+        double const c_fMinTurnRadius = 20; // cm, tighter curves are driven by turning in place
+        double const c_fGoalTolerance = 5; // cm
+        double const c_fTargetLookahead = 400; // cm, length of the rays FindTarget scans
+    }
+    
+    CEdgeFollowingStrategy::CEdgeFollowingStrategy(rbt::size<int> const& szn, motion_mode emotion, target_score escore, planning_mode eplanning, CStageStatistics& stats)
+        : m_matrgbMapFeatures(szn.y, szn.x, CV_8UC3)
+        , m_emotion(emotion)
+        , m_escore(escore)
+        , m_stats(stats)
+        , m_pursuit(c_fPursuitLookahead, c_fMinTurnRadius)
+        , m_planner(PlanAhead, eplanning, stats)
+    {}
+    
+    void CEdgeFollowingStrategy::save(SCheckpoint& checkpoint, COccupancyGrid const& occgrid) const {
+        checkpoint.m_nState = static_cast<int>(m_estate);
+        checkpoint.m_ptnTarget = rbt::point<int>::invalid() != m_ptnTarget
+            ? occgrid.toWorldCoordinates(m_ptnTarget)
+            : rbt::point<int>::invalid();
+        checkpoint.m_vecptfPath = m_pursuit.path();
+    }
+    
+    void CEdgeFollowingStrategy::restore(SCheckpoint const& checkpoint, COccupancyGrid const& occgrid) {
+        m_estate = 0 <= checkpoint.m_nState && checkpoint.m_nState <= static_cast<int>(state::following)
+            ? static_cast<state>(checkpoint.m_nState)
+            : state::stopped;
+        // The command may have been lost with the previous process, send it again.
+        // In the other states the robot continues what it did and reports the same commands.
+        if(state::start_turning == m_estate) m_estate = state::stopped;
+        if(state::following == m_estate && checkpoint.m_vecptfPath.empty()) m_estate = state::stopped;
+        
+        m_ptnWorldOrigin = occgrid.toGridCoordinates(rbt::point<double>::zero());
+        m_ptnTarget = rbt::point<int>::invalid() != checkpoint.m_ptnTarget
+            ? occgrid.toGridCoordinates(rbt::point<double>(checkpoint.m_ptnTarget))
+            : rbt::point<int>::invalid();
+        
+        m_pursuit.clear();
+        for(auto const& ptf : checkpoint.m_vecptfPath) m_pursuit.append(ptf);
+        m_bPlanAhead = true;
+        m_bPlanning = false;
+        m_rcmdLast = c_rcmdStop;
+    }
+    
+    int CEdgeFollowingStrategy::VisitedRadius(COccupancyGrid const& occgrid) {
+        // We try to pass obstacles at a distance <= nMaxExplorationDistance.
+        // We count points at m_fExplorationDistanceTolerance * nMaxExplorationDistance as visited.
+        int const nMaxExplorationDistance = occgrid.m_params.m_nMaxExplorationDistance / occgrid.m_nScale; // max pixel distance from area the robot cannot enter
+        return static_cast<int>(occgrid.m_params.m_fExplorationDistanceTolerance*nMaxExplorationDistance);
+    }
+    
     boost::optional<SRobotCommand> CEdgeFollowingStrategy::update(point<double> const& ptfPrev, point<double> const& ptf,
                                                                   double fYawPrev, double fYaw,
                                                                   ECommand ecmdLast,
-                                                                  COccupancyGrid const& occgrid) {
-        // Threshold first, converting eroded map to black & white. Decision to drive to a position is essentially binary.
-        // Either we can drive someplace or we can't.
-        cv::threshold(occgrid.ErodedMap(), m_matnMapThreshold, /* pixels >= */ 255*0.4, /* are set to */ 255, cv::THRESH_BINARY);
+                                                                  COccupancyGrid& occgrid) {
+        // Decision to drive to a position is essentially binary. Either we can drive someplace or we can't,
+        // i.e., the robot centered there does not touch an obstacle and the cost is below c_nCostInscribed.
+        auto& costmap = occgrid.CostMap();
+        
+        auto const ptnWorldOrigin = occgrid.toGridCoordinates(rbt::point<double>::zero());
+        if(rbt::point<int>::invalid() != m_ptnTarget) {
+            m_ptnTarget += ptnWorldOrigin - m_ptnWorldOrigin;
+        }
+        m_ptnWorldOrigin = ptnWorldOrigin;
         
-        int const nMaxExplorationDistance = 25 /*cm*/ / occgrid.m_nScale; // max pixel distance from eroded obstacle
-        double const fExplorationDistanceTolerance = 1.5;
         auto const ptn = occgrid.toGridCoordinates(ptf);
         auto const ptnPrev = occgrid.toGridCoordinates(ptfPrev);
         
         // Update the mask containing the robot's path
-        m_matnMapPathMask.create(m_matnMapThreshold.size(), CV_8UC1);
-        
-        // Draw a line along path with thickness 3*nMaxExplorationDistance.
-        // We try to path obstacles at a distance <= nMaxExplorationDistance.
-        // We count points at 1.5*nMaxExplorationDistance as visited to account for errors.
-        cv::line(m_matnMapPathMask, ptnPrev, ptn, 1, /*thickness*/ 2*fExplorationDistanceTolerance*nMaxExplorationDistance);
+        costmap.visited(ptnPrev, ptn, VisitedRadius(occgrid));
         
         // Draw recognized features for debugging
-        cvtColor(occgrid.ErodedMap(), m_matrgbMapFeatures, CV_GRAY2RGB);
-        m_matrgbMapFeatures.setTo(cv::Scalar(0,0,255), m_matnMapPathMask);
-        if(rbt::point<int>::invalid() != m_ptnTarget) {
-            cv::line(m_matrgbMapFeatures, ptn, m_ptnTarget, cv::Scalar(255,0,0), /*thickness*/ 1);
+        {
+            RBT_TIME_STAGE(m_stats, stage_color_conversion);
+            // Like cvtColor and setTo with the visited mask, but without cvtColor's parallel_for_ allocating a job
+            auto const& matnEroded = occgrid.ErodedMap();
+            auto const& matnVisited = costmap.VisitedMask();
+            for(int y = 0; y < matnEroded.rows; ++y) {
+                auto const* pnEroded = matnEroded.ptr<std::uint8_t>(y);
+                auto const* pnVisited = matnVisited.ptr<std::uint8_t>(y);
+                auto* prgb = m_matrgbMapFeatures.ptr<cv::Vec3b>(y);
+                for(int x = 0; x < matnEroded.cols; ++x) {
+                    prgb[x] = pnVisited[x] ? cv::Vec3b(0, 0, 255) : cv::Vec3b(pnEroded[x], pnEroded[x], pnEroded[x]);
+                }
+            }
+            if(rbt::point<int>::invalid() != m_ptnTarget) {
+                cv::line(m_matrgbMapFeatures, ptn, m_ptnTarget, cv::Scalar(255,0,0), /*thickness*/ 1);
+            }
+            auto const& vecptfPath = m_pursuit.path();
+            for(int i = 1; i < rbt::numeric_cast<int>(vecptfPath.size()); ++i) {
+                cv::line(m_matrgbMapFeatures,
+                         occgrid.toGridCoordinates(vecptfPath[i - 1]),
+                         occgrid.toGridCoordinates(vecptfPath[i]),
+                         cv::Scalar(255,0,0), /*thickness*/ 1);
+            }
+        }
+        
+        if(state::following == m_estate) {
+            return followPath(ptf, fYaw, ecmdLast, occgrid);
         }
         
         // New control command
@@ -57,8 +131,16 @@ namespace rbt {
                 }
             } else { // else state::stopped_after_turn, try to find new target, else stay still.
                 assert(state::stopped_after_turn == m_estate);
-                FindNewTarget(ptf, occgrid, nMaxExplorationDistance);
                 std::cout << "FindNewTarget after 360 turn." << std::endl;
+                if(motion_mode::pure_pursuit == m_emotion) {
+                    if(planPath(ptf, occgrid)) {
+                        m_estate = state::following;
+                        m_bPlanAhead = true;
+                        return followPath(ptf, fYaw, ecmdLast, occgrid);
+                    }
+                } else {
+                    m_ptnTarget = FindNewTarget(ptf, occgrid);
+                }
                 if(rbt::point<int>::invalid() == m_ptnTarget) std::cout << "No new target found!" << std::endl;
                 return c_rcmdStop;
             }
@@ -80,6 +162,7 @@ namespace rbt {
                 if(ecmdSTOP==ecmdLast) {
                     std::cout << "Stopped turn." << std::endl;
                     m_estate = state::moving;
+                    if(target_score::coverage != m_escore) planAhead(ptn, m_ptnTarget, occgrid); // lanes are cheap to find
                     return c_rcmdForward;
                 }
             } else {
@@ -91,15 +174,11 @@ namespace rbt {
                 // map turns black, Find best path to safe terrain.
                 // Build distance map on original map instead of erosion?
                 double const fLookahead = 20; // cm
-                cv::LineIterator itpt(m_matnMapThreshold,
-                                      ptn,
-                                      occgrid.toGridCoordinates(ptf + rbt::size<double>::fromAngleAndDistance(fYaw, fLookahead)));
-                for(int i = 0; i < itpt.count; ++i, ++itpt) {
-                    if(!m_matnMapThreshold.at<std::uint8_t>(itpt.pos())) {
-                        m_ptnTarget = rbt::point<int>::invalid();
-                        m_estate = state::stopped;
-                        return c_rcmdStop;
-                    }
+                if(ObstacleAhead(ptf, ptf + rbt::size<double>::fromAngleAndDistance(fYaw, fLookahead), occgrid)) {
+                    m_planner.cancel();
+                    m_ptnTarget = rbt::point<int>::invalid();
+                    m_estate = state::stopped;
+                    return c_rcmdStop;
                 }
                 
                 // Reached target
@@ -107,7 +186,12 @@ namespace rbt {
                 auto szPath = rbt::size<double>::fromAngleAndDistance(fYaw, 1.0);
                 auto szTarget = rbt::size<double>(szMove);
                 if(szPath * szTarget<=0) {
-                    m_ptnTarget = rbt::point<int>::invalid();
+                    // Turn to the next target right away if it was planned meanwhile, else make a 360 turn
+                    m_ptnTarget = SpeculativeTarget(ptn, occgrid);
+                    if(rbt::point<int>::invalid() != m_ptnTarget) {
+                        std::cout << "Use speculative target." << std::endl;
+                        RBT_COUNT(m_stats, m_cSpeculativeHits, 1);
+                    }
                     m_estate = state::stopped;
                     return c_rcmdStop;
                 }
@@ -118,43 +202,204 @@ namespace rbt {
         return boost::none;
     }
     
-    void CEdgeFollowingStrategy::FindNewTarget(point<double> const& ptf, COccupancyGrid const& occgrid, int const nMaxExplorationDistance ) {
-        assert(rbt::point<int>::invalid() == m_ptnTarget);
+    boost::optional<SRobotCommand> CEdgeFollowingStrategy::followPath(point<double> const& ptf, double fYaw,
+                                                                      ECommand ecmdLast,
+                                                                      COccupancyGrid& occgrid) {
+        assert(state::following == m_estate);
+        auto Stop = [&]() -> boost::optional<SRobotCommand> {
+            std::cout << "Stopped following path." << std::endl;
+            m_pursuit.clear();
+            m_planner.cancel();
+            m_bPlanning = false;
+            m_estate = state::stopped;
+            m_rcmdLast = c_rcmdStop;
+            return c_rcmdStop;
+        };
+        
+        // Lanes of the coverage planner are cheap to find, all other targets are planned on m_planner
+        auto const ptn = occgrid.toGridCoordinates(ptf);
+        if(!m_pursuit.empty() && ObstacleAhead(ptf, m_pursuit.lookahead(ptf), occgrid)) {
+            // Replan from the current position, the robot waits below until there is a path again
+            m_pursuit.clear();
+            m_planner.cancel();
+            m_bPlanning = false;
+            m_bPlanAhead = true;
+            if(target_score::coverage == m_escore) {
+                if(!planPath(ptf, occgrid)) return Stop();
+            } else {
+                planAhead(ptn, ptn, occgrid);
+                m_bPlanning = true;
+            }
+        } else if(m_bPlanAhead && !m_bPlanning && m_pursuit.remaining(ptf) < 2 * c_fPursuitLookahead) {
+            // Extend the path before reaching its end, so the robot keeps moving
+            if(target_score::coverage == m_escore) {
+                if(m_pursuit.remaining(ptf) < c_fPursuitLookahead) m_bPlanAhead = planPath(m_pursuit.back(), occgrid);
+            } else {
+                planAhead(ptn, occgrid.toGridCoordinates(m_pursuit.back()), occgrid);
+                m_bPlanning = true;
+            }
+        }
+        
+        if(m_bPlanning) {
+            if(auto const optptnTarget = m_planner.result()) {
+                m_bPlanning = false;
+                auto const ptnFrom = m_pursuit.empty() ? ptn : occgrid.toGridCoordinates(m_pursuit.back());
+                auto const ptnTarget = ValidTarget(*optptnTarget, ptnFrom, occgrid);
+                if(rbt::point<int>::invalid() != ptnTarget) {
+                    RBT_COUNT(m_stats, m_cSpeculativeHits, 1);
+                    if(m_pursuit.empty()) m_pursuit.append(ptf);
+                    m_pursuit.append(rbt::point<double>(occgrid.toWorldCoordinates(ptnTarget)));
+                } else if(rbt::point<int>::invalid() == *optptnTarget) {
+                    m_bPlanAhead = false; // no target left, else plan again with the current map
+                }
+            }
+        }
+        
+        if(m_pursuit.empty()) {
+            if(!m_bPlanning && !m_bPlanAhead) return Stop();
+            // Wait for the replanned path
+            if(ecmdSTOP == m_rcmdLast.m_cmd) return boost::none;
+            m_rcmdLast = c_rcmdStop;
+            return c_rcmdStop;
+        }
+        
+        if(m_pursuit.remaining(ptf) < c_fGoalTolerance) return Stop(); // make 360 turn again
+        
+        // Only send commands that change the wheel speeds
+        auto const rcmd = m_pursuit.command(ptf, fYaw);
+        if(ecmdMOVE == ecmdLast
+           && rcmd.arg.move.m_nSpeedLeft == m_rcmdLast.arg.move.m_nSpeedLeft
+           && rcmd.arg.move.m_nSpeedRight == m_rcmdLast.arg.move.m_nSpeedRight) {
+            return boost::none;
+        }
+        m_rcmdLast = rcmd;
+        return rcmd;
+    }
+    
+    bool CEdgeFollowingStrategy::planPath(point<double> const& ptf, COccupancyGrid& occgrid) {
+        auto const ptnTarget = FindNewTarget(ptf, occgrid);
+        if(rbt::point<int>::invalid() == ptnTarget) return false;
+        
+        if(m_pursuit.empty()) m_pursuit.append(ptf);
+        m_pursuit.append(rbt::point<double>(occgrid.toWorldCoordinates(ptnTarget)));
+        return true;
+    }
+    
+    bool CEdgeFollowingStrategy::ObstacleAhead(point<double> const& ptfFrom, point<double> const& ptfTo, COccupancyGrid& occgrid) {
+        auto const ptnFrom = occgrid.toGridCoordinates(ptfFrom);
+        auto const ptnTo = occgrid.toGridCoordinates(ptfTo);
+        occgrid.decayRegion(rbt::rect<int>::bound({ptnFrom, ptnTo}));
+        return CCostMap::blocked(occgrid.CostMap().Costs(), ptnFrom, ptnTo);
+    }
+    
+    void CEdgeFollowingStrategy::planAhead(rbt::point<int> const& ptn, rbt::point<int> const& ptnFrom, COccupancyGrid& occgrid) {
+        // Plan from ptnFrom on the map as it will be when the robot arrives there,
+        // i.e., with the way there visited
+        CTargetPlanner::SRequest const req{ptn, ptnFrom, VisitedRadius(occgrid), occgrid.m_nScale};
+        m_ptnPlanOrigin = m_ptnWorldOrigin;
+        occgrid.decayRegion(TargetRegion(ptnFrom, occgrid.m_nScale));
+        if(target_score::information_gain == m_escore) {
+            m_planner.request(req, occgrid.CostMap().Costs(), occgrid.CostMap().VisitedMask(),
+                              occgrid.InformationGain().UnknownSums(), occgrid.InformationGain().EntropySums());
+        } else {
+            m_planner.request(req, occgrid.CostMap().Costs(), occgrid.CostMap().VisitedMask(), SBlockedSums(), SBlockedSums());
+        }
+    }
+    
+    rbt::point<int> CEdgeFollowingStrategy::PlanAhead(CTargetPlanner::SRequest const& req, cv::Mat const& matnCost, cv::Mat& matnVisited,
+                                                      SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy) {
+        cv::line(matnVisited, req.m_ptnFrom, req.m_ptnTarget, 1, /*thickness*/ 2*req.m_nVisitedRadius);
+        return FindTarget(matnCost, matnVisited, sumsUnknown, sumsEntropy, req.m_ptnTarget, req.m_nScale);
+    }
+    
+    rbt::point<int> CEdgeFollowingStrategy::SpeculativeTarget(rbt::point<int> const& ptn, COccupancyGrid& occgrid) {
+        auto const optptnTarget = m_planner.result();
+        m_planner.cancel(); // planning may still be running, the robot is stopping anyway
+        return optptnTarget ? ValidTarget(*optptnTarget, ptn, occgrid) : rbt::point<int>::invalid();
+    }
+    
+    rbt::point<int> CEdgeFollowingStrategy::ValidTarget(rbt::point<int> const& ptnPlanned, rbt::point<int> const& ptn, COccupancyGrid& occgrid) {
+        if(rbt::point<int>::invalid() == ptnPlanned) return rbt::point<int>::invalid();
+        
+        // The map may have scrolled and changed since planning started. The target must still
+        // be close to an unvisited obstacle and reachable in a straight line.
+        auto const ptnTarget = ptnPlanned + (m_ptnWorldOrigin - m_ptnPlanOrigin);
+        occgrid.decayRegion(rbt::rect<int>::bound({ptn, ptnTarget}));
+        auto const& matnCost = occgrid.CostMap().Costs();
+        if(ptnTarget.x < 0 || matnCost.cols <= ptnTarget.x || ptnTarget.y < 0 || matnCost.rows <= ptnTarget.y) {
+            return rbt::point<int>::invalid();
+        }
+        auto const nCost = matnCost.at<std::uint8_t>(ptnTarget.y, ptnTarget.x);
+        if(0 == nCost || c_nCostInscribed <= nCost
+           || occgrid.CostMap().VisitedMask().at<std::uint8_t>(ptnTarget.y, ptnTarget.x)
+           || CCostMap::blocked(matnCost, ptn, ptnTarget)) {
+            return rbt::point<int>::invalid();
+        }
+        return ptnTarget;
+    }
+    
+    rbt::point<int> CEdgeFollowingStrategy::FindNewTarget(point<double> const& ptf, COccupancyGrid& occgrid) {
+        auto const ptn = occgrid.toGridCoordinates(ptf);
+        if(target_score::coverage == m_escore) {
+            auto& costmap = occgrid.CostMap();
+            if(!m_pcoverage) m_pcoverage = std::make_unique<CCoveragePlanner>(occgrid.m_szn, occgrid.m_nScale, m_stats);
+            occgrid.decayRegion(rbt::rect<int>{0, 0, occgrid.m_szn.x - 1, occgrid.m_szn.y - 1}); // the cells are decomposed from the whole map
+            m_pcoverage->update(costmap.Costs(), costmap.takeChanges());
+            auto const ptnTarget = m_pcoverage->NextTarget(ptn, costmap.Costs(), costmap.VisitedMask());
+            if(rbt::point<int>::invalid() != ptnTarget) return ptnTarget;
+        }
+        
+        occgrid.decayRegion(TargetRegion(ptn, occgrid.m_nScale));
+        RBT_TIME_STAGE(m_stats, stage_ray_scan);
+        RBT_COUNT(m_stats, m_cRaysWalked, 360);
+        if(target_score::information_gain == m_escore) {
+            return FindTarget(occgrid.CostMap().Costs(), occgrid.CostMap().VisitedMask(),
+                              occgrid.InformationGain().UnknownSums(), occgrid.InformationGain().EntropySums(),
+                              ptn, occgrid.m_nScale);
+        }
+        return FindTarget(occgrid.CostMap().Costs(), occgrid.CostMap().VisitedMask(), SBlockedSums(), SBlockedSums(), ptn, occgrid.m_nScale);
+    }
+    
+    rbt::rect<int> CEdgeFollowingStrategy::TargetRegion(rbt::point<int> const& ptn, int nScale) {
+        int const n = rbt::numeric_cast<int>(std::ceil((c_fTargetLookahead + c_fSonarMaxDistance) / nScale));
+        return rbt::rect<int>{ptn.x - n, ptn.y - n, ptn.x + n, ptn.y + n};
+    }
+    
+    rbt::point<int> CEdgeFollowingStrategy::FindTarget(cv::Mat const& matnCost, cv::Mat const& matnVisited,
+                                                       SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy,
+                                                       rbt::point<int> const& ptn, int nScale) {
         // If there is no target, find new target to go to.
         // Strategy 1: Drive in closely past obstacles to scan them. Sonar sensors are very imprecise at large distances
         
-        // Calculate distances to obstacles
-        distanceTransform(m_matnMapThreshold, m_matfMapDistance, CV_DIST_L2, CV_DIST_MASK_PRECISE);
-        
-        // Ignore visited points in distance map
-        m_matfMapDistance.setTo(std::numeric_limits<float>::max(), m_matnMapPathMask);
+        // The inflation layer of the cost map already holds the distance to obstacles.
+        // Cells with 0 < cost < c_nCostInscribed are at most c_nInflationDistance
+        // away from the area the robot cannot enter.
         
         // Calculate optimal angle to scan obstacles closely
-        double const fLookahead = 400;
-        auto const ptn = occgrid.toGridCoordinates(ptf);
+        double const fLookahead = c_fTargetLookahead / nScale; // pixels
+        int const nSonarRange = static_cast<int>(c_fSonarMaxDistance / nScale); // pixels
         
         interval<rbt::point<int>> intvlptnBest;
         double fValueBest = std::numeric_limits<double>::lowest();
         
         for(int i=0; i<360; i++) {
-            auto ptnTo = occgrid.toGridCoordinates(rbt::size<double>::fromAngleAndDistance(M_PI*i/180, fLookahead) + ptf);
+            auto ptnTo = ptn + rbt::size<int>(rbt::size<double>::fromAngleAndDistance(M_PI*i/180, fLookahead));
             
-            cv::LineIterator itpt(m_matfMapDistance, ptn, ptnTo);
+            cv::LineIterator itpt(matnCost, ptn, ptnTo);
             interval<rbt::point<int>> intvlnptn(rbt::point<int>::invalid(), rbt::point<int>::invalid());
             
             for(int i = 0; i < itpt.count; ++i, ++itpt) {
                 rbt::point<int> const ptnLine(itpt.pos());
-                // The distance map is overwritten with the path taken by the robot
-                // Use it only for scoring, not for collision detection.
-                float const fDistance = m_matfMapDistance.at<float>(itpt.pos());
-                bool const bOccupied = m_matnMapThreshold.at<std::uint8_t>(itpt.pos())==0;
-                assert(!bOccupied || fDistance <= 0 || fDistance==std::numeric_limits<float>::max());
+                // Visited cells close to obstacles are ignored for scoring, not for collision detection.
+                auto const nCost = matnCost.at<std::uint8_t>(itpt.pos());
+                bool const bOccupied = c_nCostInscribed <= nCost;
+                bool const bCloseToObstacle = 0<nCost && !bOccupied && !matnVisited.at<std::uint8_t>(itpt.pos());
                 
                 if(rbt::point<int>::invalid() != intvlnptn.begin) {
                     intvlnptn.end = ptnLine;
-                    if(bOccupied || nMaxExplorationDistance<fDistance) break;
+                    if(!bCloseToObstacle) break;
                 } else {
-                    if(0<fDistance && fDistance<=nMaxExplorationDistance) {
+                    if(bCloseToObstacle) {
                         intvlnptn.begin = ptnLine;
                         intvlnptn.end = ptnLine;
                     } else if(bOccupied) {
@@ -164,8 +409,15 @@ namespace rbt {
             }
             
             if(rbt::point<int>::invalid() != intvlnptn.begin) {
-                auto const fValue = rbt::numeric_cast<double>((intvlnptn.end - intvlnptn.begin).SqrAbs())
-                    / std::max((intvlnptn.begin - ptn).SqrAbs(), 1);
+                // Either the length of the unvisited interval relative to its distance, or
+                // what a sonar sweep at its end could reveal, discounted by the driving distance.
+                auto const fValue = sumsEntropy.empty()
+                    ? rbt::numeric_cast<double>((intvlnptn.end - intvlnptn.begin).SqrAbs())
+                        / std::max((intvlnptn.begin - ptn).SqrAbs(), 1)
+                    : CInformationGain::gain(sumsUnknown, sumsEntropy, rbt::rect<int>{
+                            intvlnptn.end.x - nSonarRange, intvlnptn.end.y - nSonarRange,
+                            intvlnptn.end.x + nSonarRange, intvlnptn.end.y + nSonarRange
+                        }) / (1 + (intvlnptn.end - ptn).Abs() * nScale / 100.0);
                 
                 if(fValueBest<fValue) {
                     fValueBest = fValue;
@@ -174,11 +426,11 @@ namespace rbt {
             }
         }
         
-        if(std::numeric_limits<double>::lowest()<fValueBest) {
-            m_ptnTarget = intvlptnBest.end;
-        }
         // TODO: Strategy 1 is essentially a local greedy algorithm that follows the next best path
         // Once all local paths are visited, there can still be unexplored parts of the map further
         // away. Find those using Dijkstra?
+        return std::numeric_limits<double>::lowest()<fValueBest
+            ? intvlptnBest.end
+            : rbt::point<int>::invalid();
     }
 }
\ No newline at end of file
@@ -10,36 +10,107 @@
 #define edge_following_strategy_hpp
 
 #include "occupancy_grid.h"
+#include "pure_pursuit.h"
+#include "target_planner.h"
+#include "coverage_planner.h"
 #include <boost/optional.hpp>
 
+#include <memory>
+
+// Drive continuously along the planned path instead of stopping and turning at every target
+#ifndef RBT_PURE_PURSUIT
+#define RBT_PURE_PURSUIT 0
+#endif
+
+// Score exploration targets by the unknown area and entropy a sonar sweep there could reveal
+#ifndef RBT_INFORMATION_GAIN
+#define RBT_INFORMATION_GAIN 0
+#endif
+
+// Sweep the free space in lanes before following obstacles, takes precedence over RBT_INFORMATION_GAIN
+#ifndef RBT_COVERAGE
+#define RBT_COVERAGE 0
+#endif
+
 namespace rbt {
+    enum class motion_mode {
+        stop_and_turn, // turn in place towards the target, then drive straight to it
+        pure_pursuit // follow a path of targets with CPurePursuit, plan the next target on CTargetPlanner before reaching the last one
+    };
+    
+    enum class target_score {
+        interval_length, // prefer long unvisited stretches along obstacles close to the robot
+        information_gain, // prefer targets with many unknown or uncertain cells within sonar range
+        coverage // sweep the lanes of CCoveragePlanner, then fall back to interval_length
+    };
+    
     struct CEdgeFollowingStrategy {
-        CEdgeFollowingStrategy() {}
+        CEdgeFollowingStrategy(rbt::size<int> const& szn, motion_mode emotion, target_score escore, planning_mode eplanning, CStageStatistics& stats);
         boost::optional<SRobotCommand> update(point<double> const& ptfPrev, point<double> const& ptf,
                                               double fYawPrev, double fYaw,
                                               ECommand ecmdLast,
-                                              COccupancyGrid const& occgrid);
+                                              COccupancyGrid& occgrid);
         
         cv::Mat const& FeatureRGBMap() const { return m_matrgbMapFeatures; }
         
+        // State, target and path in world coordinates. A speculative target being planned is not saved.
+        void save(SCheckpoint& checkpoint, COccupancyGrid const& occgrid) const;
+        void restore(SCheckpoint const& checkpoint, COccupancyGrid const& occgrid); // after COccupancyGrid::restore
+        
     private:
-        void FindNewTarget(point<double> const& ptf, COccupancyGrid const& occgrid, int const nMaxExplorationDistance );
-            
-        cv::Mat m_matnMapThreshold;
-        cv::Mat m_matnMapPathMask;
+        boost::optional<SRobotCommand> followPath(point<double> const& ptf, double fYaw,
+                                                  ECommand ecmdLast,
+                                                  COccupancyGrid& occgrid);
+        bool planPath(point<double> const& ptf, COccupancyGrid& occgrid); // appends next target to m_pursuit
+        // Starts planning the next target from ptnFrom on m_planner, ptn is the robot position
+        void planAhead(rbt::point<int> const& ptn, rbt::point<int> const& ptnFrom, COccupancyGrid& occgrid);
+        // CTargetPlanner::FnPlan, runs on the planning thread unless planning_mode::synchronous
+        static rbt::point<int> PlanAhead(CTargetPlanner::SRequest const& req, cv::Mat const& matnCost, cv::Mat& matnVisited,
+                                         SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy);
+        // Result of planAhead if it is still valid, else point<int>::invalid()
+        rbt::point<int> SpeculativeTarget(rbt::point<int> const& ptn, COccupancyGrid& occgrid);
+        // ptnPlanned if it is still a target reachable from ptn on the current map, else point<int>::invalid()
+        rbt::point<int> ValidTarget(rbt::point<int> const& ptnPlanned, rbt::point<int> const& ptn, COccupancyGrid& occgrid);
+        // Returns point<int>::invalid() if there is no target
+        rbt::point<int> FindNewTarget(point<double> const& ptf, COccupancyGrid& occgrid);
+        // Cells FindTarget reads from ptn: its rays, and the information gain within sonar range of their ends
+        static rbt::rect<int> TargetRegion(rbt::point<int> const& ptn, int nScale);
+        // Scores by information gain unless the summed-area tables of CInformationGain are empty
+        static rbt::point<int> FindTarget(cv::Mat const& matnCost, cv::Mat const& matnVisited,
+                                          SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy,
+                                          rbt::point<int> const& ptn, int nScale);
+        static bool ObstacleAhead(point<double> const& ptfFrom, point<double> const& ptfTo, COccupancyGrid& occgrid);
+        static int VisitedRadius(COccupancyGrid const& occgrid); // of the robot's path in the visited mask
         
-        cv::Mat m_matfMapDistance;
-
         cv::Mat m_matrgbMapFeatures; // for visualization only
         
+        motion_mode const m_emotion;
+        target_score const m_escore;
+        CStageStatistics& m_stats;
+        
         enum class state {
             stopped,
             start_turning,
             turning,
             moving,
-            stopped_after_turn
+            stopped_after_turn,
+            following // motion_mode::pure_pursuit only
         } m_estate = state::stopped;
         rbt::point<int> m_ptnTarget = rbt::point<int>::invalid();
+        rbt::point<int> m_ptnWorldOrigin = rbt::point<int>::invalid(); // in grid coordinates at the last update, moves if the map scrolls
+        
+        // motion_mode::pure_pursuit, path in world coordinates
+        CPurePursuit m_pursuit;
+        bool m_bPlanAhead = true; // false if no target was found from the end of the path
+        bool m_bPlanning = false; // m_planner plans the next target from the end of the path
+        SRobotCommand m_rcmdLast = c_rcmdStop;
+        
+        // motion_mode::stop_and_turn, next target planned while driving to m_ptnTarget
+        rbt::point<int> m_ptnPlanOrigin = rbt::point<int>::invalid(); // m_ptnWorldOrigin when planning started
+        
+        std::unique_ptr<CCoveragePlanner> m_pcoverage; // target_score::coverage, created on first use
+        
+        CTargetPlanner m_planner; // declared last, its thread must stop before the other members are destroyed
     };
 }
 #endif /* edge_following_strategy_hpp */
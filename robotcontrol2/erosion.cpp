@@ -0,0 +1,148 @@
+//
+//  erosion.cpp
+//  robotcontrol2
+//
+
+#include "erosion.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace rbt {
+    namespace {
+        // Minimum over windows of cbWindow values, anchored at the window center like cv::erode.
+        // Values outside the line are 255, so the map border does not erode.
+        // The padded line is divided into blocks of cbWindow values. Each window overlaps at most
+        // two blocks, so its minimum is the minimum of a block suffix and a block prefix.
+        void MinFilterLine(std::uint8_t const* pbSrc, std::uint8_t* pbDst, int cb, int cbWindow,
+                           std::uint8_t* pbPadded, std::uint8_t* pbForward, std::uint8_t* pbBackward) {
+            int const cbAnchor = cbWindow / 2;
+            int const cbPadded = cb + cbWindow - 1;
+            std::fill(pbPadded, pbPadded + cbAnchor, 255);
+            std::copy(pbSrc, pbSrc + cb, pbPadded + cbAnchor);
+            std::fill(pbPadded + cbAnchor + cb, pbPadded + cbPadded, 255);
+            
+            for(int iBlock = 0; iBlock < cbPadded; iBlock += cbWindow) {
+                int const iEnd = std::min(iBlock + cbWindow, cbPadded);
+                pbForward[iBlock] = pbPadded[iBlock];
+                for(int i = iBlock + 1; i < iEnd; ++i) pbForward[i] = std::min(pbForward[i - 1], pbPadded[i]);
+                pbBackward[iEnd - 1] = pbPadded[iEnd - 1];
+                for(int i = iEnd - 2; iBlock <= i; --i) pbBackward[i] = std::min(pbBackward[i + 1], pbPadded[i]);
+            }
+            for(int i = 0; i < cb; ++i) {
+                pbDst[i] = std::min(pbBackward[i], pbForward[i + cbWindow - 1]);
+            }
+        }
+        
+        void MinRows(std::uint8_t const* pbA, std::uint8_t const* pbB, std::uint8_t* pbDst, int cb) {
+            for(int i = 0; i < cb; ++i) pbDst[i] = std::min(pbA[i], pbB[i]);
+        }
+    }
+    
+    CErosion::CErosion(rbt::size<int> const& szn, int nDiameter, erosion_mode emode, std::uint8_t nFreeThreshold)
+        : m_szn(szn)
+        , m_nDiameter(std::max(nDiameter, 1))
+        , m_emode(emode)
+        , m_nFreeThreshold(nFreeThreshold)
+    {
+        if(erosion_mode::square==m_emode) {
+            auto const cbLine = static_cast<std::size_t>(szn.x + m_nDiameter - 1);
+            m_vecnPadded.resize(cbLine);
+            m_vecnForward.resize(cbLine);
+            m_vecnBackward.resize(cbLine);
+            m_vecnWhite.assign(szn.x, 255);
+            m_matnRows.create(szn.y, szn.x, CV_8UC1);
+            m_matnForward.create(szn.y + m_nDiameter - 1, szn.x, CV_8UC1);
+            m_matnBackward.create(szn.y + m_nDiameter - 1, szn.x, CV_8UC1);
+        } else {
+            // nDiameter is the robot's diagonal, so the circle contains the robot at any yaw
+            auto const fRadius = m_nDiameter / 2.0;
+            int const nRadius = static_cast<int>(fRadius);
+            for(int y = -nRadius; y <= nRadius; ++y) {
+                int const nX = static_cast<int>(std::sqrt(std::max(0.0, rbt::sqr(fRadius) - rbt::sqr(y))));
+                m_vecspanDisk.push_back({y, -nX, nX});
+            }
+            m_matnObstacleChanges = cv::Mat(szn.y, szn.x + 1, CV_16UC1, cv::Scalar(0));
+        }
+    }
+    
+    void CErosion::erode(cv::Mat const& matnGreyscale, cv::Mat& matnEroded) {
+        assert(matnGreyscale.rows==m_szn.y && matnGreyscale.cols==m_szn.x && CV_8UC1==matnGreyscale.type());
+        matnEroded.create(m_szn.y, m_szn.x, CV_8UC1);
+        if(erosion_mode::square==m_emode) {
+            erodeSquare(matnGreyscale, matnEroded);
+        } else {
+            erodeCircle(matnGreyscale, matnEroded);
+        }
+    }
+    
+    void CErosion::reset(cv::Mat const& matnGreyscale) {
+        if(erosion_mode::circle==m_emode) {
+            m_matnObstacleChanges.setTo(cv::Scalar(0));
+            for(int y = 0; y < m_szn.y; ++y) {
+                auto const* pnGreyscale = matnGreyscale.ptr<std::uint8_t>(y);
+                for(int x = 0; x < m_szn.x; ++x) {
+                    if(pnGreyscale[x] < m_nFreeThreshold) addObstacle(rbt::point<int>(x, y), 1);
+                }
+            }
+        }
+    }
+    
+    void CErosion::erodeSquare(cv::Mat const& matnGreyscale, cv::Mat& matnEroded) {
+        for(int y = 0; y < m_szn.y; ++y) {
+            MinFilterLine(matnGreyscale.ptr<std::uint8_t>(y), m_matnRows.ptr<std::uint8_t>(y), m_szn.x, m_nDiameter,
+                          m_vecnPadded.data(), m_vecnForward.data(), m_vecnBackward.data());
+        }
+        
+        // Same as MinFilterLine, but for whole rows at once so the inner loops run along rows
+        int const nAnchor = m_nDiameter / 2;
+        int const cPadded = m_szn.y + m_nDiameter - 1;
+        auto const Padded = [&](int y) -> std::uint8_t const* {
+            return y < nAnchor || m_szn.y + nAnchor <= y ? m_vecnWhite.data() : m_matnRows.ptr<std::uint8_t>(y - nAnchor);
+        };
+        for(int yBlock = 0; yBlock < cPadded; yBlock += m_nDiameter) {
+            int const yEnd = std::min(yBlock + m_nDiameter, cPadded);
+            std::copy(Padded(yBlock), Padded(yBlock) + m_szn.x, m_matnForward.ptr<std::uint8_t>(yBlock));
+            for(int y = yBlock + 1; y < yEnd; ++y) {
+                MinRows(m_matnForward.ptr<std::uint8_t>(y - 1), Padded(y), m_matnForward.ptr<std::uint8_t>(y), m_szn.x);
+            }
+            std::copy(Padded(yEnd - 1), Padded(yEnd - 1) + m_szn.x, m_matnBackward.ptr<std::uint8_t>(yEnd - 1));
+            for(int y = yEnd - 2; yBlock <= y; --y) {
+                MinRows(m_matnBackward.ptr<std::uint8_t>(y + 1), Padded(y), m_matnBackward.ptr<std::uint8_t>(y), m_szn.x);
+            }
+        }
+        for(int y = 0; y < m_szn.y; ++y) {
+            MinRows(m_matnBackward.ptr<std::uint8_t>(y), m_matnForward.ptr<std::uint8_t>(y + m_nDiameter - 1), matnEroded.ptr<std::uint8_t>(y), m_szn.x);
+        }
+    }
+    
+    void CErosion::erodeCircle(cv::Mat const& matnGreyscale, cv::Mat& matnEroded) const {
+        for(int y = 0; y < m_szn.y; ++y) {
+            auto const* pnChanges = m_matnObstacleChanges.ptr<std::uint16_t>(y);
+            auto const* pnGreyscale = matnGreyscale.ptr<std::uint8_t>(y);
+            auto* pnEroded = matnEroded.ptr<std::uint8_t>(y);
+            std::uint16_t nObstacles = 0;
+            for(int x = 0; x < m_szn.x; ++x) {
+                nObstacles = static_cast<std::uint16_t>(nObstacles + pnChanges[x]);
+                pnEroded[x] = 0 < nObstacles ? 0 : pnGreyscale[x];
+            }
+        }
+    }
+    
+    void CErosion::addObstacle(rbt::point<int> const& pt, int nDelta) {
+        for(auto const& span : m_vecspanDisk) {
+            int const y = pt.y + span.m_nY;
+            if(y < 0 || m_szn.y <= y) continue;
+            
+            // The count changes by nDelta at the start of the span and back after its end
+            auto* pnChanges = m_matnObstacleChanges.ptr<std::uint16_t>(y);
+            int const xBegin = std::max(pt.x + span.m_nXBegin, 0);
+            int const xEnd = std::min(pt.x + span.m_nXEnd, m_szn.x - 1);
+            if(xEnd < xBegin) continue;
+            pnChanges[xBegin] = static_cast<std::uint16_t>(pnChanges[xBegin] + nDelta);
+            pnChanges[xEnd + 1] = static_cast<std::uint16_t>(pnChanges[xEnd + 1] - nDelta);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+//
+//  erosion.h
+//  robotcontrol2
+//
+//  Erodes the greyscale map by the robot footprint, i.e., a pixel in the eroded map
+//  is free only if the robot centered at that pixel does not touch an obstacle.
+//  erode() is a pass over the whole map in both modes, and its cost per pixel does
+//  not depend on the robot size:
+//
+//  erosion_mode::square: Minimum over a square of nDiameter pixels, same result as
+//  cv::erode with a square kernel. Separable van Herk/Gil-Werman min filter, i.e.,
+//  three comparisons per pixel and direction.
+//
+//  erosion_mode::circle: Pixels within nDiameter/2 of an obstacle, i.e., a pixel
+//  darker than the free threshold, are set to 0. Each row stores by how much the
+//  number of obstacles within that radius changes from one pixel to the next. A pixel
+//  crossing the free threshold changes two entries per row of the disk, i.e., O(nDiameter),
+//  and erode() sums up each row while combining it with the greyscale map.
+//
+
+#ifndef erosion_h
+#define erosion_h
+
+#include "geometry.h"
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#ifndef RBT_CIRCULAR_EROSION
+#define RBT_CIRCULAR_EROSION 0
+#endif
+
+namespace rbt {
+    // Default of SRobotParameters::m_nFreeThreshold: greyscale values below are obstacles
+    // for the path planning, i.e., free is > 255 * 0.4
+    std::uint8_t const c_nFreeThreshold = 103;
+    
+    enum class erosion_mode {
+        square,
+        circle
+    };
+    
+    struct CErosion {
+        // Greyscale values below nFreeThreshold are obstacles
+        CErosion(rbt::size<int> const& szn, int nDiameter, erosion_mode emode, std::uint8_t nFreeThreshold);
+        
+        // Must be called whenever a pixel of the greyscale map changes
+        void changed(rbt::point<int> const& pt, std::uint8_t nOld, std::uint8_t nNew) {
+            if(erosion_mode::circle==m_emode && (nOld < m_nFreeThreshold) != (nNew < m_nFreeThreshold)) {
+                addObstacle(pt, nNew < m_nFreeThreshold ? 1 : -1);
+            }
+        }
+        
+        void erode(cv::Mat const& matnGreyscale, cv::Mat& matnEroded);
+        
+        // Rebuilds the incremental state after the greyscale map changed as a whole, e.g., scrolled
+        void reset(cv::Mat const& matnGreyscale);
+        
+    private:
+        void erodeSquare(cv::Mat const& matnGreyscale, cv::Mat& matnEroded);
+        void erodeCircle(cv::Mat const& matnGreyscale, cv::Mat& matnEroded) const;
+        void addObstacle(rbt::point<int> const& pt, int nDelta);
+        
+        rbt::size<int> const m_szn;
+        int const m_nDiameter;
+        erosion_mode const m_emode;
+        std::uint8_t const m_nFreeThreshold;
+        
+        // erosion_mode::square
+        std::vector<std::uint8_t> m_vecnPadded; // one row, padded with 255
+        std::vector<std::uint8_t> m_vecnForward; // van Herk g and h
+        std::vector<std::uint8_t> m_vecnBackward;
+        std::vector<std::uint8_t> m_vecnWhite; // padding row
+        cv::Mat m_matnRows; // horizontal pass
+        cv::Mat m_matnForward; // vertical pass, padded rows
+        cv::Mat m_matnBackward;
+        
+        // erosion_mode::circle
+        struct SSpan {
+            int m_nY;
+            int m_nXBegin;
+            int m_nXEnd; // both-inclusive
+        };
+        std::vector<SSpan> m_vecspanDisk; // relative to center
+        // CV_16UC1 with one column more than the map. The sum of a row up to x is the number of
+        // obstacles within the robot radius of pixel x, modulo 2^16 like all updates.
+        cv::Mat m_matnObstacleChanges;
+    };
+}
+
+#endif /* erosion_h */
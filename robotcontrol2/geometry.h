@@ -15,13 +15,14 @@
 
 #include <cstdint>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 
 #include "math.h"
 
 namespace rbt {
     template<typename T> struct size;
-
+    
     template<typename T>
     struct point :
         boost::equality_comparable<point<T>,
@@ -33,7 +34,7 @@ namespace rbt {
         
         point() = default;
         point(T _x, T _y) : x(_x), y(_y) {}
-
+        
         template<typename S>
         explicit point(S _x, S _y) : x(rbt::numeric_cast<T>(_x)), y(rbt::numeric_cast<T>(_y))
         {}
@@ -117,7 +118,7 @@ namespace rbt {
         
         interval<T>& operator|=(T const& t);
     };
-
+    
     template<typename T>
     point<T>& point<T>::operator+=(size<T> const& sz) {
         x += sz.x;
@@ -145,7 +146,7 @@ namespace rbt {
         y /= t;
         return *this;
     }
-
+    
     template<typename T>
     point<T>::operator cv::Point_<T>() const {
         return cv::Point_<T>(x, y);
@@ -198,7 +199,7 @@ namespace rbt {
             ? (y < 0 ? 2 : 1)
             : (y < 0 ? 3 : 0);
     }
-
+    
     template<typename T>
     size<T> size<T>::rotated(double fAngle) const {
         auto c = std::cos(fAngle);
@@ -248,5 +249,31 @@ namespace rbt {
         end = std::max(end, t);
         return *this;
     }
+    
+    // Moves the content of mat by -sz, i.e., the pixel at p moves to p - sz.
+    // Pixels scrolled in are set to scalarFill. Works in place, so scrolling doesn't allocate.
+    inline void scroll(cv::Mat& mat, rbt::size<int> const& sz, cv::Scalar const& scalarFill) {
+        auto const cbPixel = mat.elemSize();
+        int const cColsKept = std::max(mat.cols - std::abs(sz.x), 0);
+        int const xSrc = std::max(sz.x, 0);
+        int const xDst = std::max(-sz.x, 0);
+        auto const MoveRow = [&](int y) {
+            int const ySrc = y + sz.y;
+            if(0 < cColsKept && 0 <= ySrc && ySrc < mat.rows) {
+                std::memmove(mat.ptr(y) + xDst * cbPixel, mat.ptr(ySrc) + xSrc * cbPixel, cColsKept * cbPixel);
+            }
+        };
+        // Rows must not be overwritten before they have been moved
+        if(0 <= sz.y) {
+            for(int y = 0; y < mat.rows; ++y) MoveRow(y);
+        } else {
+            for(int y = mat.rows - 1; 0 <= y; --y) MoveRow(y);
+        }
+        
+        int const cRowsIn = std::min(std::abs(sz.y), mat.rows);
+        if(0 < cRowsIn) mat(cv::Rect(0, 0 < sz.y ? mat.rows - cRowsIn : 0, mat.cols, cRowsIn)).setTo(scalarFill);
+        int const cColsIn = mat.cols - cColsKept;
+        if(0 < cColsIn) mat(cv::Rect(0 < sz.x ? cColsKept : 0, 0, cColsIn, mat.rows)).setTo(scalarFill);
+    }
 }
 #endif /* geometry_h */
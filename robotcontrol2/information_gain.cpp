@@ -0,0 +1,167 @@
+//
+//  information_gain.cpp
+//  robotcontrol2
+//
+
+#include "information_gain.h"
+
+#include <assert.h>
+#include <cmath>
+#include <limits>
+
+namespace rbt {
+    namespace {
+        std::uint8_t const c_nUnknown = 128; // greyscale value of cells never observed
+        
+        void CreateSums(SBlockedSums& sums, int cRows, int cCols, int cTilesY, int cTilesX) {
+            sums.m_matnCells = cv::Mat(cRows, cCols, CV_32SC1, cv::Scalar(0));
+            sums.m_matnColumns = cv::Mat(cTilesY + 1, cCols, CV_32SC1, cv::Scalar(0));
+            sums.m_matnRows = cv::Mat(cRows, cTilesX + 1, CV_32SC1, cv::Scalar(0));
+            sums.m_matnTiles = cv::Mat(cTilesY + 1, cTilesX + 1, CV_32SC1, cv::Scalar(0));
+        }
+        
+        // Recomputes the border sums in the tile columns and tile rows with dirty tiles, starting at the
+        // lowest resp. leftmost dirty tile, and the tile sums above and right of the lowest leftmost one.
+        // A tile's total is the sum at its top right cell in m_matnCells.
+        void UpdateBorders(SBlockedSums& sums, std::vector<int> const& vecyTileDirty, std::vector<int> const& vecxTileDirty) {
+            auto const& matnCells = sums.m_matnCells;
+            int const cTilesX = rbt::numeric_cast<int>(vecyTileDirty.size());
+            int const cTilesY = rbt::numeric_cast<int>(vecxTileDirty.size());
+            
+            for(int xTile = 0; xTile < cTilesX; ++xTile) {
+                int const xEnd = std::min((xTile + 1) * c_nMapTileSize, matnCells.cols);
+                for(int yTile = vecyTileDirty[xTile]; yTile < cTilesY; ++yTile) {
+                    auto const* pnTop = matnCells.ptr<std::int32_t>(std::min((yTile + 1) * c_nMapTileSize, matnCells.rows) - 1);
+                    auto const* pnColumns = sums.m_matnColumns.ptr<std::int32_t>(yTile);
+                    auto* pnColumnsNext = sums.m_matnColumns.ptr<std::int32_t>(yTile + 1);
+                    for(int x = xTile * c_nMapTileSize; x < xEnd; ++x) pnColumnsNext[x] = pnColumns[x] + pnTop[x];
+                }
+            }
+            
+            int xTileMin = cTilesX;
+            int yTileMin = cTilesY;
+            for(int yTile = 0; yTile < cTilesY; ++yTile) {
+                if(cTilesX <= vecxTileDirty[yTile]) continue;
+                xTileMin = std::min(xTileMin, vecxTileDirty[yTile]);
+                yTileMin = std::min(yTileMin, yTile);
+                
+                int const yEnd = std::min((yTile + 1) * c_nMapTileSize, matnCells.rows);
+                for(int y = yTile * c_nMapTileSize; y < yEnd; ++y) {
+                    auto const* pnCells = matnCells.ptr<std::int32_t>(y);
+                    auto* pnRows = sums.m_matnRows.ptr<std::int32_t>(y);
+                    for(int xTile = vecxTileDirty[yTile]; xTile < cTilesX; ++xTile) {
+                        pnRows[xTile + 1] = pnRows[xTile] + pnCells[std::min((xTile + 1) * c_nMapTileSize, matnCells.cols) - 1];
+                    }
+                }
+            }
+            
+            for(int yTile = yTileMin; yTile < cTilesY; ++yTile) {
+                auto const* pnTop = matnCells.ptr<std::int32_t>(std::min((yTile + 1) * c_nMapTileSize, matnCells.rows) - 1);
+                auto const* pnTiles = sums.m_matnTiles.ptr<std::int32_t>(yTile);
+                auto* pnTilesNext = sums.m_matnTiles.ptr<std::int32_t>(yTile + 1);
+                for(int xTile = xTileMin; xTile < cTilesX; ++xTile) {
+                    auto const nTile = pnTop[std::min((xTile + 1) * c_nMapTileSize, matnCells.cols) - 1];
+                    pnTilesNext[xTile + 1] = pnTiles[xTile + 1] + pnTilesNext[xTile] - pnTiles[xTile] + nTile;
+                }
+            }
+        }
+    }
+    
+    void SBlockedSums::copyTo(SBlockedSums& sums) const {
+        m_matnCells.copyTo(sums.m_matnCells);
+        m_matnColumns.copyTo(sums.m_matnColumns);
+        m_matnRows.copyTo(sums.m_matnRows);
+        m_matnTiles.copyTo(sums.m_matnTiles);
+    }
+    
+    int SBlockedSums::sum(rbt::rect<int> const& rectn) const {
+        auto const left = std::max(rectn.left, 0);
+        auto const bottom = std::max(rectn.bottom, 0);
+        auto const right = std::min(rectn.right, m_matnCells.cols - 1);
+        auto const top = std::min(rectn.top, m_matnCells.rows - 1);
+        if(right < left || top < bottom) return 0;
+        
+        return prefix(right, top) - prefix(right, bottom - 1) - prefix(left - 1, top) + prefix(left - 1, bottom - 1);
+    }
+    
+    CInformationGain::CInformationGain(cv::Mat const& matnGreyscale, CStageStatistics& stats)
+    :   m_matnGreyscale(matnGreyscale),
+        m_cTilesX((matnGreyscale.cols + c_nMapTileSize - 1) / c_nMapTileSize),
+        m_cTilesY((matnGreyscale.rows + c_nMapTileSize - 1) / c_nMapTileSize),
+        m_vecbDirty(m_cTilesX * m_cTilesY, false),
+        m_vecyTileDirty(m_cTilesX, m_cTilesY),
+        m_vecxTileDirty(m_cTilesY, m_cTilesX),
+        m_stats(stats)
+    {
+        assert(static_cast<std::int64_t>(matnGreyscale.rows) * matnGreyscale.cols * c_nEntropyScale <= std::numeric_limits<std::int32_t>::max());
+        CreateSums(m_sumsUnknown, matnGreyscale.rows, matnGreyscale.cols, m_cTilesY, m_cTilesX);
+        CreateSums(m_sumsEntropy, matnGreyscale.rows, matnGreyscale.cols, m_cTilesY, m_cTilesX);
+        m_veciDirty.reserve(m_vecbDirty.size());
+        for(int i = 0; i < 256; ++i) {
+            auto const p = i / 255.0;
+            auto const fEntropy = 0 < p && p < 1 ? -(p * std::log2(p) + (1 - p) * std::log2(1 - p)) : 0.0;
+            m_anEntropy[i] = rbt::numeric_cast<int>(fEntropy * c_nEntropyScale);
+        }
+        reset();
+    }
+    
+    void CInformationGain::reset() {
+        for(int yTile = 0; yTile < m_cTilesY; ++yTile) {
+            for(int xTile = 0; xTile < m_cTilesX; ++xTile) markDirty(xTile, yTile);
+        }
+    }
+    
+    SBlockedSums const& CInformationGain::UnknownSums() {
+        update();
+        return m_sumsUnknown;
+    }
+    
+    SBlockedSums const& CInformationGain::EntropySums() {
+        update();
+        return m_sumsEntropy;
+    }
+    
+    void CInformationGain::update() {
+        if(m_veciDirty.empty()) return;
+        RBT_TIME_STAGE(m_stats, stage_information_gain);
+        
+        for(int iTile : m_veciDirty) {
+            updateTile(iTile % m_cTilesX, iTile / m_cTilesX);
+            m_vecbDirty[iTile] = false;
+        }
+        m_veciDirty.clear();
+        
+        UpdateBorders(m_sumsUnknown, m_vecyTileDirty, m_vecxTileDirty);
+        UpdateBorders(m_sumsEntropy, m_vecyTileDirty, m_vecxTileDirty);
+        std::fill(m_vecyTileDirty.begin(), m_vecyTileDirty.end(), m_cTilesY);
+        std::fill(m_vecxTileDirty.begin(), m_vecxTileDirty.end(), m_cTilesX);
+    }
+    
+    void CInformationGain::updateTile(int xTile, int yTile) {
+        // Sums at (x, y) cover the cells [xBegin, x] x [yBegin, y] of the tile
+        int const xBegin = xTile * c_nMapTileSize;
+        int const yBegin = yTile * c_nMapTileSize;
+        int const xEnd = std::min(xBegin + c_nMapTileSize, m_matnGreyscale.cols);
+        int const yEnd = std::min(yBegin + c_nMapTileSize, m_matnGreyscale.rows);
+        for(int y = yBegin; y < yEnd; ++y) {
+            auto const* pnGreyscale = m_matnGreyscale.ptr<std::uint8_t>(y);
+            auto* pnUnknown = m_sumsUnknown.m_matnCells.ptr<std::int32_t>(y);
+            auto* pnEntropy = m_sumsEntropy.m_matnCells.ptr<std::int32_t>(y);
+            auto const* pnUnknownPrev = yBegin < y ? m_sumsUnknown.m_matnCells.ptr<std::int32_t>(y - 1) : nullptr;
+            auto const* pnEntropyPrev = yBegin < y ? m_sumsEntropy.m_matnCells.ptr<std::int32_t>(y - 1) : nullptr;
+            
+            std::int32_t nUnknownRow = 0;
+            std::int32_t nEntropyRow = 0;
+            for(int x = xBegin; x < xEnd; ++x) {
+                nUnknownRow += c_nUnknown == pnGreyscale[x] ? 1 : 0;
+                nEntropyRow += m_anEntropy[pnGreyscale[x]];
+                pnUnknown[x] = (pnUnknownPrev ? pnUnknownPrev[x] : 0) + nUnknownRow;
+                pnEntropy[x] = (pnEntropyPrev ? pnEntropyPrev[x] : 0) + nEntropyRow;
+            }
+        }
+    }
+    
+    double CInformationGain::gain(SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy, rbt::rect<int> const& rectn) {
+        return sumsUnknown.sum(rectn) + static_cast<double>(sumsEntropy.sum(rectn)) / c_nEntropyScale;
+    }
+}
@@ -0,0 +1,108 @@
+//
+//  information_gain.h
+//  robotcontrol2
+//
+//  Summed-area tables of the unknown cells and of the entropy of the greyscale map,
+//  so the information a sonar sweep could gain in any rectangle is an O(1) query.
+//  The tables are blocked into map tiles: a changed cell only changes the sums of its
+//  own tile, the border sums of the tiles above and right of it in its tile column and
+//  tile row, and the table of tile sums. The tables are recomputed lazily for the tiles
+//  marked as changed, i.e., in O(changed tiles * tile + (rows + cols) * tile + tiles)
+//  instead of O(map).
+//
+
+#ifndef information_gain_h
+#define information_gain_h
+
+#include "robot_controller_c.h"
+
+#include "nonmoveable.h"
+#include "geometry.h"
+#include "stage_statistics.h"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace rbt {
+    // Summed-area table of a map in tiles of c_nMapTileSize x c_nMapTileSize cells. The sum of the
+    // cells [0, x] x [0, y] is the sum of four entries: the tiles left of and below the tile of (x, y),
+    // the cells below that tile in its tile column, the cells left of it in its tile row, and the
+    // cells of the tile itself. All tables are CV_32SC1.
+    struct SBlockedSums {
+        cv::Mat m_matnCells; // rows x cols, (y, x) sums the cells of its tile from the tile's bottom left cell
+        cv::Mat m_matnColumns; // (tile rows + 1) x cols, (yTile, x) sums the cells below tile row yTile from the left column of the tile of x
+        cv::Mat m_matnRows; // rows x (tile columns + 1), (y, xTile) sums the cells left of tile column xTile from the bottom row of the tile of y
+        cv::Mat m_matnTiles; // (tile rows + 1) x (tile columns + 1), (yTile, xTile) sums the tiles below yTile and left of xTile
+        
+        bool empty() const { return m_matnCells.empty(); }
+        void copyTo(SBlockedSums& sums) const; // reuses the buffers of sums
+        
+        // Sum of the cells [0, x] x [0, y], 0 if x < 0 or y < 0
+        int prefix(int x, int y) const {
+            if(x < 0 || y < 0) return 0;
+            int const xTile = x / c_nMapTileSize;
+            int const yTile = y / c_nMapTileSize;
+            return m_matnTiles.at<std::int32_t>(yTile, xTile) + m_matnColumns.at<std::int32_t>(yTile, x)
+                + m_matnRows.at<std::int32_t>(y, xTile) + m_matnCells.at<std::int32_t>(y, x);
+        }
+        // Sum of the cells in rectn, both-inclusive, clipped to the map
+        int sum(rbt::rect<int> const& rectn) const;
+    };
+    
+    struct CInformationGain : rbt::nonmoveable {
+        static int const c_nEntropyScale = 256; // entropy sums are in 1/256 bits
+        
+        // matnGreyscale must outlive this object
+        CInformationGain(cv::Mat const& matnGreyscale, CStageStatistics& stats);
+        
+        // Must be called whenever a pixel of the greyscale map changes
+        void changed(rbt::point<int> const& pt) {
+            markDirty(pt.x / c_nMapTileSize, pt.y / c_nMapTileSize);
+        }
+        void changed(int y, int xBegin, int xEnd) { // both-inclusive
+            for(int xTile = xBegin / c_nMapTileSize; xTile <= xEnd / c_nMapTileSize; ++xTile) {
+                markDirty(xTile, y / c_nMapTileSize);
+            }
+        }
+        void reset(); // all pixels changed
+        
+        SBlockedSums const& UnknownSums();
+        SBlockedSums const& EntropySums();
+        
+        // Unknown cells plus entropy in bits of rectn. Unknown cells count twice,
+        // since they may hide obstacles while cells observed as 50% occupied don't.
+        static double gain(SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy, rbt::rect<int> const& rectn);
+    
+    private:
+        void markDirty(int xTile, int yTile) {
+            auto const iTile = yTile * m_cTilesX + xTile;
+            if(!m_vecbDirty[iTile]) {
+                m_vecbDirty[iTile] = true;
+                m_veciDirty.push_back(iTile);
+                m_vecyTileDirty[xTile] = std::min(m_vecyTileDirty[xTile], yTile);
+                m_vecxTileDirty[yTile] = std::min(m_vecxTileDirty[yTile], xTile);
+            }
+        }
+        void update();
+        void updateTile(int xTile, int yTile);
+        
+        cv::Mat const& m_matnGreyscale;
+        int const m_cTilesX;
+        int const m_cTilesY;
+        SBlockedSums m_sumsUnknown;
+        SBlockedSums m_sumsEntropy;
+        int m_anEntropy[256]; // per greyscale value, in 1/c_nEntropyScale bits
+        
+        std::vector<std::uint8_t> m_vecbDirty; // per tile
+        std::vector<int> m_veciDirty; // indices of dirty tiles
+        std::vector<int> m_vecyTileDirty; // per tile column, lowest dirty tile row or m_cTilesY
+        std::vector<int> m_vecxTileDirty; // per tile row, leftmost dirty tile column or m_cTilesX
+        
+        CStageStatistics& m_stats;
+    };
+}
+
+#endif /* information_gain_h */
@@ -0,0 +1,79 @@
+//
+//  map_pyramid.cpp
+//  robotcontrol2
+//
+
+#include "map_pyramid.h"
+
+#include <algorithm>
+
+namespace rbt {
+    CMapPyramid::CMapPyramid(cv::Mat const& matnGreyscale, std::uint8_t nFreeThreshold)
+    :   m_nFreeThreshold(nFreeThreshold)
+    {
+        rbt::size<int> szn(matnGreyscale.cols, matnGreyscale.rows);
+        while(1 < szn.x || 1 < szn.y) {
+            szn = rbt::size<int>((szn.x + 1) / 2, (szn.y + 1) / 2);
+            
+            SLevel level;
+            level.m_matnGreyscale = cv::Mat(szn.y, szn.x, CV_8UC1, cv::Scalar(0));
+            level.m_matnObstacles = cv::Mat(szn.y, szn.x, CV_8UC1, cv::Scalar(0));
+            level.m_vecbDirty.resize(szn.x * szn.y, false);
+            level.m_veciDirty.reserve(szn.x * szn.y);
+            m_veclevel.push_back(std::move(level));
+        }
+        reset(matnGreyscale);
+    }
+    
+    void CMapPyramid::reset(cv::Mat const& matnGreyscale) {
+        auto& levelFirst = m_veclevel.front();
+        for(int y = 0; y < levelFirst.m_matnGreyscale.rows; ++y) {
+            for(int x = 0; x < levelFirst.m_matnGreyscale.cols; ++x) {
+                markDirty(levelFirst, x, y);
+            }
+        }
+        update(matnGreyscale);
+    }
+    
+    void CMapPyramid::update(cv::Mat const& matnGreyscale) {
+        for(int iLevel = 0; iLevel < levels(); ++iLevel) {
+            auto& level = m_veclevel[iLevel];
+            // m_veclevel[0] is level 1, its children are the greyscale map itself whose obstacles are thresholded on the fly
+            auto const& matnGreyscaleChild = 0==iLevel ? matnGreyscale : m_veclevel[iLevel - 1].m_matnGreyscale;
+            auto const* pmatnObstaclesChild = 0==iLevel ? nullptr : &m_veclevel[iLevel - 1].m_matnObstacles;
+            
+            for(int i : level.m_veciDirty) {
+                int const x = i % level.m_matnGreyscale.cols;
+                int const y = i / level.m_matnGreyscale.cols;
+                
+                int nSum = 0;
+                int cChildren = 0;
+                bool bObstacle = false;
+                for(int yChild = 2 * y; yChild < std::min(2 * y + 2, matnGreyscaleChild.rows); ++yChild) {
+                    auto const* pnGreyscale = matnGreyscaleChild.ptr<std::uint8_t>(yChild);
+                    for(int xChild = 2 * x; xChild < std::min(2 * x + 2, matnGreyscaleChild.cols); ++xChild) {
+                        nSum += pnGreyscale[xChild];
+                        ++cChildren;
+                        bObstacle = bObstacle || (pmatnObstaclesChild
+                            ? 0 != pmatnObstaclesChild->at<std::uint8_t>(yChild, xChild)
+                            : pnGreyscale[xChild] < m_nFreeThreshold);
+                    }
+                }
+                
+                auto const nGreyscale = rbt::numeric_cast<std::uint8_t>((nSum + cChildren / 2) / cChildren);
+                auto const nObstacle = rbt::numeric_cast<std::uint8_t>(bObstacle ? 255 : 0);
+                auto& nGreyscaleOld = level.m_matnGreyscale.at<std::uint8_t>(y, x);
+                auto& nObstacleOld = level.m_matnObstacles.at<std::uint8_t>(y, x);
+                if(nGreyscale != nGreyscaleOld || nObstacle != nObstacleOld) {
+                    nGreyscaleOld = nGreyscale;
+                    nObstacleOld = nObstacle;
+                    if(iLevel + 1 < levels()) {
+                        markDirty(m_veclevel[iLevel + 1], x / 2, y / 2);
+                    }
+                }
+                level.m_vecbDirty[i] = false;
+            }
+            level.m_veciDirty.clear();
+        }
+    }
+}
@@ -0,0 +1,65 @@
+//
+//  map_pyramid.h
+//  robotcontrol2
+//
+//  Coarser versions of the greyscale map for planning and rendering at larger scales.
+//  Level i has one pixel per 2^i x 2^i grid cells, down to a single pixel.
+//  Each level holds the mean greyscale value and whether any cell is an obstacle,
+//  i.e., darker than the free threshold. update() only recomputes the ancestors
+//  of cells marked as changed and stops going up where a pixel doesn't change.
+//
+
+#ifndef map_pyramid_h
+#define map_pyramid_h
+
+#include "nonmoveable.h"
+#include "geometry.h"
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace rbt {
+    struct CMapPyramid : rbt::nonmoveable {
+        // Greyscale values below nFreeThreshold are obstacles
+        CMapPyramid(cv::Mat const& matnGreyscale, std::uint8_t nFreeThreshold);
+        
+        // Must be called whenever a pixel of the greyscale map changes
+        void changed(rbt::point<int> const& pt) {
+            markDirty(m_veclevel.front(), pt.x / 2, pt.y / 2);
+        }
+        void changed(int y, int xBegin, int xEnd) { // both-inclusive
+            for(int x = xBegin / 2; x <= xEnd / 2; ++x) {
+                markDirty(m_veclevel.front(), x, y / 2);
+            }
+        }
+        void update(cv::Mat const& matnGreyscale);
+        void reset(cv::Mat const& matnGreyscale); // recomputes all levels
+        
+        int levels() const { return rbt::numeric_cast<int>(m_veclevel.size()); }
+        // iLevel in [1, levels()]
+        cv::Mat const& Greyscale(int iLevel) const { return m_veclevel[iLevel - 1].m_matnGreyscale; } // mean
+        cv::Mat const& Obstacles(int iLevel) const { return m_veclevel[iLevel - 1].m_matnObstacles; } // 255 or 0
+    
+    private:
+        struct SLevel {
+            cv::Mat m_matnGreyscale;
+            cv::Mat m_matnObstacles;
+            std::vector<std::uint8_t> m_vecbDirty;
+            std::vector<int> m_veciDirty; // indices of dirty pixels
+        };
+        static void markDirty(SLevel& level, int x, int y) {
+            auto const i = y * level.m_matnGreyscale.cols + x;
+            if(!level.m_vecbDirty[i]) {
+                level.m_vecbDirty[i] = true;
+                level.m_veciDirty.push_back(i);
+            }
+        }
+        
+        std::uint8_t const m_nFreeThreshold;
+        std::vector<SLevel> m_veclevel; // m_veclevel[i] is level i + 1
+    };
+}
+
+#endif /* map_pyramid_h */
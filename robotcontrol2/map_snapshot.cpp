@@ -0,0 +1,76 @@
+//
+//  map_snapshot.cpp
+//  robotcontrol2
+//
+
+#include "map_snapshot.h"
+
+#include <algorithm>
+
+namespace rbt {
+    CMapSnapshot::CMapSnapshot(cv::Mat const& matnMap, rbt::point<int> const& ptCenter)
+    :   m_cTilesX((matnMap.cols + c_nMapTileSize - 1) / c_nMapTileSize),
+        m_cTilesY((matnMap.rows + c_nMapTileSize - 1) / c_nMapTileSize),
+        m_vecbDirty(m_cTilesX * m_cTilesY, false),
+        m_matnSnapshot(matnMap.clone()),
+        m_ptCenter(ptCenter),
+        m_vecnVersion(m_cTilesX * m_cTilesY, 1),
+        m_nVersion(1)
+    {
+        m_veciDirty.reserve(m_vecbDirty.size());
+    }
+    
+    cv::Rect CMapSnapshot::TileRect(int iTile) const {
+        auto const x = iTile % m_cTilesX * c_nMapTileSize;
+        auto const y = iTile / m_cTilesX * c_nMapTileSize;
+        return cv::Rect(x, y,
+                        std::min(c_nMapTileSize, m_matnSnapshot.cols - x),
+                        std::min(c_nMapTileSize, m_matnSnapshot.rows - y));
+    }
+    
+    void CMapSnapshot::invalidate() {
+        for(int iTile = 0; iTile < rbt::numeric_cast<int>(m_vecbDirty.size()); ++iTile) {
+            markDirty(iTile);
+        }
+    }
+    
+    void CMapSnapshot::publish(cv::Mat const& matnMap, rbt::point<int> const& ptCenter) {
+        if(m_veciDirty.empty()) return;
+        
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        if(!lock.owns_lock()) return; // a reader holds the snapshot
+        
+        ++m_nVersion;
+        m_ptCenter = ptCenter;
+        for(int iTile : m_veciDirty) {
+            auto const rect = TileRect(iTile);
+            cv::Mat matnTile = m_matnSnapshot(rect);
+            matnMap(rect).copyTo(matnTile);
+            m_vecnVersion[iTile] = m_nVersion;
+            m_vecbDirty[iTile] = false;
+        }
+        m_veciDirty.clear();
+    }
+    
+    std::uint64_t CMapSnapshot::lock(std::uint64_t nSinceVersion, std::vector<SMapTile>& vectile) {
+        m_mutex.lock();
+        vectile.clear();
+        for(int iTile = 0; iTile < rbt::numeric_cast<int>(m_vecnVersion.size()); ++iTile) {
+            if(nSinceVersion < m_vecnVersion[iTile]) {
+                auto const rect = TileRect(iTile);
+                vectile.push_back({
+                    m_matnSnapshot.ptr<std::uint8_t>(rect.y) + rect.x,
+                    static_cast<size_t>(rect.x),
+                    static_cast<size_t>(rect.y),
+                    static_cast<size_t>(rect.width),
+                    static_cast<size_t>(rect.height)
+                });
+            }
+        }
+        return m_nVersion;
+    }
+    
+    void CMapSnapshot::unlock() {
+        m_mutex.unlock();
+    }
+}
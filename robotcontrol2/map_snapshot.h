@@ -0,0 +1,71 @@
+//
+//  map_snapshot.h
+//  robotcontrol2
+//
+//  Stable copy of a map for other threads. The mapping thread marks changed pixels,
+//  publish() copies the changed tiles into the snapshot and increments the version.
+//  Readers lock the snapshot and get the tiles changed since the version they have seen.
+//  publish() never waits for a reader, it keeps the tiles dirty and tries again next time.
+//
+
+#ifndef map_snapshot_h
+#define map_snapshot_h
+
+#include "robot_controller_c.h"
+
+#include "nonmoveable.h"
+#include "geometry.h"
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace rbt {
+    struct CMapSnapshot : rbt::nonmoveable {
+        CMapSnapshot(cv::Mat const& matnMap, rbt::point<int> const& ptCenter);
+        
+        // Mapping thread
+        void changed(rbt::point<int> const& pt) {
+            markDirty(pt.y / c_nMapTileSize * m_cTilesX + pt.x / c_nMapTileSize);
+        }
+        void changed(int y, int xBegin, int xEnd) { // both-inclusive
+            for(int iTileX = xBegin / c_nMapTileSize; iTileX <= xEnd / c_nMapTileSize; ++iTileX) {
+                markDirty(y / c_nMapTileSize * m_cTilesX + iTileX);
+            }
+        }
+        void invalidate(); // all pixels changed
+        // ptCenter is passed through to readers, e.g., the world coordinates of the map center
+        void publish(cv::Mat const& matnMap, rbt::point<int> const& ptCenter);
+        
+        // Reader thread. Returns the current version, vectile are the tiles changed after nSinceVersion.
+        std::uint64_t lock(std::uint64_t nSinceVersion, std::vector<SMapTile>& vectile);
+        void unlock();
+        
+        cv::Mat const& Snapshot() const { return m_matnSnapshot; } // only while locked
+        rbt::point<int> const& Center() const { return m_ptCenter; } // only while locked
+    
+    private:
+        void markDirty(int iTile) {
+            if(!m_vecbDirty[iTile]) {
+                m_vecbDirty[iTile] = true;
+                m_veciDirty.push_back(iTile);
+            }
+        }
+        cv::Rect TileRect(int iTile) const;
+        
+        int const m_cTilesX;
+        int const m_cTilesY;
+        std::vector<std::uint8_t> m_vecbDirty; // mapping thread only
+        std::vector<int> m_veciDirty; // mapping thread only, indices of dirty tiles
+        
+        std::mutex m_mutex; // guards all members below
+        cv::Mat m_matnSnapshot;
+        rbt::point<int> m_ptCenter;
+        std::vector<std::uint64_t> m_vecnVersion; // per tile, version of last change
+        std::uint64_t m_nVersion;
+    };
+}
+
+#endif /* map_snapshot_h */
@@ -102,8 +102,9 @@ namespace rbt {
         rbt::size<double> m_szf;
         double m_fAngle;
         
+        // Calls foreach(y, interval<int> x) for every line in unspecified order
         template<typename Func>
-        void for_each_pixel(Func foreach) {
+        void for_each_span(Func foreach) {
             // Rotate the scaled rectangle.
             // TODO: For numerical precision, it may be better to rotate the rect
             // in world coordinates and then scale.
@@ -144,7 +145,7 @@ namespace rbt {
                 }
             };
             
-            // TODO: The map could be avoided by sorting the line segments
+            // Only used to build CFootprintStencil, so the map doesn't matter
             std::unordered_map<int, rbt::interval<int>> mapnintvlX;
             for(int i=0; i<boost::size(apt); ++i) {
                 rasterize(apt[i], apt[(i+1)%boost::size(apt)], [&](int x, int y) {
@@ -155,71 +156,327 @@ namespace rbt {
                 });
             }
             boost::for_each(mapnintvlX, [&](auto const& pairnintvlX) {
-                for(int x = pairnintvlX.second.begin; x <= pairnintvlX.second.end; ++x) {
-                    foreach(rbt::point<int>(x, pairnintvlX.first));
-                }
+                foreach(pairnintvlX.first, pairnintvlX.second);
             });
         }
     };
-
-    COccupancyGrid::COccupancyGrid(rbt::size<int> const& szn, int nScale)
-    :   m_szn(szn), m_nScale(nScale),
-        m_matfMapLogOdds(m_szn.x, m_szn.y, CV_32FC1, 0.0f),
-        m_matnMapGreyscale(m_szn.x, m_szn.y, CV_8UC1, 128),
-        m_matnMapEroded(m_szn.x, m_szn.y, CV_8UC1, 128)
+    
+    CFootprintStencil::CFootprintStencil(rbt::size<double> const& szf) {
+        for(int iYaw = 0; iYaw < c_cYawSteps; ++iYaw) {
+            m_aiSpan[iYaw] = rbt::numeric_cast<int>(m_vecspan.size());
+            SRotatedRect rect{rbt::point<int>::zero(), szf, 2 * M_PI * iYaw / c_cYawSteps};
+            rect.for_each_span([&](int y, rbt::interval<int> const& intvlX) {
+                m_vecspan.push_back({y, intvlX.begin, intvlX.end});
+            });
+            std::sort(m_vecspan.begin() + m_aiSpan[iYaw], m_vecspan.end(), [](SSpan const& lhs, SSpan const& rhs) {
+                return lhs.m_nY < rhs.m_nY;
+            });
+        }
+        m_aiSpan[c_cYawSteps] = rbt::numeric_cast<int>(m_vecspan.size());
+    }
+    
+    int CFootprintStencil::YawStep(double fYaw) {
+        auto const iYaw = static_cast<int>(std::lround(fYaw / (2 * M_PI) * c_cYawSteps)) % c_cYawSteps;
+        return iYaw < 0 ? iYaw + c_cYawSteps : iYaw;
+    }
+    
+    CSonarRayFan::CSonarRayFan(double fOpeningAngle, double fMaxRadius)
+    :   m_fOpeningAngle(fOpeningAngle),
+        m_fMaxRadius(fMaxRadius),
+        m_cRays([&] {
+            int cIntervals = 1;
+            while(cIntervals < fOpeningAngle * fMaxRadius) cIntervals *= 2;
+            return cIntervals + 1;
+        }()),
+        m_vecfCos(m_cRays),
+        m_vecfSin(m_cRays),
+        m_vecfStart(m_cRays, 0.0),
+        m_vecfDirX(m_cRays),
+        m_vecfDirY(m_cRays),
+        m_nHalfSide(rbt::numeric_cast<int>(std::ceil(fMaxRadius)) + 1),
+        m_vecnStamp(rbt::sqr(2 * m_nHalfSide + 1), 0)
     {
-        assert(0==szn.x%2 && 0==szn.y%2);
+        for(int i = 0; i < m_cRays; ++i) {
+            auto const fAngle = fOpeningAngle * (static_cast<double>(i) / (m_cRays - 1) - 0.5);
+            m_vecfCos[i] = std::cos(fAngle);
+            m_vecfSin[i] = std::sin(fAngle);
+            
+            // The fan without ray i has rays 2^(j+1) apart, with 2^j the largest power of 2 dividing i
+            if(0 < i && i < m_cRays - 1) {
+                int nSpacing = 2;
+                while(0 == i % nSpacing) nSpacing *= 2;
+                m_vecfStart[i] = std::max(0.0, (m_cRays - 1) / (fOpeningAngle * nSpacing) - 1);
+            }
+        }
     }
-
     
-    void COccupancyGrid::update(point<double> const& ptf, double fYaw, int nAngle, int nDistance) {
-        assert(nAngle==0 || std::abs(nAngle)==90);
-        auto const fAngleSonar = fYaw + M_PI_2 * rbt::sign(nAngle);
-        auto const ptnGrid = toGridCoordinates(ptf);
+    namespace {
+        // We overestimate robot size by taking robot diagonal
+        double RobotRadius() {
+            return std::sqrt(rbt::size<int>(c_nRobotWidth, c_nRobotHeight).SqrAbs()) / 2;
+        }
         
-        auto const fSqrMaxDistance = rbt::sqr(c_fSonarMaxDistance/m_nScale);
-        auto const fSqrMeasuredDistance = rbt::sqr((nDistance - c_fSonarDistanceTolerance/2)/m_nScale);
+        int ErosionDiameter(int nScale) {
+            return rbt::numeric_cast<int>(std::ceil(2 * RobotRadius() / nScale));
+        }
         
-        auto UpdateMap = [this](rbt::point<int> const& pt, float fValue) {
-            m_matfMapLogOdds.at<float>(pt.y, pt.x) = fValue;
-            auto const nColor = rbt::numeric_cast<std::uint8_t>(1.0 / ( 1.0 + std::exp( fValue )) * 255);
-            m_matnMapGreyscale.at<std::uint8_t>(pt.y, pt.x) = nColor;
-        };
+        int ScrollMargin(int nScale, SRobotParameters const& params) {
+            return rbt::numeric_cast<int>(std::ceil((c_fSonarMaxDistance + params.m_fSonarDistanceTolerance + RobotRadius()) / nScale));
+        }
         
-        SArc arc{ptnGrid,
-            fAngleSonar - c_fSonarOpeningAngle/2,
-            fAngleSonar + c_fSonarOpeningAngle/2,
-            (nDistance + c_fSonarDistanceTolerance/2)/m_nScale
-        };
-        arc.for_each_pixel([&](point<int> const& pt, double fSqrDistance) {
-            if(fSqrDistance < fSqrMaxDistance) {
-                auto const fInverseSensorModel = fSqrDistance < fSqrMeasuredDistance
-                    ? -0.5 // free
-                    : (100.0 / m_nScale) / std::sqrt(fSqrDistance); // occupied
-
-                UpdateMap(pt, m_matfMapLogOdds.at<float>(pt.y, pt.x) + fInverseSensorModel); // - prior which is 0
+        std::uint8_t Greyscale(float fLogOdds) {
+            return rbt::numeric_cast<std::uint8_t>(1.0 / ( 1.0 + std::exp( fLogOdds )) * 255);
+        }
+        
+        int const c_cDecayTilesPerUpdate = 8;
+    }
+    
+    COccupancyGrid::COccupancyGrid(rbt::size<int> const& szn, int nScale, grid_mode emode, SRobotParameters const& params, CArena& arena, CStageStatistics& stats)
+    :   m_szn(szn), m_nScale(nScale), m_params(params),
+        m_emode(emode),
+        m_esensormodel(RBT_RAY_CASTING ? sensor_model::rays : sensor_model::cone),
+        m_nScrollMargin(ScrollMargin(nScale, params)),
+        m_szOffset(0, 0),
+        m_fDecayTime(RBT_DECAY_TIME),
+        m_cTilesX((szn.x + c_nMapTileSize - 1) / c_nMapTileSize),
+        m_vecnTileTime(m_cTilesX * ((szn.y + c_nMapTileSize - 1) / c_nMapTileSize), 0),
+        m_vecnTileTimeScrolled(m_vecnTileTime.size()),
+        m_matfMapLogOdds(m_szn.y, m_szn.x, CV_32FC1, 0.0f),
+        m_matnMapGreyscale(m_szn.y, m_szn.x, CV_8UC1, 128),
+        m_matnMapEroded(m_szn.y, m_szn.x, CV_8UC1, 128),
+        m_snapshotGreyscale(m_matnMapGreyscale, WorldCenter()),
+        m_pyramid(m_matnMapGreyscale, params.m_nFreeThreshold),
+        m_infogain(m_matnMapGreyscale, stats),
+        m_erosion(szn, ErosionDiameter(nScale), RBT_CIRCULAR_EROSION ? erosion_mode::circle : erosion_mode::square, params.m_nFreeThreshold),
+        m_costmap(szn, nScale, RobotRadius(), params.m_nFreeThreshold, arena, stats),
+        m_stencilRobot(rbt::size<double>(c_nRobotWidth, c_nRobotHeight)/nScale),
+        m_rayfan(c_fSonarOpeningAngle, c_fSonarMaxDistance/nScale),
+        m_stats(stats)
+    {
+        assert(ValidSize(szn, nScale, emode, params));
+    }
+    
+    bool COccupancyGrid::ValidSize(rbt::size<int> const& szn, int nScale, grid_mode emode, SRobotParameters const& params) {
+        if(szn.x <= 0 || szn.y <= 0 || 0 != szn.x % 2 || 0 != szn.y % 2 || nScale <= 0) return false;
+        // Outside the margin, the robot is at least one tile from the center, so update scrolls by at least one tile
+        return grid_mode::fixed==emode || 2 * ScrollMargin(nScale, params) + 2 * c_nMapTileSize <= std::min(szn.x, szn.y);
+    }
+    
+    
+    void COccupancyGrid::update(point<double> const& ptf, double fYaw, int nAngle, int nDistance, std::int64_t nTime) {
+        update(ptf, fYaw, {SSonarMeasurement{ptf, fYaw, nAngle, nDistance}}, nTime);
+    }
+    
+    void COccupancyGrid::update(point<double> const& ptf, double fYaw, std::vector<SSonarMeasurement> const& vecmeas, std::int64_t nTime) {
+        m_nTimeUpdate = nTime;
+        if(grid_mode::scrolling==m_emode) {
+            auto const ptn = toGridCoordinates(ptf);
+            if(ptn.x < m_nScrollMargin || m_szn.x - m_nScrollMargin <= ptn.x
+            || ptn.y < m_nScrollMargin || m_szn.y - m_nScrollMargin <= ptn.y) {
+                // Move by whole tiles, so map snapshot tiles and pyramid pixels cover the same world area as before
+                auto const szn = ptn - (point<int>::zero() + m_szn/2);
+                scroll(rbt::size<int>(szn.x / c_nMapTileSize * c_nMapTileSize, szn.y / c_nMapTileSize * c_nMapTileSize), nTime);
             }
-        });
+        }
+        
+        std::uint64_t cCells = 0;
+        auto UpdateMap = [&](rbt::point<int> const& pt, float fValue) {
+            setLogOdds(pt, fValue);
+            ++cCells;
+        };
+        
+        {
+            RBT_TIME_STAGE(m_stats, stage_arc_rasterization);
+            boost::for_each(vecmeas, [&](SSonarMeasurement const& meas) {
+                assert(meas.m_nAngle==0 || std::abs(meas.m_nAngle)==90);
+                auto const fAngleSonar = meas.m_fYaw + M_PI_2 * rbt::sign(meas.m_nAngle);
+                
+                auto const fSqrMaxDistance = rbt::sqr(c_fSonarMaxDistance/m_nScale);
+                auto const fSqrMeasuredDistance = rbt::sqr((meas.m_nDistance - m_params.m_fSonarDistanceTolerance/2)/m_nScale);
+                
+                auto const ptnSonar = toGridCoordinates(meas.m_ptf);
+                auto const fRadius = (meas.m_nDistance + m_params.m_fSonarDistanceTolerance/2)/m_nScale;
+                auto UpdatePixel = [&](point<int> const& pt, double fSqrDistance) {
+                    // The cone may leave a fixed map
+                    if(fSqrDistance < fSqrMaxDistance && 0 <= pt.x && pt.x < m_szn.x && 0 <= pt.y && pt.y < m_szn.y) {
+                        decay(pt, nTime);
+                        auto const fInverseSensorModel = fSqrDistance < fSqrMeasuredDistance
+                            ? m_params.m_fLogOddsFree
+                            : (m_params.m_fLogOddsOccupied / m_nScale) / std::sqrt(fSqrDistance);
+                        
+                        UpdateMap(pt, m_matfMapLogOdds.at<float>(pt.y, pt.x) + fInverseSensorModel); // - prior which is 0
+                    }
+                };
+                
+                switch(m_esensormodel) {
+                    case sensor_model::cone:
+                        SArc{ptnSonar,
+                            fAngleSonar - c_fSonarOpeningAngle/2,
+                            fAngleSonar + c_fSonarOpeningAngle/2,
+                            fRadius
+                        }.for_each_pixel(UpdatePixel);
+                        break;
+                    case sensor_model::rays:
+                        m_rayfan.for_each_pixel(ptnSonar, fAngleSonar, fRadius, UpdatePixel);
+                        break;
+                }
+            });
+        }
         
         // Clear position of robot itself
-        SRotatedRect rectRobot{ptnGrid, rbt::size<double>(c_nRobotWidth, c_nRobotHeight)/m_nScale, fYaw};
-        rectRobot.for_each_pixel([&](rbt::point<int> const& pt) { UpdateMap(pt, -100); });
+        {
+            RBT_TIME_STAGE(m_stats, stage_robot_footprint);
+            float const fValue = -100;
+            auto const nColor = Greyscale(fValue);
+            m_stencilRobot.for_each_span(toGridCoordinates(ptf), fYaw, [&](int y, int xBegin, int xEnd) {
+                // Clip to the map, the robot may drive up to the border of a fixed map
+                if(y < 0 || m_szn.y <= y) return;
+                xBegin = std::max(xBegin, 0);
+                xEnd = std::min(xEnd, m_szn.x - 1);
+                if(xEnd < xBegin) return;
+                
+                for(int x = xBegin; x <= xEnd; x = (x / c_nMapTileSize + 1) * c_nMapTileSize) {
+                    decay(rbt::point<int>(x, y), nTime);
+                }
+                auto* pnGreyscale = m_matnMapGreyscale.ptr<std::uint8_t>(y);
+                for(int x = xBegin; x <= xEnd; ++x) {
+                    m_erosion.changed(rbt::point<int>(x, y), pnGreyscale[x], nColor);
+                    m_costmap.changed(rbt::point<int>(x, y), pnGreyscale[x], nColor);
+                }
+                std::fill(m_matfMapLogOdds.ptr<float>(y) + xBegin, m_matfMapLogOdds.ptr<float>(y) + xEnd + 1, fValue);
+                std::fill(pnGreyscale + xBegin, pnGreyscale + xEnd + 1, nColor);
+                m_snapshotGreyscale.changed(y, xBegin, xEnd);
+                m_pyramid.changed(y, xBegin, xEnd);
+                m_infogain.changed(y, xBegin, xEnd);
+                cCells += xEnd + 1 - xBegin;
+            });
+        }
+        RBT_COUNT(m_stats, m_cCellsTouched, cCells);
+        
+        if(0 < m_fDecayTime) {
+            for(int i = 0; i < c_cDecayTilesPerUpdate; ++i) {
+                decayTile(m_iTileDecay, nTime);
+                m_iTileDecay = (m_iTileDecay + 1) % rbt::numeric_cast<int>(m_vecnTileTime.size());
+            }
+        }
+        m_snapshotGreyscale.publish(m_matnMapGreyscale, WorldCenter());
+        m_pyramid.update(m_matnMapGreyscale);
         
         // Erode image
         // A pixel p in imageEroded is marked free when the robot centered at p does not occupy an occupied pixel in self.image
         // i.e. the pixel p has the maximum value of the surrounding pixels inside the diameter defined by the robot's size
-        // We overestimate robot size by taking robot diagonal        
-        static const int s_nKernelDiameter =
-            rbt::numeric_cast<int>(std::ceil(std::sqrt(rbt::size<int>(c_nRobotWidth, c_nRobotHeight).SqrAbs()) / m_nScale));
-        static const cv::Mat s_matnKernel = cv::Mat(s_nKernelDiameter, s_nKernelDiameter, CV_8UC1, 1);
-        cv::erode(m_matnMapGreyscale, m_matnMapEroded, s_matnKernel);
+        RBT_TIME_STAGE(m_stats, stage_erosion);
+        m_erosion.erode(m_matnMapGreyscale, m_matnMapEroded);
+    }
+    
+    void COccupancyGrid::setLogOdds(rbt::point<int> const& pt, float fValue) {
+        m_matfMapLogOdds.at<float>(pt.y, pt.x) = fValue;
+        auto const nColor = Greyscale(fValue);
+        auto& nColorOld = m_matnMapGreyscale.at<std::uint8_t>(pt.y, pt.x);
+        if(nColor != nColorOld) {
+            m_erosion.changed(pt, nColorOld, nColor);
+            m_costmap.changed(pt, nColorOld, nColor);
+            nColorOld = nColor;
+            m_snapshotGreyscale.changed(pt);
+            m_pyramid.changed(pt);
+            m_infogain.changed(pt);
+        }
+    }
+    
+    void COccupancyGrid::decayRegion(rbt::rect<int> const& rectn) {
+        if(m_fDecayTime <= 0 || m_nTimeUpdate < 0) return;
+        
+        auto const nMargin = m_costmap.InflationRadius();
+        int const xTileBegin = std::max(rectn.left - nMargin, 0) / c_nMapTileSize;
+        int const yTileBegin = std::max(rectn.bottom - nMargin, 0) / c_nMapTileSize;
+        int const xTileEnd = std::min(rectn.right + nMargin, m_szn.x - 1) / c_nMapTileSize; // inclusive
+        int const yTileEnd = std::min(rectn.top + nMargin, m_szn.y - 1) / c_nMapTileSize;
+        for(int yTile = yTileBegin; yTile <= yTileEnd; ++yTile) {
+            for(int xTile = xTileBegin; xTile <= xTileEnd; ++xTile) {
+                decayTile(yTile * m_cTilesX + xTile, m_nTimeUpdate);
+            }
+        }
+    }
+    
+    void COccupancyGrid::decayTile(int iTile, std::int64_t nTime) {
+        auto& nTileTime = m_vecnTileTime[iTile];
+        if(nTileTime < 0) { // restored cells start decaying now, the robot clock may have been reset
+            nTileTime = nTime;
+            return;
+        }
+        if(nTime <= nTileTime) return;
+        
+        RBT_COUNT(m_stats, m_cTilesDecayed, 1);
+        auto const fFactor = static_cast<float>(std::exp(-(nTime - nTileTime) / (m_fDecayTime * 1e6)));
+        nTileTime = nTime;
+        
+        auto const xBegin = iTile % m_cTilesX * c_nMapTileSize;
+        auto const yBegin = iTile / m_cTilesX * c_nMapTileSize;
+        for(int y = yBegin; y < std::min(yBegin + c_nMapTileSize, m_szn.y); ++y) {
+            auto const* pfLogOdds = m_matfMapLogOdds.ptr<float>(y);
+            for(int x = xBegin; x < std::min(xBegin + c_nMapTileSize, m_szn.x); ++x) {
+                if(0 != pfLogOdds[x]) setLogOdds(rbt::point<int>(x, y), pfLogOdds[x] * fFactor);
+            }
+        }
+    }
+    
+    void COccupancyGrid::scroll(rbt::size<int> const& sz, std::int64_t nTime) {
+        RBT_COUNT(m_stats, m_cMapScrolls, 1);
+        m_szOffset = rbt::size<int>(m_szOffset.x + sz.x, m_szOffset.y + sz.y);
+        
+        rbt::scroll(m_matfMapLogOdds, sz, cv::Scalar(0));
+        rbt::scroll(m_matnMapGreyscale, sz, cv::Scalar(128));
+        rbt::scroll(m_matnMapEroded, sz, cv::Scalar(128));
+        m_erosion.reset(m_matnMapGreyscale);
+        m_costmap.scroll(sz);
+        m_snapshotGreyscale.invalidate();
+        m_pyramid.reset(m_matnMapGreyscale);
+        m_infogain.reset();
+        
+        if(0 < m_fDecayTime) { // tiles scrolled in are up to date
+            auto const cTilesY = rbt::numeric_cast<int>(m_vecnTileTime.size()) / m_cTilesX;
+            std::fill(m_vecnTileTimeScrolled.begin(), m_vecnTileTimeScrolled.end(), nTime);
+            for(int yTile = 0; yTile < cTilesY; ++yTile) {
+                for(int xTile = 0; xTile < m_cTilesX; ++xTile) {
+                    auto const xTileSrc = xTile + sz.x / c_nMapTileSize;
+                    auto const yTileSrc = yTile + sz.y / c_nMapTileSize;
+                    if(0 <= xTileSrc && xTileSrc < m_cTilesX && 0 <= yTileSrc && yTileSrc < cTilesY) {
+                        m_vecnTileTimeScrolled[yTile * m_cTilesX + xTile] = m_vecnTileTime[yTileSrc * m_cTilesX + xTileSrc];
+                    }
+                }
+            }
+            m_vecnTileTime.swap(m_vecnTileTimeScrolled);
+        }
+    }
+    
+    void COccupancyGrid::save(SCheckpoint& checkpoint) const {
+        checkpoint.m_szOffset = m_szOffset;
+        m_matfMapLogOdds.copyTo(checkpoint.m_matfLogOdds);
+        m_costmap.VisitedMask().copyTo(checkpoint.m_matnVisited);
+    }
+    
+    void COccupancyGrid::restore(SCheckpoint const& checkpoint) {
+        assert(checkpoint.m_szn.x==m_szn.x && checkpoint.m_szn.y==m_szn.y && checkpoint.m_nScale==m_nScale);
+        m_szOffset = checkpoint.m_szOffset;
+        m_snapshotGreyscale.invalidate();
+        for(int y = 0; y < m_szn.y; ++y) {
+            auto const* pfLogOdds = checkpoint.m_matfLogOdds.ptr<float>(y);
+            for(int x = 0; x < m_szn.x; ++x) {
+                if(0 != pfLogOdds[x]) setLogOdds(rbt::point<int>(x, y), pfLogOdds[x]);
+            }
+        }
+        m_costmap.setVisitedMask(checkpoint.m_matnVisited);
+        std::fill(m_vecnTileTime.begin(), m_vecnTileTime.end(), -1);
+        m_erosion.erode(m_matnMapGreyscale, m_matnMapEroded);
+        m_snapshotGreyscale.publish(m_matnMapGreyscale, WorldCenter());
+        m_pyramid.update(m_matnMapGreyscale);
     }
     
     point<int> COccupancyGrid::toGridCoordinates(point<double> const& pt) const {
-        return point<int>(pt/m_nScale) + m_szn/2;
+        return point<int>(pt/m_nScale) + m_szn/2 - m_szOffset;
     }
-
+    
     point<int> COccupancyGrid::toWorldCoordinates(point<int> const& pt) const {
-        return (pt - m_szn/2) * m_nScale;
+        return (pt - m_szn/2 + m_szOffset) * m_nScale;
     }
 }
@@ -13,27 +13,228 @@
 
 #include "nonmoveable.h"
 #include "geometry.h"
+#include "stage_statistics.h"
+#include "erosion.h"
+#include "cost_map.h"
+#include "map_snapshot.h"
+#include "map_pyramid.h"
+#include "information_gain.h"
+#include "arena.h"
+#include "checkpoint.h"
 
 #include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Time constant in s of the decay of all cells towards the prior, so obstacles that moved away
+// disappear from the map. 0 turns decay off.
+#ifndef RBT_DECAY_TIME
+#define RBT_DECAY_TIME 0
+#endif
+
+#ifndef RBT_RAY_CASTING
+#define RBT_RAY_CASTING 0
+#endif
 
 namespace rbt {
+    struct SSonarMeasurement {
+        point<double> m_ptf; // robot pose when the measurement was taken
+        double m_fYaw;
+        int m_nAngle;
+        int m_nDistance; // from robot center
+    };
+    
+    // Robot footprint, rasterized once for c_cYawSteps yaw angles as horizontal spans
+    // relative to the robot center. Clearing the footprint is a walk over the spans.
+    struct CFootprintStencil {
+        explicit CFootprintStencil(rbt::size<double> const& szf);
+        
+        // Calls foreach(y, xBegin, xEnd) for every span, both-inclusive
+        template<typename Func>
+        void for_each_span(point<int> const& ptnCenter, double fYaw, Func foreach) const {
+            auto const iYaw = YawStep(fYaw);
+            for(int i = m_aiSpan[iYaw]; i < m_aiSpan[iYaw + 1]; ++i) {
+                auto const& span = m_vecspan[i];
+                foreach(ptnCenter.y + span.m_nY, ptnCenter.x + span.m_nXBegin, ptnCenter.x + span.m_nXEnd);
+            }
+        }
+        
+    private:
+        static int YawStep(double fYaw);
+        
+        struct SSpan {
+            int m_nY;
+            int m_nXBegin;
+            int m_nXEnd;
+        };
+        static int const c_cYawSteps = 128; // ~ 2.8 degrees
+        std::vector<SSpan> m_vecspan; // sorted by yaw step, then y
+        int m_aiSpan[c_cYawSteps + 1]; // spans of yaw step i are [m_aiSpan[i], m_aiSpan[i+1])
+    };
+    
+    // Sonar cone as a fan of 2^k + 1 rays, at most one pixel apart at sonar range, precomputed
+    // for the map scale. Shorter measurements use every 2nd, 4th ... ray. Each ray walks the
+    // pixels it crosses (Amanatides & Woo), pixels crossed by several rays are reported once.
+    // Near the sonar, every 2nd ray is only needed where the others are more than a pixel apart,
+    // so rays start at the distance where the next coarser fan begins to leave gaps.
+    struct CSonarRayFan {
+        CSonarRayFan(double fOpeningAngle, double fMaxRadius);
+        
+        // Calls foreach(pt, nSqrDistance) for every pixel closer than fRadius to ptnCenter
+        // crossed by a ray within fOpeningAngle/2 of fAngle
+        template<typename Func>
+        void for_each_pixel(point<int> const& ptnCenter, double fAngle, double fRadius, Func foreach) {
+            auto const fSqrRadius = rbt::sqr(std::min(fRadius, m_fMaxRadius));
+            if(0 == ++m_nStamp) {
+                std::fill(m_vecnStamp.begin(), m_vecnStamp.end(), 0);
+                m_nStamp = 1;
+            }
+            
+            int const cIntervals = m_cRays - 1;
+            int nStride = 1;
+            while(2 * nStride <= cIntervals && fRadius * m_fOpeningAngle * 2 * nStride <= cIntervals) nStride *= 2;
+            
+            auto const fCos = std::cos(fAngle);
+            auto const fSin = std::sin(fAngle);
+            for(int i = 0; i < m_cRays; i += nStride) {
+                m_vecfDirX[i] = fCos * m_vecfCos[i] - fSin * m_vecfSin[i];
+                m_vecfDirY[i] = fSin * m_vecfCos[i] + fCos * m_vecfSin[i];
+            }
+            
+            for(int i = 0; i < m_cRays; i += nStride) {
+                // Pixel (x, y) covers [x - 0.5, x + 0.5) x [y - 0.5, y + 0.5). fMaxX is the ray parameter
+                // of the next pixel border in x-direction, fDeltaX the distance between borders.
+                auto const fStart = m_vecfStart[i];
+                auto const fX = fStart * m_vecfDirX[i];
+                auto const fY = fStart * m_vecfDirY[i];
+                int x = static_cast<int>(std::lround(fX));
+                int y = static_cast<int>(std::lround(fY));
+                int const nStepX = m_vecfDirX[i] < 0 ? -1 : 1;
+                int const nStepY = m_vecfDirY[i] < 0 ? -1 : 1;
+                auto const fInfinity = std::numeric_limits<double>::infinity();
+                auto const fDeltaX = 0 != m_vecfDirX[i] ? 1 / std::abs(m_vecfDirX[i]) : fInfinity;
+                auto const fDeltaY = 0 != m_vecfDirY[i] ? 1 / std::abs(m_vecfDirY[i]) : fInfinity;
+                auto fMaxX = 0 != m_vecfDirX[i] ? fStart + (x + 0.5 * nStepX - fX) * nStepX * fDeltaX : fInfinity;
+                auto fMaxY = 0 != m_vecfDirY[i] ? fStart + (y + 0.5 * nStepY - fY) * nStepY * fDeltaY : fInfinity;
+                for(auto nSqrDistance = x * x + y * y; nSqrDistance < fSqrRadius; nSqrDistance = x * x + y * y) {
+                    auto& nStamp = m_vecnStamp[(y + m_nHalfSide) * (2 * m_nHalfSide + 1) + x + m_nHalfSide];
+                    if(m_nStamp != nStamp) {
+                        nStamp = m_nStamp;
+                        foreach(ptnCenter + rbt::size<int>(x, y), nSqrDistance);
+                    }
+                    if(fMaxX < fMaxY) {
+                        fMaxX += fDeltaX;
+                        x += nStepX;
+                    } else {
+                        fMaxY += fDeltaY;
+                        y += nStepY;
+                    }
+                }
+            }
+        }
+        
+    private:
+        double const m_fOpeningAngle;
+        double const m_fMaxRadius; // pixels
+        int const m_cRays;
+        std::vector<double> m_vecfCos; // per ray, direction relative to the sonar axis
+        std::vector<double> m_vecfSin;
+        std::vector<double> m_vecfStart; // per ray, pixels from the sonar
+        std::vector<double> m_vecfDirX; // per ray, direction of the current measurement
+        std::vector<double> m_vecfDirY;
+        
+        int const m_nHalfSide;
+        std::vector<std::uint32_t> m_vecnStamp; // per pixel around the sonar, m_nStamp if already reported
+        std::uint32_t m_nStamp = 0;
+    };
+    
+    enum class sensor_model {
+        cone, // all pixels in the sonar cone
+        rays // pixels crossed by CSonarRayFan
+    };
+    
+    enum class grid_mode {
+        fixed, // robot starts in the center of the grid
+        scrolling // grid is moved to center the robot whenever it gets within sonar range of the border
+    };
+    
     struct COccupancyGrid : rbt::nonmoveable {
-        COccupancyGrid(rbt::size<int> const& szn, int nScale);        
-        void update(point<double> const& ptf, double fYaw, int nAngle, int nDistance);
+        COccupancyGrid(rbt::size<int> const& szn, int nScale, grid_mode emode, SRobotParameters const& params, CArena& arena, CStageStatistics& stats);        
+        // True if szn is even and positive, and a scrolling grid is large enough to scroll by whole tiles
+        static bool ValidSize(rbt::size<int> const& szn, int nScale, grid_mode emode, SRobotParameters const& params);
+        // nTime in us
+        void update(point<double> const& ptf, double fYaw, int nAngle, int nDistance, std::int64_t nTime);
+        
+        // Inserts several measurements, clears the current robot position ptf, fYaw
+        // and erodes the map only once
+        void update(point<double> const& ptf, double fYaw, std::vector<SSonarMeasurement> const& vecmeas, std::int64_t nTime);
+        
+        // Copies the map layers into checkpoint, resp. replaces them with those of checkpoint.
+        // The checkpoint must have been taken from a grid of the same size and scale.
+        void save(SCheckpoint& checkpoint) const;
+        void restore(SCheckpoint const& checkpoint);
         
         point<int> toGridCoordinates(point<double> const& pt) const;
         point<int> toWorldCoordinates(point<int> const& pt) const;
+        point<int> WorldCenter() const { return toWorldCoordinates(point<int>::zero() + m_szn/2); } // cm
         
         cv::Mat const& GreyscaleMap() const { return m_matnMapGreyscale; }
         cv::Mat const& ErodedMap() const { return m_matnMapEroded; }
+        CCostMap& CostMap() { return m_costmap; }
+        CMapSnapshot& GreyscaleSnapshot() { return m_snapshotGreyscale; } // can be read from any thread
+        CMapPyramid const& Pyramid() const { return m_pyramid; }
+        CInformationGain& InformationGain() { return m_infogain; }
+        
+        grid_mode GridMode() const { return m_emode; }
+        
+        // Decays the cells in rectn, and the cells their costs depend on, to the time of the last update.
+        // Other cells may be stale until their turn comes, see decay(), so call this before reading them.
+        void decayRegion(rbt::rect<int> const& rectn);
         
         rbt::size<int> const m_szn;
         int const m_nScale; // cm per pixel
+        SRobotParameters const m_params;
         
     private:
+        void scroll(rbt::size<int> const& sz, std::int64_t nTime);
+        void setLogOdds(rbt::point<int> const& pt, float fValue);
+        
+        // Cells decay lazily, a whole tile at a time. A tile decays before any of its cells
+        // changes, before decayRegion() reads it, and c_cDecayTilesPerUpdate other tiles decay
+        // per update in turn. Tiles outside these regions, e.g., in the greyscale snapshot and
+        // the eroded map, lag by at most one turn, i.e., tiles / c_cDecayTilesPerUpdate updates.
+        void decay(rbt::point<int> const& pt, std::int64_t nTime) {
+            if(0 < m_fDecayTime) decayTile(pt.y / c_nMapTileSize * m_cTilesX + pt.x / c_nMapTileSize, nTime);
+        }
+        void decayTile(int iTile, std::int64_t nTime);
+        
+        grid_mode const m_emode;
+        sensor_model const m_esensormodel;
+        int const m_nScrollMargin; // min. distance of the robot from the border in pixels
+        rbt::size<int> m_szOffset; // world position of the grid center in pixels
+        
+        double const m_fDecayTime; // s, 0 if cells don't decay
+        int const m_cTilesX;
+        std::vector<std::int64_t> m_vecnTileTime; // per tile, time in us the cells have decayed to, < 0 after restore()
+        std::vector<std::int64_t> m_vecnTileTimeScrolled; // buffer of scroll()
+        int m_iTileDecay = 0; // next tile to decay in turn
+        std::int64_t m_nTimeUpdate = -1; // of the last update, < 0 before the first one
+        
         cv::Mat m_matfMapLogOdds;
         cv::Mat m_matnMapGreyscale;
         cv::Mat m_matnMapEroded;
+        CMapSnapshot m_snapshotGreyscale; // depends on m_matnMapGreyscale
+        CMapPyramid m_pyramid; // depends on m_matnMapGreyscale
+        CInformationGain m_infogain; // depends on m_matnMapGreyscale
+        
+        CErosion m_erosion; // depends on m_nScale
+        CCostMap m_costmap; // depends on m_nScale
+        CFootprintStencil const m_stencilRobot; // depends on m_nScale
+        CSonarRayFan m_rayfan; // depends on m_nScale
+        
+        CStageStatistics& m_stats;
     };
 }
 #endif /* occupancy_grid_h */
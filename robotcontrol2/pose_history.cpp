@@ -0,0 +1,93 @@
+//
+//  pose_history.cpp
+//  robotcontrol2
+//
+
+#include "pose_history.h"
+
+#include <algorithm>
+
+namespace rbt {
+    namespace {
+        double Interpolate(double fA, double fB, double f) {
+            return fA + (fB - fA) * f;
+        }
+        
+        rbt::point<double> Interpolate(rbt::point<double> const& ptfA, rbt::point<double> const& ptfB, double f) {
+            auto szf = ptfB - ptfA;
+            szf *= f;
+            auto ptf = ptfA;
+            ptf += szf;
+            return ptf;
+        }
+        
+        template<typename T>
+        T InterpolateAt(boost::circular_buffer<std::pair<std::int64_t, T>> const& bufpairnt, std::int64_t nTime) {
+            assert(!bufpairnt.empty());
+            if(nTime <= bufpairnt.front().first) return bufpairnt.front().second;
+            if(bufpairnt.back().first <= nTime) return bufpairnt.back().second;
+            
+            auto const itB = std::upper_bound(bufpairnt.begin(), bufpairnt.end(), nTime,
+                [](std::int64_t n, std::pair<std::int64_t, T> const& pairnt) { return n < pairnt.first; }
+            );
+            auto const itA = std::prev(itB);
+            auto const f = static_cast<double>(nTime - itA->first) / (itB->first - itA->first);
+            return Interpolate(itA->second, itB->second, f);
+        }
+        
+        template<typename T>
+        void Append(boost::circular_buffer<std::pair<std::int64_t, T>>& bufpairnt, std::int64_t nTime, T const& t) {
+            if(!bufpairnt.empty() && nTime <= bufpairnt.back().first) {
+                bufpairnt.back().second = t; // no time passed
+            } else {
+                bufpairnt.push_back(std::make_pair(nTime, t));
+            }
+        }
+    }
+    
+    CPoseHistory::CPoseHistory()
+        : m_bufpairnfYaw(c_cSamples)
+        , m_bufpairnptf(c_cSamples)
+    {}
+    
+    void CPoseHistory::addYaw(std::int64_t nTime, double fYaw) {
+        auto const fYawUnwrapped = m_bufpairnfYaw.empty()
+            ? fYaw
+            : m_bufpairnfYaw.back().second + angularDistance(fYaw, m_bufpairnfYaw.back().second);
+        Append(m_bufpairnfYaw, nTime, fYawUnwrapped);
+        prune();
+    }
+    
+    void CPoseHistory::addDistance(std::int64_t nTime, double fDistance) {
+        if(m_bufpairnptf.empty()) {
+            Append(m_bufpairnptf, nTime, m_ptfStart);
+            return;
+        }
+        
+        auto const& pairnptfLast = m_bufpairnptf.back();
+        auto ptf = pairnptfLast.second;
+        if(0 != fDistance) {
+            ptf += rbt::size<double>::fromAngleAndDistance(yaw(pairnptfLast.first + (nTime - pairnptfLast.first) / 2), fDistance);
+        }
+        Append(m_bufpairnptf, nTime, ptf);
+        prune();
+    }
+    
+    rbt::point<double> CPoseHistory::position(std::int64_t nTime) const {
+        return m_bufpairnptf.empty() ? m_ptfStart : InterpolateAt(m_bufpairnptf, nTime);
+    }
+    
+    double CPoseHistory::yaw(std::int64_t nTime) const {
+        return m_bufpairnfYaw.empty() ? 0.0 : angularDistance(InterpolateAt(m_bufpairnfYaw, nTime), 0);
+    }
+    
+    void CPoseHistory::prune() {
+        auto const PruneBefore = [](auto& bufpairnt, std::int64_t nTime) {
+            while(2 < bufpairnt.size() && bufpairnt[1].first < nTime) bufpairnt.pop_front();
+        };
+        if(!m_bufpairnptf.empty()) {
+            PruneBefore(m_bufpairnfYaw, m_bufpairnptf.back().first - c_nDuration);
+            PruneBefore(m_bufpairnptf, m_bufpairnptf.back().first - c_nDuration);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+//
+//  pose_history.h
+//  robotcontrol2
+//
+//  Time-indexed history of the rover pose. The rover measures yaw and encoder ticks
+//  at different times, so yaw and position are recorded with their own timestamps and
+//  interpolated separately to the time of each sonar reading.
+//
+
+#ifndef pose_history_h
+#define pose_history_h
+
+#include "geometry.h"
+
+#include <boost/circular_buffer.hpp>
+
+#include <assert.h>
+#include <cstdint>
+#include <utility>
+
+namespace rbt {
+    struct CPoseHistory {
+        CPoseHistory();
+        
+        // Yaw in radians measured at nTime, in microseconds
+        void addYaw(std::int64_t nTime, double fYaw);
+        
+        // The rover moved fDistance cm since the last position was added. The direction
+        // is the yaw in the middle of that time span.
+        void addDistance(std::int64_t nTime, double fDistance);
+        
+        // Interpolated pose, clamped to the oldest and newest samples
+        rbt::point<double> position(std::int64_t nTime) const;
+        double yaw(std::int64_t nTime) const;
+        
+        // Position of the first sample, e.g., the position restored from a checkpoint. Only while empty().
+        void setStart(rbt::point<double> const& ptf) { assert(empty()); m_ptfStart = ptf; }
+        
+        bool empty() const { return m_bufpairnptf.empty(); }
+        std::int64_t time() const { return m_bufpairnptf.back().first; } // time of last position
+        
+    private:
+        void prune();
+        
+        // Long enough for the oldest reading of a packet that waited in the ingestion queue
+        static std::int64_t const c_nDuration = 2000000; // us
+        // Fixed capacity, so adding samples never allocates. If packets arrive faster
+        // than 128/s, the history is shorter than c_nDuration.
+        static std::size_t const c_cSamples = 256;
+        
+        boost::circular_buffer<std::pair<std::int64_t, double>> m_bufpairnfYaw; // unwrapped, i.e., continuous
+        boost::circular_buffer<std::pair<std::int64_t, rbt::point<double>>> m_bufpairnptf;
+        rbt::point<double> m_ptfStart = rbt::point<double>::zero();
+    };
+}
+
+#endif /* pose_history_h */
@@ -0,0 +1,96 @@
+//
+//  pure_pursuit.cpp
+//  robotcontrol2
+//
+
+#include "pure_pursuit.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+
+namespace rbt {
+    namespace {
+        std::size_t const c_cPathCapacity = 64; // points, followed segments are dropped before the path grows beyond
+    }
+    
+    CPurePursuit::CPurePursuit(double fLookahead, double fMinTurnRadius)
+    :   m_fLookahead(fLookahead),
+        m_fMaxCurvature(1.0 / fMinTurnRadius)
+    {
+        m_vecptf.reserve(c_cPathCapacity);
+    }
+    
+    void CPurePursuit::clear() {
+        m_vecptf.clear();
+        m_iSegment = 0;
+    }
+    
+    void CPurePursuit::append(point<double> const& ptf) {
+        if(m_vecptf.size() == m_vecptf.capacity() && 0 < m_iSegment) {
+            m_vecptf.erase(m_vecptf.begin(), m_vecptf.begin() + m_iSegment);
+            m_iSegment = 0;
+        }
+        m_vecptf.push_back(ptf);
+    }
+    
+    double CPurePursuit::remaining(point<double> const& ptf) const {
+        if(m_vecptf.empty()) return 0;
+        
+        auto const iNext = std::min(m_iSegment + 1, rbt::numeric_cast<int>(m_vecptf.size()) - 1);
+        auto fDistance = (m_vecptf[iNext] - ptf).Abs();
+        for(int i = iNext + 1; i < rbt::numeric_cast<int>(m_vecptf.size()); ++i) {
+            fDistance += (m_vecptf[i] - m_vecptf[i - 1]).Abs();
+        }
+        return fDistance;
+    }
+    
+    point<double> CPurePursuit::lookahead(point<double> const& ptf) {
+        // Skip segments whose end is already within the lookahead circle
+        while(m_iSegment + 2 < rbt::numeric_cast<int>(m_vecptf.size()) && (m_vecptf[m_iSegment + 1] - ptf).Abs() < m_fLookahead) {
+            ++m_iSegment;
+        }
+        if(m_iSegment + 1 == rbt::numeric_cast<int>(m_vecptf.size())) return m_vecptf.back();
+        
+        // Farther intersection of the lookahead circle with the current segment,
+        // i.e., the larger root of |ptA + t * szAB - ptf| = m_fLookahead
+        auto const& ptA = m_vecptf[m_iSegment];
+        auto const& ptB = m_vecptf[m_iSegment + 1];
+        auto const szAB = ptB - ptA;
+        auto const szA = ptA - ptf;
+        
+        auto const a = szAB.SqrAbs();
+        auto const b = 2 * (szA * szAB);
+        auto const c = szA.SqrAbs() - rbt::sqr(m_fLookahead);
+        auto const fDiscriminant = rbt::sqr(b) - 4 * a * c;
+        if(a <= 0 || fDiscriminant < 0) return ptB; // robot is off the path, head back to it
+        
+        auto const t = (-b + std::sqrt(fDiscriminant)) / (2 * a);
+        return t < 1 ? ptA + szAB * std::max(t, 0.0) : ptB;
+    }
+    
+    SRobotCommand CPurePursuit::command(point<double> const& ptf, double fYaw) {
+        assert(!m_vecptf.empty());
+        auto const szGoal = lookahead(ptf) - ptf;
+        
+        // Goal in robot coordinates, lateral > 0 is to the left
+        auto const fForward = szGoal.x * std::cos(fYaw) + szGoal.y * std::sin(fYaw);
+        auto const fLateral = -szGoal.x * std::sin(fYaw) + szGoal.y * std::cos(fYaw);
+        auto const fCurvature = 2 * fLateral / std::max(szGoal.SqrAbs(), 1.0);
+        
+        if(fForward <= 0 || m_fMaxCurvature < std::abs(fCurvature)) {
+            // Turn in place towards the goal
+            auto const nTurn = fLateral < 0 ? -c_nMaxTurnSpeed : c_nMaxTurnSpeed;
+            return SRobotCommand{ecmdMOVE, static_cast<short>(-nTurn), static_cast<short>(nTurn)};
+        }
+        
+        // Outer track runs at c_nMaxFwdSpeed
+        auto const fHalfTrack = fCurvature * c_fTrackWidth / 2;
+        auto const fSpeed = c_nMaxFwdSpeed / (1 + std::abs(fHalfTrack));
+        return SRobotCommand{
+            ecmdMOVE,
+            rbt::numeric_cast<short>(fSpeed * (1 - fHalfTrack)),
+            rbt::numeric_cast<short>(fSpeed * (1 + fHalfTrack))
+        };
+    }
+}
@@ -0,0 +1,47 @@
+//
+//  pure_pursuit.h
+//  robotcontrol2
+//
+//  Pure pursuit path follower for the differential drive. Steers towards the point
+//  on the path m_fLookahead ahead of the robot on the arc through both points, so
+//  corners between path segments are rounded off. Turns in place with ecmdMOVE if
+//  the arc would be tighter than the minimum turn radius, e.g., if the path turns back.
+//
+
+#ifndef pure_pursuit_h
+#define pure_pursuit_h
+
+#include "robot_controller_c.h"
+#include "geometry.h"
+
+#include <vector>
+
+namespace rbt {
+    struct CPurePursuit {
+        // in cm
+        CPurePursuit(double fLookahead, double fMinTurnRadius);
+        
+        void clear();
+        void append(point<double> const& ptf); // world coordinates
+        bool empty() const { return m_vecptf.empty(); }
+        point<double> const& back() const { return m_vecptf.back(); }
+        
+        // Distance along the path from the robot to the end of the path, 0 if empty
+        double remaining(point<double> const& ptf) const;
+        
+        // Point on the path the robot steers towards, advances along the path
+        point<double> lookahead(point<double> const& ptf);
+        // ecmdMOVE command towards lookahead(ptf)
+        SRobotCommand command(point<double> const& ptf, double fYaw);
+        
+        std::vector<point<double>> const& path() const { return m_vecptf; }
+    
+    private:
+        double const m_fLookahead;
+        double const m_fMaxCurvature;
+        std::vector<point<double>> m_vecptf;
+        int m_iSegment = 0; // robot is on the segment from m_vecptf[m_iSegment] to m_vecptf[m_iSegment + 1]
+    };
+}
+
+#endif /* pure_pursuit_h */
@@ -4,85 +4,263 @@
 #include "geometry.h"
 #include "nonmoveable.h"
 #include "occupancy_grid.h"
+#include "sonar_filter.h"
 #include "edge_following_strategy.h"
+#include "sensor_ingestion.h"
+#include "sensor_packet.h"
+#include "pose_history.h"
+#include "arena.h"
+#include "checkpoint.h"
 
+#include <algorithm>
+#include <numeric>
 #include <vector>
-#include <chrono>
+#include <memory>
+#include <mutex>
 #include <boost/algorithm/cxx11/all_of.hpp>
 
 namespace rbt {
     struct CRobotController : rbt::nonmoveable {
-        CRobotController()
-            : m_occgrid(rbt::size<int>(400, 400), /*nScale*/5) // = Map of 20m x 20m map
-            , m_bConnected(false)
-        {}
+        CRobotController(rbt::size<int> const& szn, int nScale, rbt::grid_mode emode, SRobotParameters const& params, rbt::planning_mode eplanning)
+            : m_arena(ArenaSize(szn), m_stats)
+            , m_occgrid(szn, nScale, emode, params, m_arena, m_stats)
+            , m_edgefollow(szn,
+                           RBT_PURE_PURSUIT ? rbt::motion_mode::pure_pursuit : rbt::motion_mode::stop_and_turn,
+                           RBT_COVERAGE ? rbt::target_score::coverage
+                               : (RBT_INFORMATION_GAIN ? rbt::target_score::information_gain : rbt::target_score::interval_length),
+                           eplanning,
+                           m_stats)
+            , m_nWarmupTime(0)
+        {
+            m_vecmeas.reserve(c_cMaxSonarReadings);
+        }
+        
+        // Temporary maps of one update: obstacle and distance map of the cost map
+        static std::size_t ArenaSize(rbt::size<int> const& szn) {
+            return static_cast<std::size_t>(szn.x) * szn.y * (sizeof(std::uint8_t) + sizeof(float)) + 4096;
+        }
         
-        boost::optional<SRobotCommand> receivedSensorData(SSensorData const& data) {
-            auto const fYaw = yawToRadians(data.m_nYaw); // TODO: Fuse odometry and IMU sensors?
+        boost::optional<SRobotCommand> receivedSensorPacket(SSensorPacket const& packet) {
+            RBT_TIME_STAGE(m_stats, stage_sensor_packet);
+            m_arena.reset(); // all temporaries of the previous packet have been released
             
-            auto const ptfPrev = m_vecpairptfPose.empty() ? rbt::point<double>::zero() : m_vecpairptfPose.back().first;
-            rbt::point<double> ptf;
-            if(ecmdTURN360==data.m_ecmdLast || ecmdTURN==data.m_ecmdLast) {
-                // turning, position does not change
-                ptf = ptfPrev;
-            } else {
-                // assert(boost::algorithm::all_of(
-                // data.m_anEncoderTicks, [&](int nTick) { return rbt::sign(data.m_anEncoderTicks[0]) == rbt::sign(nTick); })
-                // );
-                ptf = ptfPrev + rbt::size<double>::fromAngleAndDistance(fYaw, encoderTicksToCm(data.m_anEncoderTicks[0]));
-            }
+            // Unwrap the rover's 32 bit micros(), which overflows every ~ 70 minutes
+            auto const nDuration = m_posehistory.empty() ? 0 : static_cast<std::uint32_t>(packet.m_nTime - m_nTimeLastPacket);
+            m_nTimeLastPacket = packet.m_nTime;
+            auto const nTime = m_posehistory.empty() ? 0 : m_posehistory.time() + nDuration;
+            
+            auto const ptfPrev = m_posehistory.position(nTime - nDuration);
+            auto const fYawPrev = m_posehistory.yaw(nTime - nDuration);
+            
+            m_posehistory.addYaw(nTime - static_cast<std::int64_t>(packet.m_nYawAge) * c_nAgeUnit, yawToRadians(packet.m_nYaw)); // TODO: Fuse odometry and IMU sensors?
+            // The robot center moves by the mean of the left (even) and right (odd) wheels,
+            // which also holds on curves and when turning in place with ecmdMOVE
+            m_posehistory.addDistance(nTime,
+                ecmdTURN360==packet.m_ecmdLast || ecmdTURN==packet.m_ecmdLast
+                    ? 0.0 // turning, position does not change
+                    : encoderTicksToCm(1) * std::accumulate(packet.m_anEncoderTicks, packet.m_anEncoderTicks + 4, 0) / 4.0
+            );
             
             // Add poses even while we're still ignoring sensor data, so we can return pose in robot_received_sensor_data
-            auto const fYawPrev = m_vecpairptfPose.empty() ? fYaw : m_vecpairptfPose.back().second;
-            m_vecpairptfPose.emplace_back(std::make_pair(ptf, fYaw));
+            auto const ptf = m_posehistory.position(nTime);
+            auto const fYaw = m_posehistory.yaw(nTime);
+            {
+                std::lock_guard<std::mutex> lock(m_mutexPose);
+                m_pose = { ptf.x, ptf.y, fYaw };
+            }
             
             // wait 10s after connection for sensors before taking measurements seriously
-            if(!m_bConnected) {
-                m_bConnected = true;
-                m_tStart = std::chrono::system_clock::now();
+            // Sum up the rover's time instead of measuring wall clock time, so simulations
+            // running faster than real time behave the same as the rover.
+            // Long gaps mean the rover restarted and don't count.
+            if(m_nWarmupTime < c_nWarmupTime) {
+                m_nWarmupTime += std::min(nDuration / 1000, static_cast<std::uint32_t>(c_nMaxPacketDuration));
                 return boost::none;
-            } else {
-                std::chrono::duration<double> s(std::chrono::system_clock::now() - m_tStart);
-                if(s.count() < 10) {
-                    return boost::none;
-                }
             }
-
-            m_occgrid.update(ptf,
-                             fYaw,
-                             data.m_nAngle,
-                             data.m_nDistance + sonarOffset(data.m_nAngle)); // TODO: Add sonarOffset to position instead?
             
-            return m_edgefollow.update(ptfPrev, ptf, fYawPrev, fYaw, data.m_ecmdLast, m_occgrid);
+            // Insert each reading at the pose the rover had when the reading was taken
+            m_vecmeas.clear();
+            {
+                RBT_TIME_STAGE(m_stats, stage_sonar_filter);
+                std::for_each(packet.m_areading, packet.m_areading + packet.m_cReadings, [&](SSonarReading const& reading) {
+                    auto const nTimeReading = nTime - static_cast<std::int64_t>(reading.m_nAge) * c_nAgeUnit;
+                    SSonarMeasurement const meas{
+                        m_posehistory.position(nTimeReading),
+                        m_posehistory.yaw(nTimeReading),
+                        reading.m_nAngle,
+                        reading.m_nDistance + sonarOffset(reading.m_nAngle) // TODO: Add sonarOffset to position instead?
+                    };
+                    if(RBT_SONAR_FILTER && !m_sonarfilter.accept(meas.m_nAngle, meas.m_nDistance, meas.m_ptf, meas.m_fYaw, m_occgrid)) {
+                        RBT_COUNT(m_stats, m_cReadingsRejected, 1);
+                    } else {
+                        m_vecmeas.push_back(meas);
+                    }
+                });
+            }
+            m_occgrid.update(ptf, fYaw, m_vecmeas, nTime);
+            
+            auto const orcmd = m_edgefollow.update(ptfPrev, ptf, fYawPrev, fYaw, packet.m_ecmdLast, m_occgrid);
+            if(m_checkpointwriter.requested()) {
+                RBT_TIME_STAGE(m_stats, stage_checkpoint);
+                save(m_checkpointwriter.checkpoint(), ptf, fYaw);
+                m_checkpointwriter.post();
+            }
+            return orcmd;
+        }
+        
+        void save(rbt::SCheckpoint& checkpoint, rbt::point<double> const& ptf, double fYaw) const {
+            checkpoint.m_szn = m_occgrid.m_szn;
+            checkpoint.m_nScale = m_occgrid.m_nScale;
+            checkpoint.m_bScrolling = rbt::grid_mode::scrolling == m_occgrid.GridMode();
+            checkpoint.m_params = m_occgrid.m_params;
+            checkpoint.m_ptf = ptf;
+            checkpoint.m_fYaw = fYaw;
+            m_occgrid.save(checkpoint);
+            m_edgefollow.save(checkpoint, m_occgrid);
+        }
+        
+        // Must be called before the first packet
+        void restore(rbt::SCheckpoint const& checkpoint) {
+            m_occgrid.restore(checkpoint);
+            m_edgefollow.restore(checkpoint, m_occgrid);
+            m_posehistory.setStart(checkpoint.m_ptf);
+            m_pose = { checkpoint.m_ptf.x, checkpoint.m_ptf.y, checkpoint.m_fYaw };
+            m_nWarmupTime = c_nWarmupTime; // the map is already there, sensors have been running on the rover
         }
         
+        rbt::CStageStatistics m_stats; // must be initialized before m_arena, m_occgrid and m_edgefollow
+        rbt::CArena m_arena; // must be initialized before m_occgrid
         rbt::COccupancyGrid m_occgrid;
         rbt::CEdgeFollowingStrategy m_edgefollow;
-        std::vector<std::pair<rbt::point<double>, double>> m_vecpairptfPose;
+        rbt::CPoseHistory m_posehistory; // time in us since the first packet
+        rbt::CSonarFilter m_sonarfilter;
+        std::uint32_t m_nTimeLastPacket = 0; // rover's micros()
         
-        bool m_bConnected;
-        std::chrono::time_point<std::chrono::system_clock> m_tStart;
+        std::mutex m_mutexPose;
+        SPose m_pose = { 0, 0, 0 }; // last pose, readable from other threads
+        
+        static int const c_nWarmupTime = 10000; // ms
+        int m_nWarmupTime;
+        
+        std::vector<rbt::SSonarMeasurement> m_vecmeas; // reused for every packet
+        std::vector<SMapTile> m_vectile; // result of robot_get_map_changes, owned by the reading thread
+        rbt::CCheckpointWriter m_checkpointwriter;
+        
+        // Declared last, so the mapping thread is stopped before any other member is destroyed
+        std::unique_ptr<rbt::CSensorIngestion> m_pingestion;
+    };
+}
+struct CRobotController* robot_new_controller(int nWidth, int nHeight, int nScale) {
+    return robot_new_tuned_controller(nWidth, nHeight, nScale, false, robot_default_parameters(), false);
+}
+
+struct CRobotController* robot_new_scrolling_controller(int nWidth, int nHeight, int nScale) {
+    return robot_new_tuned_controller(nWidth, nHeight, nScale, true, robot_default_parameters(), false);
+}
+
+struct SRobotParameters robot_default_parameters() {
+    return {
+        c_fSonarDistanceTolerance,
+        -0.5,
+        100.0,
+        rbt::c_nFreeThreshold, // ~ 0.4 * 255
+        rbt::c_nInflationDistance,
+        1.5 // account for errors
     };
 }
-rbt::CRobotController g_robotcontroller;
 
-struct CRobotController* robot_new_controller() {
-    return reinterpret_cast<::CRobotController*>(&g_robotcontroller);
+struct CRobotController* robot_new_tuned_controller(int nWidth, int nHeight, int nScale, bool bScrolling, struct SRobotParameters params, bool bSynchronousPlanning) {
+    if(!rbt::COccupancyGrid::ValidSize(rbt::size<int>(nWidth, nHeight), nScale,
+        bScrolling ? rbt::grid_mode::scrolling : rbt::grid_mode::fixed, params)) return nullptr;
+    return reinterpret_cast<::CRobotController*>(new rbt::CRobotController(rbt::size<int>(nWidth, nHeight), nScale,
+        bScrolling ? rbt::grid_mode::scrolling : rbt::grid_mode::fixed, params,
+        bSynchronousPlanning ? rbt::planning_mode::synchronous : rbt::planning_mode::background));
 }
 
-struct SPose robot_received_sensor_data(struct CRobotController* probot, struct SSensorData data, struct SRobotCommand* prcmd, bool* pbSend) {
+void robot_delete_controller(struct CRobotController* probot) {
+    delete reinterpret_cast<rbt::CRobotController*>(probot);
+}
+
+void robot_save_state(struct CRobotController* probot, char const* szPath) {
     auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
-    auto orcmd = robotcontroller.receivedSensorData(data);
-    *pbSend = static_cast<bool>(orcmd);
-    if(orcmd) *prcmd = *orcmd;
+    robotcontroller.m_checkpointwriter.request(szPath);
+}
+
+struct CRobotController* robot_load_state(char const* szPath) {
+    rbt::SCheckpoint checkpoint;
+    if(!rbt::CCheckpointWriter::read(szPath, checkpoint)
+    || !rbt::COccupancyGrid::ValidSize(checkpoint.m_szn, checkpoint.m_nScale,
+        checkpoint.m_bScrolling ? rbt::grid_mode::scrolling : rbt::grid_mode::fixed, checkpoint.m_params)) return nullptr;
     
-    auto const& pairptfPose = robotcontroller.m_vecpairptfPose.back();
-    return { pairptfPose.first.x, pairptfPose.first.y, pairptfPose.second };
+    auto probot = new rbt::CRobotController(checkpoint.m_szn, checkpoint.m_nScale,
+        checkpoint.m_bScrolling ? rbt::grid_mode::scrolling : rbt::grid_mode::fixed, checkpoint.m_params, rbt::planning_mode::background);
+    probot->restore(checkpoint);
+    return reinterpret_cast<::CRobotController*>(probot);
+}
+
+namespace {
+    SPose ReceivedSensorPacket(rbt::CRobotController& robotcontroller, SSensorPacket const& packet, struct SRobotCommand* prcmd, bool* pbSend) {
+        auto orcmd = robotcontroller.receivedSensorPacket(packet);
+        *pbSend = static_cast<bool>(orcmd);
+        if(orcmd) *prcmd = *orcmd;
+        
+        std::lock_guard<std::mutex> lock(robotcontroller.m_mutexPose);
+        return robotcontroller.m_pose;
+    }
+}
+
+struct SPose robot_received_sensor_data(struct CRobotController* probot, struct SSensorData data, struct SRobotCommand* prcmd, bool* pbSend) {
+    auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    return ReceivedSensorPacket(robotcontroller, rbt::toSensorPacket(data), prcmd, pbSend);
+}
+
+struct SPose robot_received_sensor_packet(struct CRobotController* probot, void const* pv, size_t cb, struct SRobotCommand* prcmd, bool* pbSend) {
+    auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    SSensorPacket packet;
+    if(!rbt::decodeSensorPacket(pv, cb, packet)) {
+        *pbSend = false;
+        return robot_get_pose(probot);
+    }
+    return ReceivedSensorPacket(robotcontroller, packet, prcmd, pbSend);
+}
+
+void robot_start_mapping_thread(struct CRobotController* probot, void (*fnCommandReady)(void*), void* pvContext) {
+    auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    assert(!robotcontroller.m_pingestion);
+    robotcontroller.m_pingestion = std::make_unique<rbt::CSensorIngestion>(
+        [&](SSensorPacket const& packet) { return robotcontroller.receivedSensorPacket(packet); },
+        [=] { if(fnCommandReady) fnCommandReady(pvContext); }
+    );
+}
+
+bool robot_post_sensor_data(struct CRobotController* probot, struct SSensorData data) {
+    auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    assert(robotcontroller.m_pingestion);
+    return robotcontroller.m_pingestion->post(rbt::toSensorPacket(data));
+}
+
+bool robot_post_sensor_packet(struct CRobotController* probot, void const* pv, size_t cb) {
+    auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    assert(robotcontroller.m_pingestion);
+    SSensorPacket packet;
+    return rbt::decodeSensorPacket(pv, cb, packet) && robotcontroller.m_pingestion->post(packet);
+}
+
+bool robot_poll_command(struct CRobotController* probot, struct SRobotCommand* prcmd) {
+    auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    assert(robotcontroller.m_pingestion);
+    return robotcontroller.m_pingestion->poll(*prcmd);
+}
+
+struct SPose robot_get_pose(struct CRobotController* probot) {
+    auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    std::lock_guard<std::mutex> lock(robotcontroller.m_mutexPose);
+    return robotcontroller.m_pose;
 }
 
 struct SBitmap robot_get_map(struct CRobotController* probot, bitmap_type bm) {
     auto const& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
-
+    
     SBitmap bitmap;
     bitmap.m_pbImage = [&]() {
         switch(bm) {
@@ -98,5 +276,59 @@ struct SBitmap robot_get_map(struct CRobotController* probot, bitmap_type bm) {
     bitmap.m_nWidth = robotcontroller.m_occgrid.m_szn.x;
     bitmap.m_nHeight = robotcontroller.m_occgrid.m_szn.y;
     bitmap.m_nScale = robotcontroller.m_occgrid.m_nScale;
+    bitmap.m_nCenterX = robotcontroller.m_occgrid.WorldCenter().x;
+    bitmap.m_nCenterY = robotcontroller.m_occgrid.WorldCenter().y;
     return bitmap;
 }
+
+int robot_get_map_levels(struct CRobotController* probot) {
+    auto const& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    return robotcontroller.m_occgrid.Pyramid().levels();
+}
+
+struct SBitmap robot_get_coarse_map(struct CRobotController* probot, int nLevel, bool bObstacles) {
+    auto const& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    auto const& pyramid = robotcontroller.m_occgrid.Pyramid();
+    assert(1 <= nLevel && nLevel <= pyramid.levels());
+    auto const& matn = bObstacles ? pyramid.Obstacles(nLevel) : pyramid.Greyscale(nLevel);
+    
+    SBitmap bitmap;
+    bitmap.m_pbImage = matn.data;
+    bitmap.m_cChannels = 1;
+    bitmap.m_cbBytesPerRow = matn.step;
+    bitmap.m_nWidth = matn.cols;
+    bitmap.m_nHeight = matn.rows;
+    bitmap.m_nScale = robotcontroller.m_occgrid.m_nScale << nLevel;
+    bitmap.m_nCenterX = robotcontroller.m_occgrid.WorldCenter().x;
+    bitmap.m_nCenterY = robotcontroller.m_occgrid.WorldCenter().y;
+    return bitmap;
+}
+
+struct SMapChanges robot_get_map_changes(struct CRobotController* probot, unsigned long long nSinceVersion) {
+    auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    auto& snapshot = robotcontroller.m_occgrid.GreyscaleSnapshot();
+    
+    SMapChanges changes;
+    changes.m_nVersion = snapshot.lock(nSinceVersion, robotcontroller.m_vectile);
+    changes.m_ptile = robotcontroller.m_vectile.data();
+    changes.m_cTiles = robotcontroller.m_vectile.size();
+    changes.m_bitmap.m_pbImage = snapshot.Snapshot().data;
+    changes.m_bitmap.m_cChannels = 1;
+    changes.m_bitmap.m_cbBytesPerRow = snapshot.Snapshot().step;
+    changes.m_bitmap.m_nWidth = robotcontroller.m_occgrid.m_szn.x;
+    changes.m_bitmap.m_nHeight = robotcontroller.m_occgrid.m_szn.y;
+    changes.m_bitmap.m_nScale = robotcontroller.m_occgrid.m_nScale;
+    changes.m_bitmap.m_nCenterX = snapshot.Center().x;
+    changes.m_bitmap.m_nCenterY = snapshot.Center().y;
+    return changes;
+}
+
+void robot_release_map_changes(struct CRobotController* probot) {
+    auto& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    robotcontroller.m_occgrid.GreyscaleSnapshot().unlock();
+}
+
+void robot_get_stats(struct CRobotController* probot, struct SRobotStats* pstats) {
+    auto const& robotcontroller = *reinterpret_cast<rbt::CRobotController*>(probot);
+    robotcontroller.m_stats.read(*pstats);
+}
@@ -9,8 +9,44 @@ extern "C" {
 #endif
 
 // Robot controller C interface used by Swift GUI
+// Each controller owns its map and state. Different controllers may be
+// used concurrently from different threads, a single controller may not.
 struct CRobotController;
-struct CRobotController* robot_new_controller();
+
+// Creates controller with a map of nWidth x nHeight pixels and nScale cm per pixel.
+// nWidth and nHeight must be even and positive, nScale positive, else returns NULL.
+// The robot starts in the center of the map.
+struct CRobotController* robot_new_controller(int nWidth, int nHeight, int nScale);
+// Creates controller whose map follows the robot. Whenever the robot gets within sonar range
+// of the map border, the map is moved to center the robot again and cells outside are forgotten.
+// Memory and processing time per update don't depend on the distance travelled.
+// Each side of the map must be at least twice the sonar range plus two map tiles, else returns NULL.
+struct CRobotController* robot_new_scrolling_controller(int nWidth, int nHeight, int nScale);
+
+// Tuning constants of the sensor model and of the exploration strategy
+struct SRobotParameters {
+    double m_fSonarDistanceTolerance; // cm, width of the occupied band at the measured distance
+    double m_fLogOddsFree; // added to cells closer than the measured distance
+    double m_fLogOddsOccupied; // divided by the map scale and the distance in pixels, added to cells in the occupied band
+    unsigned char m_nFreeThreshold; // greyscale values below are obstacles for path planning
+    int m_nMaxExplorationDistance; // cm, the robot passes obstacles at most this far away
+    double m_fExplorationDistanceTolerance; // cells within this multiple of m_nMaxExplorationDistance of the path are visited
+};
+struct SRobotParameters robot_default_parameters(void);
+// Creates a controller like robot_new_controller or robot_new_scrolling_controller with other tuning constants.
+// With bSynchronousPlanning, the next target is planned while processing the packet instead of on a background
+// thread, so a simulation gives the same results however its threads are scheduled.
+struct CRobotController* robot_new_tuned_controller(int nWidth, int nHeight, int nScale, bool bScrolling, struct SRobotParameters params, bool bSynchronousPlanning);
+void robot_delete_controller(struct CRobotController* probot);
+
+// Saves map, pose and exploration state to szPath, so a restarted process can continue
+// where this one stopped. Can be called from any thread. The state is copied after the next
+// sensor packet has been processed and written to the file on a background thread.
+// If a checkpoint is still being written, the copy waits for the following packet.
+void robot_save_state(struct CRobotController* probot, char const* szPath);
+// Creates a controller from a file written by robot_save_state, NULL if it can't be read.
+// The controller continues with the first sensor packet without waiting for the sensors to warm up.
+struct CRobotController* robot_load_state(char const* szPath);
 
 // Returns new robot pose. The x,y coordinates are in world coordinates, i.e.,
 // not scaled according to occupancy grid resolution.
@@ -22,9 +58,29 @@ struct SPose {
 };
 struct SPose robot_received_sensor_data(struct CRobotController* probot, struct SSensorData data, struct SRobotCommand* prcmd, bool* pbSend);
 
+// Accepts an SSensorPacket of sensorPacketSize(m_cReadings) bytes or a single SSensorData record,
+// as received from the rover. Data of any other size is ignored and *pbSend is set to false.
+struct SPose robot_received_sensor_packet(struct CRobotController* probot, void const* pv, size_t cb, struct SRobotCommand* prcmd, bool* pbSend);
+
+// Asynchronous alternative to robot_received_sensor_data.
+// Sensor data is queued and processed on a separate mapping thread, so the caller never
+// waits for map updates. fnCommandReady(pvContext) is called on the mapping thread whenever
+// a new command can be retrieved with robot_poll_command.
+// robot_post_sensor_data and robot_poll_command must be called from the same thread.
+// robot_post_sensor_data returns false if the queue overflowed and the packet was merged
+// with the previous one.
+void robot_start_mapping_thread(struct CRobotController* probot, void (*fnCommandReady)(void*), void* pvContext);
+bool robot_post_sensor_data(struct CRobotController* probot, struct SSensorData data);
+bool robot_post_sensor_packet(struct CRobotController* probot, void const* pv, size_t cb); // false if pv is not a valid packet, too
+bool robot_poll_command(struct CRobotController* probot, struct SRobotCommand* prcmd);
+
+// Returns most recent robot pose. Can be called from any thread.
+struct SPose robot_get_pose(struct CRobotController* probot);
+
 // Returns pointer to the current robot maps as bitmaps.
 // Returns either the raw map (bEroded = false)
 // or the map with erosion filter applied (bEroded = true)
+// The bitmap points into the live map, which the mapping thread may change while it is read.
 struct SBitmap {
     unsigned char* m_pbImage;
     size_t m_cChannels; // No of 8-bit channels, 1 (Greyscale) or 3 (RGB)
@@ -32,6 +88,8 @@ struct SBitmap {
     size_t m_nWidth;
     size_t m_nHeight;
     size_t m_nScale; // cm per pixel
+    int m_nCenterX; // world coordinates of the bitmap center in cm, changes if the map scrolls
+    int m_nCenterY;
 };
     
 enum bitmap_type {
@@ -40,6 +98,84 @@ enum bitmap_type {
     
 struct SBitmap robot_get_map(struct CRobotController* probot, enum bitmap_type bm);
 
+// Returns the greyscale map (bObstacles = false) or the obstacles in it (bObstacles = true)
+// at 2^nLevel times the map scale. nLevel must be in [1, robot_get_map_levels()].
+// Obstacle pixels are white if any cell they cover is an obstacle for path planning.
+// Like robot_get_map, the bitmap points into the live map.
+int robot_get_map_levels(struct CRobotController* probot);
+struct SBitmap robot_get_coarse_map(struct CRobotController* probot, int nLevel, bool bObstacles);
+
+// Change feed of the greyscale map. The mapping thread copies changed tiles of
+// c_nMapTileSize x c_nMapTileSize pixels into a snapshot after every update.
+// Unlike robot_get_map, the snapshot never changes while it is being read.
+// robot_get_map_changes returns the tiles changed after nSinceVersion, pass 0 to get all
+// tiles. The snapshot is locked until robot_release_map_changes. In the meantime the mapping
+// thread continues without updating it. Both must be called from the same thread.
+const int c_nMapTileSize = 16;
+    
+struct SMapTile {
+    unsigned char const* m_pbImage; // first pixel of the tile in the snapshot
+    size_t m_nX;
+    size_t m_nY;
+    size_t m_nWidth; // less than c_nMapTileSize at the right and bottom border
+    size_t m_nHeight;
+};
+    
+struct SMapChanges {
+    unsigned long long m_nVersion; // pass to the next robot_get_map_changes call
+    struct SMapTile const* m_ptile;
+    size_t m_cTiles;
+    struct SBitmap m_bitmap; // the whole snapshot, greyscale
+};
+    
+struct SMapChanges robot_get_map_changes(struct CRobotController* probot, unsigned long long nSinceVersion);
+void robot_release_map_changes(struct CRobotController* probot);
+
+// Latency statistics of the stages of sensor data processing.
+// Only collected if the controller is compiled with RBT_STAGE_STATISTICS (default),
+// otherwise all values are 0. Can be called from any thread.
+enum processing_stage {
+    stage_sensor_packet, // all processing of one SSensorPacket with up to c_cMaxSonarReadings (7) readings
+    stage_arc_rasterization, // sonar cone update
+    stage_robot_footprint, // clearing the robot's position
+    stage_erosion,
+    stage_cost_map, // composing the cost map in changed regions
+    stage_color_conversion, // feature map for visualization
+    stage_distance_transform,
+    stage_ray_scan, // scoring of exploration targets
+    stage_speculative_plan, // planning the next target while driving to the current one
+    stage_information_gain, // updating the summed-area tables of unknown cells and entropy
+    stage_coverage, // updating the coverage decomposition
+    stage_sonar_filter, // interpolating the poses of the sonar readings and rejecting outliers
+    stage_checkpoint, // copying the state for robot_save_state
+    stage_count
+};
+
+struct SStageStats {
+    unsigned long long m_cSamples;
+    unsigned long long m_nMeanNanoseconds;
+    unsigned long long m_nMaxNanoseconds;
+    // Percentiles have a relative error < 12.5%
+    unsigned long long m_nP50Nanoseconds;
+    unsigned long long m_nP90Nanoseconds;
+    unsigned long long m_nP99Nanoseconds;
+    unsigned long long m_nP999Nanoseconds;
+};
+
+struct SRobotStats {
+    struct SStageStats m_astage[stage_count];
+    unsigned long long m_cCellsTouched; // occupancy grid cells updated by sonar cones and robot footprint
+    unsigned long long m_cRaysWalked; // rays cast when looking for exploration targets
+    unsigned long long m_cArenaOverflows; // heap allocations because the per-packet arena was full, should be 0
+    unsigned long long m_cMapScrolls; // times a scrolling map was centered on the robot again
+    unsigned long long m_cTilesDecayed; // map tiles decayed towards the prior, see RBT_DECAY_TIME
+    unsigned long long m_cReadingsRejected; // sonar readings rejected as outliers, see RBT_SONAR_FILTER
+    unsigned long long m_cSpeculativePlans; // next targets planned while driving to the current one
+    unsigned long long m_cSpeculativeHits; // speculative targets still valid when the robot arrived
+};
+
+void robot_get_stats(struct CRobotController* probot, struct SRobotStats* pstats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,172 @@
+//
+//  rover_simulator.cpp
+//  robotcontrol2
+//
+
+#include "rover_simulator.h"
+
+#include <algorithm>
+#include <boost/range/size.hpp>
+
+namespace rbt {
+    namespace {
+        short const c_anSonarAngle[] = {90, 0, -90}; // same order as g_asonar in rover.cpp
+        double const c_fSonarTimeout = 20000 / 58.0; // cm, pulseIn timeout in rover.cpp
+    }
+    
+    constexpr double CRoverSimulator::c_fLoopTime;
+    
+    CRoverSimulator::CRoverSimulator(cv::Mat const& matnFloorPlan, int nScale,
+                                     point<double> const& ptfStart, double fYawStart,
+                                     unsigned int nSeed, SSimulatorNoise const& noise)
+        : m_matnFloorPlan(matnFloorPlan)
+        , m_nScale(nScale)
+        , m_noise(noise)
+        , m_rng(nSeed)
+        , m_ptf(ptfStart)
+        , m_fYaw(fYawStart)
+        , m_fYawMeasurement(fYawStart)
+    {
+        assert(CV_8UC1==matnFloorPlan.type());
+    }
+    
+    void CRoverSimulator::receivedCommand(SRobotCommand const& rcmd) {
+        m_rcmdLast = rcmd;
+        m_fTimeLastCommand = m_fTime;
+        
+        switch(rcmd.m_cmd) {
+            case ecmdMOVE:
+                m_afSpeed[0] = rcmd.arg.move.m_nSpeedLeft;
+                m_afSpeed[1] = rcmd.arg.move.m_nSpeedRight;
+                break;
+            case ecmdTURN360:
+            case ecmdTURN: {
+                bool const bTurnLeft = ecmdTURN360==rcmd.m_cmd || YawDifference(rcmd.arg.turn.m_nYawTarget)<0;
+                m_afSpeed[0] = rcmd.arg.turn.m_nSpeed * (bTurnLeft ? -1 : 1);
+                m_afSpeed[1] = rcmd.arg.turn.m_nSpeed * (bTurnLeft ? 1 : -1);
+                if(ecmdTURN360==rcmd.m_cmd) {
+                    m_rcmdLast.arg.turn.m_nYawTarget = MeasuredYaw();
+                }
+                break;
+            }
+            default:
+                m_afSpeed[0] = 0;
+                m_afSpeed[1] = 0;
+        }
+    }
+    
+    SSensorData CRoverSimulator::step() {
+        // Stop conditions checked in loop() in rover.cpp
+        if(ecmdTURN360==m_rcmdLast.m_cmd || ecmdTURN==m_rcmdLast.m_cmd) {
+            int const nYawTolerance = 17;
+            int const nYawDiff = YawDifference(m_rcmdLast.arg.turn.m_nYawTarget);
+            if(ecmdTURN360==m_rcmdLast.m_cmd) {
+                if(1.5 < m_fTime - m_fTimeLastCommand && nYawDiff >= -nYawTolerance && nYawDiff < 3*nYawTolerance) {
+                    receivedCommand(c_rcmdStop);
+                }
+            } else if(std::abs(nYawDiff)<=nYawTolerance) {
+                receivedCommand(c_rcmdStop);
+            }
+        } else if(0.2 < m_fTime - m_fTimeLastCommand) { // c_nTIMETOSTOP
+            receivedCommand(c_rcmdStop);
+        }
+        
+        // Differential drive. Tracks may slip, the encoders count wheel rotations.
+        double afDistance[2];
+        for(int i=0; i<2; ++i) {
+            double const fWheel = m_afSpeed[i] * c_fLoopTime * encoderTicksToCm(1);
+            m_afTicks[i] += fWheel / encoderTicksToCm(1);
+            afDistance[i] = fWheel * (1 + m_noise.m_fEncoderSlip * m_normal(m_rng));
+        }
+        
+        m_fYaw += (afDistance[1] - afDistance[0]) / c_fTrackWidth;
+        m_fYaw = std::atan2(std::sin(m_fYaw), std::cos(m_fYaw));
+        
+        auto const ptfNext = m_ptf + rbt::size<double>::fromAngleAndDistance(m_fYaw, (afDistance[0] + afDistance[1]) / 2);
+        if(Collides(ptfNext)) {
+            ++m_cCollisions; // tracks slip, robot stays in place
+        } else {
+            m_ptf = ptfNext;
+        }
+        
+        m_fYawBias += m_noise.m_fYawDrift * m_normal(m_rng);
+        m_fYawMeasurement = m_fYaw + m_fYawBias + m_noise.m_fYawNoise * m_normal(m_rng);
+        
+        // One sonar reading per loop
+        short const nAngle = c_anSonarAngle[m_iSonar];
+        m_iSonar = (m_iSonar + 1) % boost::size(c_anSonarAngle);
+        
+        auto PopTicks = [](double& fTicks) {
+            short const nTicks = static_cast<short>(fTicks);
+            fTicks -= nTicks;
+            return nTicks;
+        };
+        short const nTicksLeft = PopTicks(m_afTicks[0]);
+        short const nTicksRight = PopTicks(m_afTicks[1]);
+        
+        m_fTime += c_fLoopTime;
+        
+        SSensorData data = {
+            MeasuredYaw(),
+            nAngle,
+            static_cast<short>(std::lround(SonarDistance(nAngle))),
+            {nTicksLeft, nTicksRight, nTicksLeft, nTicksRight},
+            m_rcmdLast.m_cmd
+        };
+        return data;
+    }
+    
+    short CRoverSimulator::MeasuredYaw() const {
+        double const fYaw = std::atan2(std::sin(m_fYawMeasurement), std::cos(m_fYawMeasurement));
+        return static_cast<short>(std::lround(-fYaw * 1000)); // on-board yaw is clockwise
+    }
+    
+    int CRoverSimulator::YawDifference(short nYawTarget) const {
+        int const c_nMaxYaw = static_cast<int>(M_PI * 1000 + 0.5);
+        int nYawDiff = nYawTarget - MeasuredYaw();
+        if(nYawDiff < -c_nMaxYaw) nYawDiff += 2*c_nMaxYaw;
+        if(c_nMaxYaw <= nYawDiff) nYawDiff -= 2*c_nMaxYaw;
+        return nYawDiff;
+    }
+    
+    bool CRoverSimulator::Occupied(point<double> const& ptf) const {
+        int const x = static_cast<int>(std::floor(ptf.x / m_nScale));
+        int const y = static_cast<int>(std::floor(ptf.y / m_nScale));
+        return x < 0 || m_matnFloorPlan.cols <= x || y < 0 || m_matnFloorPlan.rows <= y
+            || m_matnFloorPlan.at<std::uint8_t>(y, x) < 128;
+    }
+    
+    bool CRoverSimulator::Collides(point<double> const& ptf) const {
+        // Approximate the robot by its inscribed circle
+        double const fRadius = std::min(c_nRobotWidth, c_nRobotHeight) / 2.0;
+        for(int i=0; i<16; ++i) {
+            if(Occupied(ptf + rbt::size<double>::fromAngleAndDistance(M_PI * i / 8, fRadius))) return true;
+        }
+        return Occupied(ptf);
+    }
+    
+    double CRoverSimulator::SonarDistance(short nAngle) {
+        // The sensor reports the closest echo inside its opening angle.
+        // Returns 0 if there is no echo before the timeout, just like pulseIn.
+        double const fAngleSonar = m_fYaw + M_PI_2 * rbt::sign(nAngle);
+        auto const ptfSonar = m_ptf + rbt::size<double>::fromAngleAndDistance(fAngleSonar, sonarOffset(nAngle));
+        
+        double fDistance = c_fSonarTimeout;
+        int const c_cRays = 7;
+        for(int i=0; i<c_cRays; ++i) {
+            double const fAngleRay = fAngleSonar - c_fSonarOpeningAngle / 2 + c_fSonarOpeningAngle * i / (c_cRays - 1);
+            auto const szfStep = rbt::size<double>::fromAngleAndDistance(fAngleRay, m_nScale / 2.0);
+            
+            auto ptf = ptfSonar;
+            for(double f = 0; f < fDistance; f += m_nScale / 2.0, ptf += szfStep) {
+                if(Occupied(ptf)) {
+                    fDistance = f;
+                    break;
+                }
+            }
+        }
+        
+        if(c_fSonarTimeout <= fDistance) return 0;
+        return std::max(0.0, fDistance + m_noise.m_fSonarNoise * m_normal(m_rng));
+    }
+}
@@ -0,0 +1,84 @@
+//
+//  rover_simulator.h
+//  robotcontrol2
+//
+//  Deterministic simulation of the rover and its sensors.
+//  Consumes SRobotCommands and produces SSensorData exactly like rover.cpp,
+//  but in simulated time, so it can run much faster than real time.
+//
+
+#ifndef rover_simulator_h
+#define rover_simulator_h
+
+#include "robot_controller_c.h"
+
+#include "nonmoveable.h"
+#include "geometry.h"
+
+#include <opencv2/core.hpp>
+#include <random>
+
+namespace rbt {
+    struct SSimulatorNoise {
+        double m_fEncoderSlip = 0.02; // standard deviation of distance travelled per wheel, relative
+        double m_fYawNoise = 0.005; // standard deviation of yaw measurement, radians
+        double m_fYawDrift = 0.0002; // standard deviation of yaw bias random walk per loop, radians
+        double m_fSonarNoise = 1.0; // standard deviation of sonar distance, cm
+    };
+    
+    struct CRoverSimulator : rbt::nonmoveable {
+        // matnFloorPlan is a greyscale image of the ground truth, pixels < 128 are obstacles.
+        // nScale is the floor plan resolution in cm per pixel.
+        // ptfStart is the start position in cm, relative to the top-left corner of the floor plan.
+        CRoverSimulator(cv::Mat const& matnFloorPlan, int nScale,
+                        point<double> const& ptfStart, double fYawStart,
+                        unsigned int nSeed, SSimulatorNoise const& noise = SSimulatorNoise());
+        
+        // Same behavior as HandleCommand in rover.cpp. Takes effect in the next step.
+        void receivedCommand(SRobotCommand const& rcmd);
+        
+        // Simulates one iteration of the rover's main loop and returns the
+        // sensor data the rover would send at its end.
+        SSensorData step();
+        
+        double time() const { return m_fTime; } // simulated seconds
+        
+        // Ground truth in floor plan coordinates
+        point<double> const& position() const { return m_ptf; }
+        double yaw() const { return m_fYaw; }
+        int collisions() const { return m_cCollisions; }
+        
+        static constexpr double c_fLoopTime = 0.04; // s, rover loop with one sonar reading
+        
+    private:
+        short MeasuredYaw() const;
+        int YawDifference(short nYawTarget) const;
+        bool Occupied(point<double> const& ptf) const;
+        bool Collides(point<double> const& ptf) const;
+        double SonarDistance(short nAngle);
+        
+        cv::Mat const m_matnFloorPlan;
+        int const m_nScale;
+        SSimulatorNoise const m_noise;
+        
+        std::mt19937 m_rng;
+        std::normal_distribution<double> m_normal;
+        
+        double m_fTime = 0;
+        
+        point<double> m_ptf;
+        double m_fYaw; // radians, counter-clockwise
+        double m_fYawBias = 0;
+        double m_fYawMeasurement;
+        int m_cCollisions = 0;
+        
+        double m_afSpeed[2] = {0, 0}; // left, right in encoder ticks per second
+        double m_afTicks[2] = {0, 0}; // not yet reported encoder ticks
+        
+        int m_iSonar = 0;
+        SRobotCommand m_rcmdLast = c_rcmdStop;
+        double m_fTimeLastCommand = 0;
+    };
+}
+
+#endif /* rover_simulator_h */
@@ -0,0 +1,56 @@
+//
+//  sensor_ingestion.cpp
+//  robotcontrol2
+//
+
+#include "sensor_ingestion.h"
+
+#include <chrono>
+
+namespace rbt {
+    namespace {
+        auto const c_dtMaxWait = std::chrono::milliseconds(5);
+    }
+    
+    CSensorIngestion::CSensorIngestion(std::function<boost::optional<SRobotCommand>(SSensorPacket const&)> fnProcess,
+                                       std::function<void()> fnCommandReady,
+                                       overflow_policy epolicySensorData)
+        : m_fnProcess(std::move(fnProcess))
+        , m_fnCommandReady(std::move(fnCommandReady))
+        , m_queuepacket(epolicySensorData, coalesce)
+        , m_queuercmd(overflow_policy::drop_oldest)
+        , m_bStop(false)
+        , m_thread([this] { run(); })
+    {}
+    
+    CSensorIngestion::~CSensorIngestion() {
+        m_bStop = true;
+        m_cv.notify_one();
+        m_thread.join();
+    }
+    
+    bool CSensorIngestion::post(SSensorPacket const& packet) {
+        bool const bQueued = m_queuepacket.push(packet);
+        m_cv.notify_one();
+        return bQueued;
+    }
+    
+    bool CSensorIngestion::poll(SRobotCommand& rcmd) {
+        return m_queuercmd.pop(rcmd);
+    }
+    
+    void CSensorIngestion::run() {
+        while(!m_bStop) {
+            SSensorPacket packet;
+            if(m_queuepacket.pop(packet)) {
+                if(auto orcmd = m_fnProcess(packet)) {
+                    m_queuercmd.push(*orcmd);
+                    if(m_fnCommandReady) m_fnCommandReady();
+                }
+            } else {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait_for(lock, c_dtMaxWait, [this] { return m_bStop || !m_queuepacket.empty(); });
+            }
+        }
+    }
+}
@@ -0,0 +1,59 @@
+//
+//  sensor_ingestion.h
+//  robotcontrol2
+//
+//  Decouples the transport from map updates. The transport thread posts sensor
+//  data and polls commands through lock-free queues, a separate mapping thread
+//  processes the sensor data. Posting never waits for the mapping thread.
+//
+
+#ifndef sensor_ingestion_h
+#define sensor_ingestion_h
+
+#include "robot_controller_c.h"
+#include "nonmoveable.h"
+#include "spsc_queue.h"
+#include "sensor_packet.h"
+
+#include <boost/optional.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace rbt {
+    struct CSensorIngestion : rbt::nonmoveable {
+        // fnProcess is called on the mapping thread for every sensor packet.
+        // fnCommandReady is called on the mapping thread whenever a command has been queued.
+        CSensorIngestion(std::function<boost::optional<SRobotCommand>(SSensorPacket const&)> fnProcess,
+                         std::function<void()> fnCommandReady,
+                         overflow_policy epolicySensorData = overflow_policy::coalesce);
+        ~CSensorIngestion();
+        
+        // Transport side, must be called from a single thread.
+        // Returns false if the sensor queue overflowed.
+        bool post(SSensorPacket const& packet);
+        bool poll(SRobotCommand& rcmd);
+        
+    private:
+        void run();
+        
+        std::function<boost::optional<SRobotCommand>(SSensorPacket const&)> const m_fnProcess;
+        std::function<void()> const m_fnCommandReady;
+        
+        CSpscQueue<SSensorPacket, 64> m_queuepacket;
+        CSpscQueue<SRobotCommand, 8> m_queuercmd; // only the most recent commands matter
+        
+        // The transport thread notifies without locking the mutex. A notification
+        // can get lost between the mapping thread's check and its wait, so the
+        // mapping thread never waits longer than c_dtMaxWait.
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::atomic<bool> m_bStop;
+        std::thread m_thread;
+    };
+}
+
+#endif /* sensor_ingestion_h */
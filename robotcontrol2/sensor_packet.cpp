@@ -0,0 +1,95 @@
+//
+//  sensor_packet.cpp
+//  robotcontrol2
+//
+
+#include "sensor_packet.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace rbt {
+    SSensorPacket toSensorPacket(SSensorData const& data) {
+        auto const nTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+        SSensorPacket packet = {c_nSensorPacketVersion, 1, data.m_ecmdLast, static_cast<std::uint32_t>(nTime), data.m_nYaw, 0};
+        std::copy(data.m_anEncoderTicks, data.m_anEncoderTicks + 4, packet.m_anEncoderTicks);
+        packet.m_areading[0] = {0, data.m_nAngle, data.m_nDistance};
+        return packet;
+    }
+    
+    bool decodeSensorPacket(void const* pv, std::size_t cb, SSensorPacket& packet) {
+        if(sizeof(SSensorData)==cb) {
+            SSensorData data;
+            std::memcpy(&data, pv, cb);
+            packet = toSensorPacket(data);
+            return true;
+        }
+        
+        auto const* pb = static_cast<unsigned char const*>(pv);
+        if(cb < 2
+        || c_nSensorPacketVersion!=pb[0]
+        || pb[1] < 1 || c_cMaxSonarReadings < pb[1]
+        || sensorPacketSize(pb[1])!=cb) {
+            return false;
+        }
+        std::memcpy(&packet, pv, cb);
+        return true;
+    }
+    
+    void coalesce(SSensorPacket& packetInto, SSensorPacket const& packet) {
+        // Readings of the older packet are now older by the duration of the newer one
+        for(int i=0; i<packetInto.m_cReadings; ++i) {
+            auto& reading = packetInto.m_areading[i];
+            reading.m_nAge = sensorAge(packet.m_nTime, packetInto.m_nTime - static_cast<std::uint32_t>(reading.m_nAge) * c_nAgeUnit);
+        }
+        
+        int const cDrop = std::max(0, packetInto.m_cReadings + packet.m_cReadings - c_cMaxSonarReadings);
+        std::copy(packetInto.m_areading + cDrop, packetInto.m_areading + packetInto.m_cReadings, packetInto.m_areading);
+        packetInto.m_cReadings -= cDrop;
+        std::copy(packet.m_areading, packet.m_areading + packet.m_cReadings, packetInto.m_areading + packetInto.m_cReadings);
+        packetInto.m_cReadings += packet.m_cReadings;
+        
+        for(int i=0; i<4; ++i) {
+            packetInto.m_anEncoderTicks[i] += packet.m_anEncoderTicks[i];
+        }
+        packetInto.m_nTime = packet.m_nTime;
+        packetInto.m_nYaw = packet.m_nYaw;
+        packetInto.m_nYawAge = packet.m_nYawAge;
+        packetInto.m_ecmdLast = packet.m_ecmdLast;
+    }
+    
+    bool CSensorPacketBuilder::add(SSensorData const& data, std::uint32_t nMicroseconds) {
+        if(0==m_packet.m_cReadings) {
+            std::fill(m_packet.m_anEncoderTicks, m_packet.m_anEncoderTicks + 4, 0);
+        }
+        m_anTime[m_packet.m_cReadings] = nMicroseconds;
+        m_packet.m_areading[m_packet.m_cReadings] = {0, data.m_nAngle, data.m_nDistance};
+        ++m_packet.m_cReadings;
+        
+        for(int i=0; i<4; ++i) {
+            m_packet.m_anEncoderTicks[i] += data.m_anEncoderTicks[i];
+        }
+        m_packet.m_nYaw = data.m_nYaw;
+        m_packet.m_ecmdLast = data.m_ecmdLast;
+        m_nTimeLast = nMicroseconds;
+        
+        return c_cMaxSonarReadings==m_packet.m_cReadings
+            || c_nMaxPacketDuration * 1000u <= nMicroseconds - m_nTimeLastPacket;
+    }
+    
+    SSensorPacket CSensorPacketBuilder::pop() {
+        auto packet = m_packet;
+        for(int i=0; i<packet.m_cReadings; ++i) {
+            packet.m_areading[i].m_nAge = sensorAge(m_nTimeLast, m_anTime[i]);
+        }
+        packet.m_nTime = m_nTimeLast;
+        packet.m_nYawAge = 0; // the simulator measures yaw at the end of each loop
+        
+        m_nTimeLastPacket = m_nTimeLast;
+        m_packet.m_cReadings = 0;
+        return packet;
+    }
+}
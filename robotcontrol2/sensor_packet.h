@@ -0,0 +1,48 @@
+//
+//  sensor_packet.h
+//  robotcontrol2
+//
+//  Decoding, merging and assembling of SSensorPackets.
+//
+
+#ifndef sensor_packet_h
+#define sensor_packet_h
+
+#include "robot_controller_c.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rbt {
+    // Converts a single SSensorData record into a packet with one reading.
+    // Older firmware sends no timestamps, so all fields are timestamped with the arrival time.
+    SSensorPacket toSensorPacket(SSensorData const& data);
+    
+    // Accepts either an SSensorData record or an SSensorPacket.
+    // Returns false if the data is neither.
+    bool decodeSensorPacket(void const* pv, std::size_t cb, SSensorPacket& packet);
+    
+    // Appends the newer packet to packetInto. Encoder ticks are summed, time,
+    // yaw and last command are taken from the newer packet. If there are too many
+    // readings, the oldest readings are dropped.
+    void coalesce(SSensorPacket& packetInto, SSensorPacket const& packet);
+    
+    // Collects the SSensorData of consecutive rover loops into packets,
+    // the same way the rover firmware does.
+    struct CSensorPacketBuilder {
+        // Adds the data of one rover loop that ended at nMicroseconds.
+        // Returns true if the packet is due to be sent.
+        bool add(SSensorData const& data, std::uint32_t nMicroseconds);
+        
+        // Returns the collected packet and starts a new one
+        SSensorPacket pop();
+        
+    private:
+        SSensorPacket m_packet = {c_nSensorPacketVersion, 0};
+        std::uint32_t m_anTime[c_cMaxSonarReadings];
+        std::uint32_t m_nTimeLastPacket = 0;
+        std::uint32_t m_nTimeLast = 0;
+    };
+}
+
+#endif /* sensor_packet_h */
@@ -0,0 +1,51 @@
+//
+//  sonar_filter.cpp
+//  robotcontrol2
+//
+
+#include "sonar_filter.h"
+#include "robot_controller_c.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cstdlib>
+
+namespace rbt {
+    namespace {
+        int const c_nMinTolerance = 15; // cm
+        double const c_fRelativeTolerance = 0.15; // of the median
+    }
+    
+    bool CSonarFilter::accept(int nAngle, int nDistance, rbt::point<double> const& ptf, double fYaw, COccupancyGrid& occgrid) {
+        assert(nAngle==0 || std::abs(nAngle)==90);
+        auto& window = m_awindow[nAngle / 90 + 1];
+        window.m_anDistance[window.m_iNext] = nDistance;
+        window.m_iNext = (window.m_iNext + 1) % c_cWindow;
+        window.m_cReadings = std::min(window.m_cReadings + 1, c_cWindow);
+        if(window.m_cReadings < c_cWindow) return true;
+        
+        auto anSorted = window.m_anDistance;
+        std::nth_element(anSorted.begin(), anSorted.begin() + c_cWindow / 2, anSorted.end());
+        auto const nMedian = anSorted[c_cWindow / 2];
+        auto const nTolerance = std::max(c_nMinTolerance, static_cast<int>(nMedian * c_fRelativeTolerance));
+        if(std::abs(nDistance - nMedian) <= nTolerance) return true;
+        
+        auto const nExpected = ExpectedDistance(ptf, fYaw + M_PI_2 * rbt::sign(nAngle), occgrid);
+        return 0 <= nExpected && std::abs(nDistance - nExpected) <= nTolerance;
+    }
+    
+    int CSonarFilter::ExpectedDistance(rbt::point<double> const& ptf, double fAngle, COccupancyGrid& occgrid) {
+        // Distance to the first obstacle on the sonar axis, -1 if there is none within sonar range
+        occgrid.decayRegion(rbt::rect<int>::bound({
+            occgrid.toGridCoordinates(ptf),
+            occgrid.toGridCoordinates(ptf + rbt::size<double>::fromAngleAndDistance(fAngle, c_fSonarMaxDistance))
+        }));
+        auto const& matnGreyscale = occgrid.GreyscaleMap();
+        for(int nDistance = occgrid.m_nScale; nDistance <= c_fSonarMaxDistance; nDistance += occgrid.m_nScale) {
+            auto const ptn = occgrid.toGridCoordinates(ptf + rbt::size<double>::fromAngleAndDistance(fAngle, nDistance));
+            if(ptn.x < 0 || occgrid.m_szn.x <= ptn.x || ptn.y < 0 || occgrid.m_szn.y <= ptn.y) break;
+            if(matnGreyscale.at<std::uint8_t>(ptn.y, ptn.x) < occgrid.m_params.m_nFreeThreshold) return nDistance;
+        }
+        return -1;
+    }
+}
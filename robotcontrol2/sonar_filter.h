@@ -0,0 +1,44 @@
+//
+//  sonar_filter.h
+//  robotcontrol2
+//
+//  Rejects outliers among the sonar readings before they are inserted into the map,
+//  e.g., missing echoes and multipath returns. Each sonar keeps its last readings in
+//  a fixed ring buffer. A reading is accepted if it is close to the median of that
+//  window, or else if the map expects an obstacle at that distance on the sonar axis.
+//  Readings that persist, e.g., because an obstacle appeared, become the median after
+//  half a window and are accepted again.
+//
+
+#ifndef sonar_filter_h
+#define sonar_filter_h
+
+#include "geometry.h"
+#include "occupancy_grid.h"
+
+#include <array>
+
+#ifndef RBT_SONAR_FILTER
+#define RBT_SONAR_FILTER 0
+#endif
+
+namespace rbt {
+    struct CSonarFilter {
+        // nDistance from robot center, ptf and fYaw the robot pose when the reading was taken
+        bool accept(int nAngle, int nDistance, rbt::point<double> const& ptf, double fYaw, COccupancyGrid& occgrid);
+        
+    private:
+        static int ExpectedDistance(rbt::point<double> const& ptf, double fAngle, COccupancyGrid& occgrid);
+        
+        static int const c_cSonars = 3; // at -90, 0 and 90 degrees
+        static int const c_cWindow = 5;
+        struct SWindow {
+            std::array<int, c_cWindow> m_anDistance;
+            int m_iNext = 0;
+            int m_cReadings = 0;
+        };
+        std::array<SWindow, c_cSonars> m_awindow;
+    };
+}
+
+#endif /* sonar_filter_h */
@@ -0,0 +1,170 @@
+//
+//  spsc_queue.h
+//  robotcontrol2
+//
+//  Bounded single-producer/single-consumer ring buffer. Neither side ever
+//  blocks the other: When the buffer is full, the producer either discards
+//  the oldest element or coalesces the new element into a pending element.
+//  The pending element is the newest one, the consumer takes it as soon as it
+//  has taken everything before it, and the producer publishes it in the ring
+//  if there is room again before that.
+//
+//  push() is wait-free, it takes a bounded number of steps. pop() is only
+//  lock-free, not wait-free: It retries when the producer overwrites the slot
+//  it is copying (overflow_policy::drop_oldest) or publishes or claims the
+//  pending element while the consumer tries to claim it (overflow_policy::coalesce).
+//  It retries at most once per push, but a producer that pushes continuously can
+//  delay it indefinitely.
+//
+
+#ifndef spsc_queue_h
+#define spsc_queue_h
+
+#include "nonmoveable.h"
+
+#include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+namespace rbt {
+    enum class overflow_policy {
+        drop_oldest,
+        coalesce
+    };
+    
+    template<typename T, std::size_t N>
+    struct CSpscQueue : rbt::nonmoveable {
+        static_assert(0 < N && 0==(N & (N - 1)), "Capacity must be a power of two");
+        static_assert(std::is_trivially_copyable<T>::value, "Elements are copied while the producer may overwrite them");
+        
+        // fnCoalesce(tInto, t) merges t into tInto, required for overflow_policy::coalesce
+        CSpscQueue(overflow_policy epolicy, std::function<void(T&, T const&)> fnCoalesce = nullptr)
+            : m_epolicy(epolicy)
+            , m_fnCoalesce(std::move(fnCoalesce))
+        {
+            assert(overflow_policy::coalesce!=epolicy || m_fnCoalesce);
+        }
+        
+        // Producer side. Returns false if the queue overflowed and
+        // an element was dropped or coalesced.
+        bool push(T const& t) {
+            // Unless the consumer is already taking it, the pending element must
+            // be published before t or t must be coalesced into it
+            auto nPending = m_nPending.load(std::memory_order_acquire);
+            if(pending::ready==State(nPending)
+            && m_nPending.compare_exchange_strong(nPending, WithState(nPending, pending::producer), std::memory_order_acq_rel)) {
+                if(full()) {
+                    m_fnCoalesce(m_tPending, t);
+                    m_nPending.store(nPending, std::memory_order_release); // ready again, still after the same elements
+                    m_cOverflows.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                publish(m_tPending);
+                m_nPending.store(c_nNoPending, std::memory_order_release);
+            }
+            
+            if(full()) {
+                m_cOverflows.fetch_add(1, std::memory_order_relaxed);
+                if(overflow_policy::coalesce==m_epolicy) {
+                    if(pending::none==State(m_nPending.load(std::memory_order_acquire))) {
+                        m_tPending = t;
+                        m_nPending.store(Pending(m_nWrite.load(std::memory_order_relaxed), pending::ready), std::memory_order_release);
+                    }
+                    // else the consumer is still copying the pending element, which can only
+                    // happen if the producer filled the whole ring meanwhile. t is dropped
+                    // instead of waiting.
+                    return false;
+                }
+                
+                // Discard the oldest element. If the CAS fails, the consumer
+                // has just taken it and there is room now anyway.
+                auto nRead = m_nRead.load(std::memory_order_acquire);
+                m_nRead.compare_exchange_strong(nRead, nRead + 1, std::memory_order_acq_rel);
+                publish(t);
+                return false;
+            }
+            
+            publish(t);
+            return true;
+        }
+        
+        // Consumer side. Returns false if the queue is empty.
+        bool pop(T& t) {
+            auto nRead = m_nRead.load(std::memory_order_acquire);
+            for(;;) {
+                if(nRead==m_nWrite.load(std::memory_order_acquire)) {
+                    // While the pending element is ready, the producer publishes nothing, so it
+                    // is next if it follows the element at nRead. Once claimed, the producer
+                    // only publishes elements after it.
+                    auto nPending = m_nPending.load(std::memory_order_acquire);
+                    if(pending::ready!=State(nPending)) return false;
+                    if(nRead==Write(nPending)
+                    && m_nPending.compare_exchange_strong(nPending, WithState(nPending, pending::consumer), std::memory_order_acq_rel)) {
+                        t = m_tPending;
+                        m_nPending.store(c_nNoPending, std::memory_order_release);
+                        return true;
+                    }
+                    continue; // the producer has published or claimed the pending element meanwhile
+                }
+                
+                // With overflow_policy::drop_oldest the producer may discard and
+                // overwrite this slot while we copy it. The CAS then fails and we
+                // retry with the next element, discarding the torn copy.
+                t = m_at[nRead % N];
+                if(m_nRead.compare_exchange_weak(nRead, nRead + 1, std::memory_order_acq_rel)) return true;
+            }
+        }
+        
+        bool empty() const {
+            return m_nRead.load(std::memory_order_acquire)==m_nWrite.load(std::memory_order_acquire)
+                && pending::ready!=State(m_nPending.load(std::memory_order_acquire));
+        }
+        
+        std::uint64_t overflows() const { return m_cOverflows.load(std::memory_order_relaxed); }
+        
+    private:
+        // Owner of m_tPending
+        enum class pending {
+            none, // no pending element, the producer may write it
+            ready, // either side may claim it with a CAS
+            producer, // the producer coalesces into it or publishes it
+            consumer // the consumer copies it
+        };
+        // m_nPending holds the state and the write position the pending element follows
+        static std::uint64_t Pending(std::uint64_t nWrite, pending epending) { return nWrite << 2 | static_cast<std::uint64_t>(epending); }
+        static std::uint64_t WithState(std::uint64_t nPending, pending epending) { return Pending(Write(nPending), epending); }
+        static std::uint64_t Write(std::uint64_t nPending) { return nPending >> 2; }
+        static pending State(std::uint64_t nPending) { return static_cast<pending>(nPending & 3); }
+        static constexpr std::uint64_t c_nNoPending = 0;
+        
+        bool full() const {
+            return m_nWrite.load(std::memory_order_relaxed) - m_nRead.load(std::memory_order_acquire) == N;
+        }
+        
+        void publish(T const& t) {
+            auto const nWrite = m_nWrite.load(std::memory_order_relaxed);
+            m_at[nWrite % N] = t;
+            m_nWrite.store(nWrite + 1, std::memory_order_release);
+        }
+        
+        overflow_policy const m_epolicy;
+        std::function<void(T&, T const&)> const m_fnCoalesce;
+        
+        T m_at[N];
+        
+        // Read and write positions only increase, so they are never confused after wrapping around.
+        // Keep them on separate cache lines to avoid false sharing between producer and consumer.
+        alignas(64) std::atomic<std::uint64_t> m_nRead{0};
+        alignas(64) std::atomic<std::uint64_t> m_nWrite{0};
+        
+        // Newest element with overflow_policy::coalesce, see pending and Pending()
+        alignas(64) T m_tPending;
+        std::atomic<std::uint64_t> m_nPending{c_nNoPending};
+        std::atomic<std::uint64_t> m_cOverflows{0};
+    };
+}
+
+#endif /* spsc_queue_h */
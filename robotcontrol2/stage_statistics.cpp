@@ -0,0 +1,81 @@
+//
+//  stage_statistics.cpp
+//  robotcontrol2
+//
+
+#include "stage_statistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rbt {
+    int CLatencyHistogram::BucketIndex(std::uint64_t n) {
+        if(n < c_cSubBuckets) return static_cast<int>(n);
+        
+        int nMostSignificantBit = 63;
+        while(0==(n & (std::uint64_t(1) << nMostSignificantBit))) --nMostSignificantBit;
+        
+        int const nShift = nMostSignificantBit - c_nSubBucketBits;
+        int const iBucket = (nShift + 1) * c_cSubBuckets + static_cast<int>((n >> nShift) - c_cSubBuckets);
+        return std::min(iBucket, c_cBuckets - 1);
+    }
+    
+    std::uint64_t CLatencyHistogram::BucketUpperBound(int iBucket) {
+        if(iBucket < c_cSubBuckets) return iBucket;
+        int const nShift = iBucket / c_cSubBuckets - 1;
+        std::uint64_t const nLowerBound = std::uint64_t(c_cSubBuckets + iBucket % c_cSubBuckets) << nShift;
+        return nLowerBound + (std::uint64_t(1) << nShift) - 1;
+    }
+    
+    void CLatencyHistogram::record(std::uint64_t nNanoseconds) {
+        increment(m_acBuckets[BucketIndex(nNanoseconds)], 1);
+        increment(m_cSamples, 1);
+        increment(m_nTotal, nNanoseconds);
+        if(m_nMax.load(std::memory_order_relaxed) < nNanoseconds) {
+            m_nMax.store(nNanoseconds, std::memory_order_relaxed);
+        }
+    }
+    
+    void CLatencyHistogram::read(SStageStats& stagestats) const {
+        // The writer may record concurrently, so the buckets may not add
+        // up to m_cSamples exactly. Use the sum of the buckets we read.
+        std::uint64_t acBuckets[c_cBuckets];
+        std::uint64_t cSamples = 0;
+        for(int i=0; i<c_cBuckets; ++i) {
+            acBuckets[i] = m_acBuckets[i].load(std::memory_order_relaxed);
+            cSamples += acBuckets[i];
+        }
+        
+        stagestats.m_cSamples = cSamples;
+        stagestats.m_nMeanNanoseconds = 0<cSamples ? m_nTotal.load(std::memory_order_relaxed) / cSamples : 0;
+        stagestats.m_nMaxNanoseconds = m_nMax.load(std::memory_order_relaxed);
+        
+        auto Percentile = [&](double fPercentile) -> unsigned long long {
+            auto const cBelow = static_cast<std::uint64_t>(std::ceil(cSamples * fPercentile));
+            std::uint64_t cSum = 0;
+            for(int i=0; i<c_cBuckets; ++i) {
+                cSum += acBuckets[i];
+                if(0<cSum && cBelow<=cSum) return BucketUpperBound(i);
+            }
+            return 0;
+        };
+        stagestats.m_nP50Nanoseconds = Percentile(0.5);
+        stagestats.m_nP90Nanoseconds = Percentile(0.9);
+        stagestats.m_nP99Nanoseconds = Percentile(0.99);
+        stagestats.m_nP999Nanoseconds = Percentile(0.999);
+    }
+    
+    void CStageStatistics::read(SRobotStats& stats) const {
+        for(int i=0; i<stage_count; ++i) {
+            m_ahistogram[i].read(stats.m_astage[i]);
+        }
+        stats.m_cCellsTouched = m_cCellsTouched.load(std::memory_order_relaxed);
+        stats.m_cRaysWalked = m_cRaysWalked.load(std::memory_order_relaxed);
+        stats.m_cArenaOverflows = m_cArenaOverflows.load(std::memory_order_relaxed);
+        stats.m_cMapScrolls = m_cMapScrolls.load(std::memory_order_relaxed);
+        stats.m_cTilesDecayed = m_cTilesDecayed.load(std::memory_order_relaxed);
+        stats.m_cReadingsRejected = m_cReadingsRejected.load(std::memory_order_relaxed);
+        stats.m_cSpeculativePlans = m_cSpeculativePlans.load(std::memory_order_relaxed);
+        stats.m_cSpeculativeHits = m_cSpeculativeHits.load(std::memory_order_relaxed);
+    }
+}
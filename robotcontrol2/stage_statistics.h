@@ -0,0 +1,101 @@
+//
+//  stage_statistics.h
+//  robotcontrol2
+//
+//  Per-stage latency histograms and work counters of the sensor data processing.
+//  Compiled out completely unless RBT_STAGE_STATISTICS is non-zero.
+//
+
+#ifndef stage_statistics_h
+#define stage_statistics_h
+
+#include "robot_controller_c.h"
+#include "nonmoveable.h"
+
+#include <boost/preprocessor/cat.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#ifndef RBT_STAGE_STATISTICS
+#define RBT_STAGE_STATISTICS 1
+#endif
+
+namespace rbt {
+    // Log-linear histogram like HdrHistogram: Every power of two is divided into
+    // c_cSubBuckets linear buckets, i.e., values are recorded with a relative error < 1/c_cSubBuckets.
+    // Written by a single thread, may be read concurrently by any other thread.
+    struct CLatencyHistogram {
+        static int const c_nSubBucketBits = 3;
+        static int const c_cSubBuckets = 1 << c_nSubBucketBits;
+        static int const c_cBuckets = c_cSubBuckets * 40; // up to 2^40 ns ~ 18 min
+        
+        void record(std::uint64_t nNanoseconds);
+        void read(SStageStats& stagestats) const;
+        
+    private:
+        static int BucketIndex(std::uint64_t n);
+        static std::uint64_t BucketUpperBound(int iBucket);
+        
+        // Single writer, so a relaxed load and store suffice, no atomic read-modify-write necessary
+        static void increment(std::atomic<std::uint64_t>& n, std::uint64_t nAdd) {
+            n.store(n.load(std::memory_order_relaxed) + nAdd, std::memory_order_relaxed);
+        }
+        
+        std::atomic<std::uint64_t> m_acBuckets[c_cBuckets] = {};
+        std::atomic<std::uint64_t> m_cSamples{0};
+        std::atomic<std::uint64_t> m_nTotal{0};
+        std::atomic<std::uint64_t> m_nMax{0};
+    };
+    
+    struct CStageStatistics : rbt::nonmoveable {
+        void record(processing_stage estage, std::chrono::steady_clock::duration dt) {
+            m_ahistogram[estage].record(std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count());
+        }
+        
+        static void count(std::atomic<std::uint64_t>& n, std::uint64_t nAdd) {
+            n.store(n.load(std::memory_order_relaxed) + nAdd, std::memory_order_relaxed);
+        }
+        
+        void read(SRobotStats& stats) const;
+        
+        std::atomic<std::uint64_t> m_cCellsTouched{0};
+        std::atomic<std::uint64_t> m_cRaysWalked{0};
+        std::atomic<std::uint64_t> m_cArenaOverflows{0};
+        std::atomic<std::uint64_t> m_cMapScrolls{0};
+        std::atomic<std::uint64_t> m_cTilesDecayed{0};
+        std::atomic<std::uint64_t> m_cReadingsRejected{0};
+        std::atomic<std::uint64_t> m_cSpeculativePlans{0}; // written by the planning thread only
+        std::atomic<std::uint64_t> m_cSpeculativeHits{0};
+        
+    private:
+        CLatencyHistogram m_ahistogram[stage_count];
+    };
+    
+    struct CStageTimer : rbt::nonmoveable {
+        CStageTimer(CStageStatistics& stats, processing_stage estage)
+            : m_stats(stats), m_estage(estage), m_tStart(std::chrono::steady_clock::now())
+        {}
+        
+        ~CStageTimer() {
+            m_stats.record(m_estage, std::chrono::steady_clock::now() - m_tStart);
+        }
+        
+    private:
+        CStageStatistics& m_stats;
+        processing_stage const m_estage;
+        std::chrono::steady_clock::time_point const m_tStart;
+    };
+}
+
+#if RBT_STAGE_STATISTICS
+// Measures the time until the end of the enclosing scope
+#define RBT_TIME_STAGE(stats, estage) rbt::CStageTimer const BOOST_PP_CAT(stagetimer, __LINE__)((stats), (estage))
+#define RBT_COUNT(stats, counter, n) (stats).count((stats).counter, (n))
+#else
+#define RBT_TIME_STAGE(stats, estage)
+#define RBT_COUNT(stats, counter, n)
+#endif
+
+#endif /* stage_statistics_h */
@@ -0,0 +1,94 @@
+//
+//  target_planner.cpp
+//  robotcontrol2
+//
+
+#include "target_planner.h"
+
+#include <utility>
+
+namespace rbt {
+    CTargetPlanner::CTargetPlanner(FnPlan fnPlan, planning_mode eplanning, CStageStatistics& stats)
+        : m_fnPlan(fnPlan)
+        , m_stats(stats)
+    {
+        if(planning_mode::background == eplanning) m_thread = std::thread([this] { run(); });
+    }
+    
+    CTargetPlanner::~CTargetPlanner() {
+        if(!m_thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bStop = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+    
+    void CTargetPlanner::request(SRequest const& req, cv::Mat const& matnCost, cv::Mat const& matnVisited,
+                                 SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy) {
+        if(!m_thread.joinable()) {
+            // Only the visited mask is modified by fnPlan, the other maps need no copy
+            matnVisited.copyTo(m_matnVisited);
+            m_ptnResult = plan(req, matnCost, sumsUnknown, sumsEntropy);
+            m_nRequestDone = ++m_nRequest;
+            return;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_req = req;
+            matnCost.copyTo(m_matnCostRequest);
+            matnVisited.copyTo(m_matnVisitedRequest);
+            sumsUnknown.copyTo(m_sumsUnknownRequest);
+            sumsEntropy.copyTo(m_sumsEntropyRequest);
+            m_nRequestPending = ++m_nRequest;
+        }
+        m_cv.notify_one();
+    }
+    
+    void CTargetPlanner::cancel() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_nRequest;
+        m_nRequestPending = 0;
+    }
+    
+    boost::optional<rbt::point<int>> CTargetPlanner::result() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(0 == m_nRequestDone || m_nRequestDone != m_nRequest) return boost::none;
+        m_nRequestDone = 0;
+        return m_ptnResult;
+    }
+    
+    void CTargetPlanner::run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(true) {
+            m_cv.wait(lock, [this] { return m_bStop || 0 != m_nRequestPending; });
+            if(m_bStop) return;
+            
+            // Take the request, the request maps keep their buffers for the next request
+            auto const nRequest = m_nRequestPending;
+            m_nRequestPending = 0;
+            auto const req = m_req;
+            std::swap(m_matnCost, m_matnCostRequest);
+            std::swap(m_matnVisited, m_matnVisitedRequest);
+            std::swap(m_sumsUnknown, m_sumsUnknownRequest);
+            std::swap(m_sumsEntropy, m_sumsEntropyRequest);
+            
+            lock.unlock();
+            auto const ptnResult = plan(req, m_matnCost, m_sumsUnknown, m_sumsEntropy);
+            lock.lock();
+            
+            if(nRequest == m_nRequest) { // not cancelled or superseded meanwhile
+                m_ptnResult = ptnResult;
+                m_nRequestDone = nRequest;
+            }
+        }
+    }
+    
+    rbt::point<int> CTargetPlanner::plan(SRequest const& req, cv::Mat const& matnCost, SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy) {
+        RBT_TIME_STAGE(m_stats, stage_speculative_plan);
+        RBT_COUNT(m_stats, m_cSpeculativePlans, 1);
+        return m_fnPlan(req, matnCost, m_matnVisited, sumsUnknown, sumsEntropy);
+    }
+}
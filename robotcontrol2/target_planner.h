@@ -0,0 +1,89 @@
+//
+//  target_planner.h
+//  robotcontrol2
+//
+//  Plans the next exploration target on a background thread while the robot is
+//  still driving to the current one. request() copies the cost map, the visited
+//  mask and the summed-area tables of CInformationGain, so the mapping thread can keep
+//  changing them. The copies reuse their buffers, so requests don't allocate.
+//  The result is a candidate planned on an outdated map and must be validated before
+//  the robot drives there. planning_mode::synchronous plans within request() instead,
+//  e.g., for simulations that must not depend on thread scheduling.
+//
+
+#ifndef target_planner_h
+#define target_planner_h
+
+#include "nonmoveable.h"
+#include "geometry.h"
+#include "stage_statistics.h"
+#include "information_gain.h"
+
+#include <opencv2/core.hpp>
+#include <boost/optional.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace rbt {
+    enum class planning_mode {
+        background, // on the planning thread, the result is ready whenever planning has finished
+        synchronous // in request(), no planning thread is started
+    };
+    
+    struct CTargetPlanner : rbt::nonmoveable {
+        // Everything a plan needs besides the maps, in grid coordinates
+        struct SRequest {
+            rbt::point<int> m_ptnFrom; // robot position
+            rbt::point<int> m_ptnTarget; // plan from here
+            int m_nVisitedRadius;
+            int m_nScale;
+        };
+        // May modify its copy of the visited mask. The summed-area tables may be empty.
+        using FnPlan = rbt::point<int> (*)(SRequest const& req, cv::Mat const& matnCost, cv::Mat& matnVisited,
+                                           SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy);
+        
+        CTargetPlanner(FnPlan fnPlan, planning_mode eplanning, CStageStatistics& stats);
+        ~CTargetPlanner();
+        
+        // Mapping thread. Discards the previous request and its result.
+        void request(SRequest const& req, cv::Mat const& matnCost, cv::Mat const& matnVisited,
+                     SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy);
+        void cancel();
+        // boost::none while planning or if there is no request,
+        // point<int>::invalid() if fnPlan found no target. Returns a result only once.
+        boost::optional<rbt::point<int>> result();
+    
+    private:
+        void run();
+        rbt::point<int> plan(SRequest const& req, cv::Mat const& matnCost, SBlockedSums const& sumsUnknown, SBlockedSums const& sumsEntropy);
+        
+        FnPlan const m_fnPlan;
+        CStageStatistics& m_stats;
+        
+        // Planning thread only, or the caller of request() with planning_mode::synchronous
+        cv::Mat m_matnCost;
+        cv::Mat m_matnVisited;
+        SBlockedSums m_sumsUnknown;
+        SBlockedSums m_sumsEntropy;
+        
+        std::mutex m_mutex; // guards all members below
+        std::condition_variable m_cv;
+        SRequest m_req;
+        cv::Mat m_matnCostRequest;
+        cv::Mat m_matnVisitedRequest;
+        SBlockedSums m_sumsUnknownRequest;
+        SBlockedSums m_sumsEntropyRequest;
+        std::uint64_t m_nRequest = 0; // incremented by request() and cancel()
+        std::uint64_t m_nRequestPending = 0; // m_nRequest of a request not yet taken by the planning thread, or 0
+        std::uint64_t m_nRequestDone = 0; // m_nRequest of m_ptnResult, or 0
+        rbt::point<int> m_ptnResult = rbt::point<int>::invalid();
+        bool m_bStop = false;
+        
+        std::thread m_thread; // declared last, so it starts after all other members are initialized. Not started with planning_mode::synchronous.
+    };
+}
+
+#endif /* target_planner_h */
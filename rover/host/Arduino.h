@@ -0,0 +1,76 @@
+//
+//  Arduino.h
+//  rover host build
+//
+//  Mock of the Arduino API, so the firmware can be compiled and run on Linux.
+//  Time only advances when the firmware waits or calls the hardware, see arduino_mock.h.
+//
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+// Arduino Mega 2560
+static const uint8_t A0 = 54;
+static const uint8_t A8 = 62;
+static const uint8_t A9 = 63;
+static const uint8_t A10 = 64;
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define _BV(bit) (1 << (bit))
+
+void pinMode(uint8_t nPin, uint8_t nMode);
+void digitalWrite(uint8_t nPin, uint8_t nValue);
+int digitalRead(uint8_t nPin);
+int analogRead(uint8_t nPin);
+void analogWrite(uint8_t nPin, int nValue);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long nMilliseconds);
+void delayMicroseconds(unsigned int nMicroseconds);
+unsigned long pulseIn(uint8_t nPin, uint8_t nState, unsigned long nTimeout = 1000000L);
+
+void attachInterrupt(uint8_t nInterrupt, void (*fnIsr)(), int nMode);
+void interrupts();
+void noInterrupts();
+
+// Pin change interrupt registers of port K (A8 - A15)
+extern uint8_t PCICR;
+extern uint8_t PCMSK2;
+#define PCIE2 2
+#define PCINT16 0
+#define PCINT17 1
+#define PCINT18 2
+
+#define ISR(vect) void vect()
+#define PCINT2_vect mock_PCINT2_vect
+void mock_PCINT2_vect();
+
+struct HardwareSerial {
+    void begin(unsigned long) {}
+    template<typename T> void print(T const&) {}
+    template<typename T> void println(T const&) {}
+    void println() {}
+};
+extern HardwareSerial Serial;
+
+#endif /* Arduino_h */
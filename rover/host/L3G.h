@@ -0,0 +1,27 @@
+//
+//  L3G.h
+//  rover host build
+//
+//  Mock of the gyro library. Readings are taken from g_mockimu, see arduino_mock.h.
+//
+
+#ifndef L3G_h
+#define L3G_h
+
+#include "Arduino.h"
+
+#define L3G_CTRL_REG1 0x20
+#define L3G_CTRL_REG4 0x23
+
+struct L3G {
+    struct vector {
+        int16_t x, y, z;
+    };
+    vector g;
+    
+    bool init() { return true; }
+    void writeReg(byte, byte) {}
+    void read();
+};
+
+#endif /* L3G_h */
@@ -0,0 +1,34 @@
+//
+//  LSM303.h
+//  rover host build
+//
+//  Mock of the accelerometer and compass library. Readings are taken from g_mockimu, see arduino_mock.h.
+//
+
+#ifndef LSM303_h
+#define LSM303_h
+
+#include "Arduino.h"
+
+struct LSM303 {
+    template <typename T> struct vector {
+        T x, y, z;
+    };
+    
+    enum deviceType { device_DLH, device_DLM, device_DLHC, device_D, device_auto };
+    enum regAddr { CTRL2 = 0x21, CTRL_REG4_A = 0x23 };
+    
+    vector<int16_t> a;
+    vector<int16_t> m;
+    
+    bool init() { return true; }
+    void enableDefault() {}
+    deviceType getDeviceType() { return device_D; }
+    void writeReg(byte, byte) {}
+    
+    void read() { readAcc(); readMag(); }
+    void readAcc();
+    void readMag();
+};
+
+#endif /* LSM303_h */
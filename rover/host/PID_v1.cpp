@@ -0,0 +1,60 @@
+//
+//  PID_v1.cpp
+//  rover host build
+//
+
+#include "PID_v1.h"
+#include "Arduino.h"
+
+namespace {
+    double const c_fOutputMin = 0;
+    double const c_fOutputMax = 255;
+    
+    double Clamp(double f) {
+        return constrain(f, c_fOutputMin, c_fOutputMax);
+    }
+}
+
+PID::PID(double* pfInput, double* pfOutput, double* pfSetpoint, double fKp, double fKi, double fKd, int nDirection)
+    : m_pfInput(pfInput)
+    , m_pfOutput(pfOutput)
+    , m_pfSetpoint(pfSetpoint)
+    , m_nSampleTime(100)
+    , m_fITerm(0)
+    , m_fLastInput(0)
+    , m_bAutomatic(false)
+{
+    double const fSampleTime = m_nSampleTime / 1000.0;
+    double const fSign = REVERSE==nDirection ? -1 : 1;
+    m_fKp = fSign * fKp;
+    m_fKi = fSign * fKi * fSampleTime;
+    m_fKd = fSign * fKd / fSampleTime;
+    m_nLastTime = millis() - m_nSampleTime;
+}
+
+void PID::SetMode(int nMode) {
+    bool const bAutomatic = AUTOMATIC==nMode;
+    if(bAutomatic && !m_bAutomatic) Initialize();
+    m_bAutomatic = bAutomatic;
+}
+
+bool PID::Compute() {
+    if(!m_bAutomatic) return false;
+    
+    unsigned long const nNow = millis();
+    if(nNow - m_nLastTime < m_nSampleTime) return false;
+    
+    double const fInput = *m_pfInput;
+    double const fError = *m_pfSetpoint - fInput;
+    m_fITerm = Clamp(m_fITerm + m_fKi * fError);
+    *m_pfOutput = Clamp(m_fKp * fError + m_fITerm - m_fKd * (fInput - m_fLastInput));
+    
+    m_fLastInput = fInput;
+    m_nLastTime = nNow;
+    return true;
+}
+
+void PID::Initialize() {
+    m_fITerm = Clamp(*m_pfOutput);
+    m_fLastInput = *m_pfInput;
+}
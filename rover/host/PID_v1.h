@@ -0,0 +1,39 @@
+//
+//  PID_v1.h
+//  rover host build
+//
+//  Same algorithm as the Arduino PID library that the firmware uses.
+//
+
+#ifndef PID_v1_h
+#define PID_v1_h
+
+#define AUTOMATIC 1
+#define MANUAL 0
+#define DIRECT 0
+#define REVERSE 1
+
+struct PID {
+    PID(double* pfInput, double* pfOutput, double* pfSetpoint, double fKp, double fKi, double fKd, int nDirection);
+    
+    void SetMode(int nMode);
+    bool Compute();
+    
+private:
+    void Initialize();
+    
+    double* m_pfInput;
+    double* m_pfOutput;
+    double* m_pfSetpoint;
+    double m_fKp;
+    double m_fKi;
+    double m_fKd;
+    
+    unsigned long m_nSampleTime; // ms
+    unsigned long m_nLastTime;
+    double m_fITerm;
+    double m_fLastInput;
+    bool m_bAutomatic;
+};
+
+#endif /* PID_v1_h */
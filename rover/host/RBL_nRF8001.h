@@ -0,0 +1,21 @@
+//
+//  RBL_nRF8001.h
+//  rover host build
+//
+//  Mock of the BLE shield library. The connection is controlled through arduino_mock.h.
+//
+
+#ifndef RBL_nRF8001_h
+#define RBL_nRF8001_h
+
+#include "Arduino.h"
+
+void ble_set_name(char const* szName);
+void ble_begin();
+bool ble_connected();
+int ble_available();
+int ble_read();
+void ble_write_bytes(unsigned char* pb, unsigned char cb);
+void ble_do_events();
+
+#endif /* RBL_nRF8001_h */
@@ -0,0 +1,6 @@
+//
+//  SPI.h
+//  rover host build
+//
+//  Not needed on the host.
+//
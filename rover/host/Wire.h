@@ -0,0 +1,14 @@
+//
+//  Wire.h
+//  rover host build
+//
+
+#ifndef Wire_h
+#define Wire_h
+
+struct TwoWire {
+    void begin() {}
+};
+extern TwoWire Wire;
+
+#endif /* Wire_h */
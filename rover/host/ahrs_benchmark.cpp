@@ -0,0 +1,250 @@
+//
+//  ahrs_benchmark.cpp
+//  rover host build
+//
+//  Replays gyro, accelerometer and magnetometer samples through the float DCM filter
+//  in ahrs.cpp and the fixed-point filter in ahrs_fixed.cpp. Reports the yaw difference
+//  between both filters, the yaw error against ground truth for the built-in synthetic
+//  run and the time per filter update on the host.
+//  Fails if the filters differ by more than one degree.
+//
+//  Usage: ahrs_benchmark [recording.csv]
+//  A recording has one line per filter update:
+//  millis,gyro.g.x,gyro.g.y,gyro.g.z,compass.a.x,compass.a.y,compass.a.z,compass.m.x,compass.m.y,compass.m.z
+//  as printed by the AHRS_TEST firmware with AHRS_RECORD defined.
+//
+
+#include "Arduino.h"
+#include "arduino_mock.h"
+#include "ahrs.h"
+#include "ahrs_fixed.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Float filter state in ahrs.cpp
+extern int gyro_x, gyro_y, gyro_z;
+extern int accel_x, accel_y, accel_z;
+extern int magnetom_x, magnetom_y, magnetom_z;
+extern unsigned int counter;
+extern long timer, timer_old;
+void Matrix_update();
+void Normalize();
+void Drift_correction();
+void Euler_angles();
+void Compass_Heading();
+
+namespace {
+    struct SSample {
+        unsigned long m_nMillis;
+        int16_t m_anGyro[3];
+        int16_t m_anAccel[3];
+        int16_t m_anMagnetometer[3];
+        double m_fYaw; // ground truth in radians, NAN if unknown
+    };
+
+    std::vector<SSample> ReadRecording(char const* szFile) {
+        std::vector<SSample> vecsample;
+        std::ifstream ifs(szFile);
+        std::string strLine;
+        while(std::getline(ifs, strLine)) {
+            if(strLine.empty() || !isdigit(strLine[0])) continue;
+            std::replace(strLine.begin(), strLine.end(), ',', ' ');
+            std::istringstream iss(strLine);
+            SSample sample;
+            iss >> sample.m_nMillis;
+            for(auto& n : sample.m_anGyro) iss >> n;
+            for(auto& n : sample.m_anAccel) iss >> n;
+            for(auto& n : sample.m_anMagnetometer) iss >> n;
+            sample.m_fYaw = NAN;
+            if(iss) vecsample.push_back(sample);
+        }
+        return vecsample;
+    }
+
+    // Rover standing level on the floor, turning left and right at different rates.
+    // Noisy sensors and a constant gyro bias that the magnetometer has to correct.
+    std::vector<SSample> SyntheticRun(unsigned long nStartMillis) {
+        struct { double m_fSeconds; double m_fDegreesPerSecond; } const asegment[] = {
+            {3, 0}, {2, 90}, {3, 0}, {4, -45}, {2, 0}, {8, 30}, {5, 0}, {3, -120}, {10, 0}, {20, 10}, {5, 0}
+        };
+        double const fGyroGain = 0.07 * M_PI / 180; // rad/s per digit
+
+        std::mt19937 rng(1);
+        std::normal_distribution<double> noise(0, 1);
+        std::vector<SSample> vecsample;
+        double fYaw = 0;
+        unsigned long nMillis = nStartMillis;
+        for(auto const& segment : asegment) {
+            double const fRate = segment.m_fDegreesPerSecond * M_PI / 180;
+            for(int i=0; i<segment.m_fSeconds * 50; ++i) {
+                nMillis += 20;
+                fYaw = std::remainder(fYaw + fRate * 0.02, 2 * M_PI);
+
+                SSample sample;
+                sample.m_nMillis = nMillis;
+                sample.m_anGyro[0] = (int16_t)std::lround(2 * noise(rng));
+                sample.m_anGyro[1] = (int16_t)std::lround(2 * noise(rng));
+                sample.m_anGyro[2] = (int16_t)std::lround(fRate / fGyroGain + 3 + 2 * noise(rng));
+                sample.m_anAccel[0] = (int16_t)std::lround(16 * 3 * noise(rng));
+                sample.m_anAccel[1] = (int16_t)std::lround(16 * 3 * noise(rng));
+                sample.m_anAccel[2] = (int16_t)std::lround(16 * (GRAVITY + 3 * noise(rng)));
+                // tilt compensated heading = atan2(-y, x) where x, y are scaled to +/-0.5
+                double const afMag[3] = {0.4 * std::cos(fYaw), -0.4 * std::sin(fYaw), 0.2};
+                sample.m_anMagnetometer[0] = (int16_t)std::lround((afMag[0] + 0.5) * (M_X_MAX - M_X_MIN) + M_X_MIN + 15 * noise(rng));
+                sample.m_anMagnetometer[1] = (int16_t)std::lround((afMag[1] + 0.5) * (M_Y_MAX - M_Y_MIN) + M_Y_MIN + 15 * noise(rng));
+                sample.m_anMagnetometer[2] = (int16_t)std::lround((afMag[2] + 0.5) * (M_Z_MAX - M_Z_MIN) + M_Z_MIN + 15 * noise(rng));
+                sample.m_fYaw = fYaw;
+                vecsample.push_back(sample);
+            }
+        }
+        return vecsample;
+    }
+
+    void SetImu(SSample const& sample) {
+        std::copy(sample.m_anGyro, sample.m_anGyro + 3, g_mockimu.m_anGyro);
+        std::copy(sample.m_anAccel, sample.m_anAccel + 3, g_mockimu.m_anAccel);
+        std::copy(sample.m_anMagnetometer, sample.m_anMagnetometer + 3, g_mockimu.m_anMagnetometer);
+    }
+
+    double AngleDifference(double fA, double fB) {
+        return std::remainder(fA - fB, 2 * M_PI);
+    }
+
+    // Corrected sensor values of one filter update, as computed by ahrs.cpp
+    struct SUpdate {
+        int m_anGyro[3];
+        int m_anAccel[3];
+        int m_anMagnetometer[3];
+        bool m_bCompass;
+        unsigned int m_nDtMillis;
+    };
+
+#if defined(__x86_64__) || defined(__i386__)
+    char const* const c_szTicks = "cycles";
+    unsigned long long Ticks() { return __rdtsc(); }
+#else
+    char const* const c_szTicks = "ns";
+    unsigned long long Ticks() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+#endif
+
+    template<typename Func>
+    double TicksPerUpdate(std::vector<SUpdate> const& vecupdate, Func fnUpdate) {
+        int const c_cRepetitions = 20;
+        auto const nStart = Ticks();
+        for(int i=0; i<c_cRepetitions; ++i) {
+            for(auto const& update : vecupdate) fnUpdate(update);
+        }
+        return static_cast<double>(Ticks() - nStart) / (c_cRepetitions * vecupdate.size());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // setupAHRS waits ~ 2.2 s and calibrates the gyro and accelerometer offsets
+    // from the first sample, so samples start afterwards
+    unsigned long const nStartMillis = 2500;
+    auto const vecsample = 1<argc ? ReadRecording(argv[1]) : SyntheticRun(nStartMillis);
+    if(vecsample.empty()) {
+        std::cerr << "No samples" << std::endl;
+        return 1;
+    }
+    std::cout << (1<argc ? argv[1] : "Synthetic run") << ", " << vecsample.size() << " samples" << std::endl;
+
+    SetImu(vecsample.front());
+    setupAHRS();
+
+    SDcmFixed dcmfixed;
+    std::vector<SUpdate> vecupdate;
+    double fMaxDifference = 0;
+    double fSumSqrDifference = 0;
+    double fMaxErrorFloat = 0;
+    double fMaxErrorFixed = 0;
+    int cCompared = 0;
+
+    for(auto const& sample : vecsample) {
+        SetImu(sample);
+        if(mock_micros() < sample.m_nMillis * 1000ull) mock_advance(sample.m_nMillis * 1000ull - mock_micros());
+        if(!updateAHRS()) continue;
+
+        SUpdate const update = {
+            {gyro_x, gyro_y, gyro_z},
+            {accel_x, accel_y, accel_z},
+            {magnetom_x, magnetom_y, magnetom_z},
+            0==counter,
+            static_cast<unsigned int>(timer>timer_old ? timer-timer_old : 0)
+        };
+        vecupdate.push_back(update);
+
+        if(update.m_bCompass) dcmfixed.updateHeading(magnetom_x, magnetom_y, magnetom_z);
+        dcmfixed.update(gyro_x, gyro_y, gyro_z, accel_x, accel_y, accel_z, update.m_nDtMillis);
+
+        // Let the filters converge to the magnetic heading first
+        if(sample.m_nMillis < vecsample.front().m_nMillis + 5000) continue;
+
+        double const fYawFloat = g_nYaw / 1000.0;
+        double const fYawFixed = dcmfixed.yaw() / 1000.0;
+        double const fDifference = std::abs(AngleDifference(fYawFixed, fYawFloat));
+        fMaxDifference = std::max(fMaxDifference, fDifference);
+        fSumSqrDifference += fDifference * fDifference;
+        ++cCompared;
+
+        if(!std::isnan(sample.m_fYaw)) {
+            fMaxErrorFloat = std::max(fMaxErrorFloat, std::abs(AngleDifference(fYawFloat, sample.m_fYaw)));
+            fMaxErrorFixed = std::max(fMaxErrorFixed, std::abs(AngleDifference(fYawFixed, sample.m_fYaw)));
+        }
+    }
+
+    double const c_fDegrees = 180 / M_PI;
+    std::cout << std::fixed << std::setprecision(3)
+        << "Yaw fixed vs. float: max " << fMaxDifference * c_fDegrees << " deg"
+        << ", rms " << std::sqrt(fSumSqrDifference / std::max(1, cCompared)) * c_fDegrees << " deg" << std::endl;
+    if(1==argc) {
+        std::cout << "Max. yaw error vs. ground truth: float " << fMaxErrorFloat * c_fDegrees << " deg"
+            << ", fixed " << fMaxErrorFixed * c_fDegrees << " deg" << std::endl;
+    }
+
+    // Time both filters on the same inputs. The float filter continues from its current state.
+    SDcmFixed dcmfixedTiming;
+    double const fTicksFloat = TicksPerUpdate(vecupdate, [](SUpdate const& update) {
+        gyro_x = update.m_anGyro[0]; gyro_y = update.m_anGyro[1]; gyro_z = update.m_anGyro[2];
+        accel_x = update.m_anAccel[0]; accel_y = update.m_anAccel[1]; accel_z = update.m_anAccel[2];
+        if(update.m_bCompass) {
+            magnetom_x = update.m_anMagnetometer[0]; magnetom_y = update.m_anMagnetometer[1]; magnetom_z = update.m_anMagnetometer[2];
+            Compass_Heading();
+        }
+        Matrix_update();
+        Normalize();
+        Drift_correction();
+        Euler_angles();
+    });
+    double const fTicksFixed = TicksPerUpdate(vecupdate, [&](SUpdate const& update) {
+        if(update.m_bCompass) {
+            dcmfixedTiming.updateHeading(update.m_anMagnetometer[0], update.m_anMagnetometer[1], update.m_anMagnetometer[2]);
+        }
+        dcmfixedTiming.update(update.m_anGyro[0], update.m_anGyro[1], update.m_anGyro[2],
+                              update.m_anAccel[0], update.m_anAccel[1], update.m_anAccel[2], update.m_nDtMillis);
+    });
+    std::cout << std::setprecision(0)
+        << "Host " << c_szTicks << " per update: float " << fTicksFloat << ", fixed " << fTicksFixed << std::endl;
+
+    double const c_fTolerance = 1 / c_fDegrees;
+    if(c_fTolerance < fMaxDifference) {
+        std::cout << "FAILED: Filters differ by more than 1 deg" << std::endl;
+        return 1;
+    }
+    return 0;
+}
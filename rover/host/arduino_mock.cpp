@@ -0,0 +1,231 @@
+//
+//  arduino_mock.cpp
+//  rover host build
+//
+
+#include "Arduino.h"
+#include "RBL_nRF8001.h"
+#include "Wire.h"
+#include "L3G.h"
+#include "LSM303.h"
+#include "arduino_mock.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+SMockCosts g_mockcosts;
+SMockImu g_mockimu;
+
+HardwareSerial Serial;
+TwoWire Wire;
+
+uint8_t PCICR = 0;
+uint8_t PCMSK2 = 0;
+
+__attribute__((weak)) void mock_PCINT2_vect() {}
+
+namespace {
+    unsigned long long g_nMicros = 0;
+    
+    int const c_cPins = 70;
+    uint8_t g_anPin[c_cPins];
+    std::multimap<unsigned long long, std::pair<int, uint8_t>> g_mapevents; // pin level changes by time
+    bool g_bInIsr = false;
+    
+    struct SSonarModel {
+        int m_nTriggerPin;
+        int m_nEchoPin;
+        std::function<unsigned long()> m_fnEchoMicros;
+    };
+    std::vector<SSonarModel> g_vecsonar;
+    unsigned long const c_nEchoDelay = 450; // us from trigger to start of echo pulse
+    
+    bool g_bBleConnected = false;
+    std::deque<unsigned char> g_dequeBle;
+    std::function<void(unsigned char const*, unsigned char)> g_fnBleWrite;
+    
+    void SetPin(int nPin, uint8_t nValue) {
+        if(g_anPin[nPin]==nValue) return;
+        g_anPin[nPin] = nValue;
+        
+        // Port K, A8 - A15
+        if(A8 <= nPin && nPin < A8 + 8
+        && (PCICR & _BV(PCIE2)) && (PCMSK2 & _BV(nPin - A8))
+        && !g_bInIsr) {
+            g_bInIsr = true;
+            mock_PCINT2_vect();
+            g_bInIsr = false;
+        }
+    }
+    
+    // Advances time to the next level change of nPin, but not beyond nDeadline
+    bool AdvanceToPinChange(int nPin, unsigned long long nDeadline) {
+        auto it = std::find_if(g_mapevents.begin(), g_mapevents.end(), [&](auto const& pairevent) {
+            return pairevent.second.first==nPin;
+        });
+        if(g_mapevents.end()==it || nDeadline < it->first) {
+            mock_advance(nDeadline - std::min(nDeadline, g_nMicros));
+            return false;
+        }
+        mock_advance(it->first - std::min(it->first, g_nMicros));
+        return true;
+    }
+}
+
+unsigned long long mock_micros() {
+    return g_nMicros;
+}
+
+void mock_advance(unsigned long long nMicros) {
+    auto const nTarget = g_nMicros + nMicros;
+    if(g_bInIsr) { // ISR time, events are processed after the ISR returns
+        g_nMicros = nTarget;
+        return;
+    }
+    while(!g_mapevents.empty() && g_mapevents.begin()->first <= nTarget) {
+        auto const event = *g_mapevents.begin();
+        g_mapevents.erase(g_mapevents.begin());
+        g_nMicros = std::max(g_nMicros, event.first);
+        SetPin(event.second.first, event.second.second);
+    }
+    g_nMicros = std::max(g_nMicros, nTarget);
+}
+
+void mock_add_sonar(int nTriggerPin, int nEchoPin, std::function<unsigned long()> fnEchoMicros) {
+    g_vecsonar.push_back({nTriggerPin, nEchoPin, std::move(fnEchoMicros)});
+}
+
+void mock_ble_connect(bool bConnected) {
+    g_bBleConnected = bConnected;
+}
+
+void mock_ble_receive(void const* pv, unsigned char cb) {
+    auto const* pb = static_cast<unsigned char const*>(pv);
+    g_dequeBle.insert(g_dequeBle.end(), pb, pb + cb);
+}
+
+void mock_ble_on_write(std::function<void(unsigned char const* pb, unsigned char cb)> fnWrite) {
+    g_fnBleWrite = std::move(fnWrite);
+}
+
+// Arduino API
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t nPin, uint8_t nValue) {
+    mock_advance(g_mockcosts.m_nDigitalIO);
+    bool const bFalling = HIGH==g_anPin[nPin] && LOW==nValue;
+    SetPin(nPin, nValue);
+    
+    if(bFalling) {
+        for(auto const& sonar : g_vecsonar) {
+            if(sonar.m_nTriggerPin!=nPin) continue;
+            if(auto const nEchoMicros = sonar.m_fnEchoMicros()) {
+                g_mapevents.emplace(g_nMicros + c_nEchoDelay, std::make_pair(sonar.m_nEchoPin, HIGH));
+                g_mapevents.emplace(g_nMicros + c_nEchoDelay + nEchoMicros, std::make_pair(sonar.m_nEchoPin, LOW));
+            }
+        }
+    }
+}
+
+int digitalRead(uint8_t nPin) {
+    mock_advance(g_mockcosts.m_nDigitalIO);
+    return g_anPin[nPin];
+}
+
+int analogRead(uint8_t) {
+    mock_advance(g_mockcosts.m_nAnalogIO);
+    return 0;
+}
+
+void analogWrite(uint8_t, int) {
+    mock_advance(g_mockcosts.m_nAnalogIO);
+}
+
+unsigned long millis() {
+    return static_cast<unsigned long>(g_nMicros / 1000);
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(g_nMicros);
+}
+
+void delay(unsigned long nMilliseconds) {
+    mock_advance(nMilliseconds * 1000ull);
+}
+
+void delayMicroseconds(unsigned int nMicroseconds) {
+    mock_advance(nMicroseconds);
+}
+
+unsigned long pulseIn(uint8_t nPin, uint8_t nState, unsigned long nTimeout) {
+    auto const nDeadline = g_nMicros + nTimeout;
+    // wait for the previous pulse to end and the next one to start
+    while(nState==g_anPin[nPin]) {
+        if(!AdvanceToPinChange(nPin, nDeadline)) return 0;
+    }
+    while(nState!=g_anPin[nPin]) {
+        if(!AdvanceToPinChange(nPin, nDeadline)) return 0;
+    }
+    auto const nStart = g_nMicros;
+    while(nState==g_anPin[nPin]) {
+        if(!AdvanceToPinChange(nPin, nDeadline)) return 0;
+    }
+    return static_cast<unsigned long>(g_nMicros - nStart);
+}
+
+void attachInterrupt(uint8_t, void (*)(), int) {}
+void interrupts() {}
+void noInterrupts() {}
+
+// BLE shield
+void ble_set_name(char const*) {}
+void ble_begin() {}
+
+bool ble_connected() {
+    return g_bBleConnected;
+}
+
+int ble_available() {
+    return static_cast<int>(g_dequeBle.size());
+}
+
+int ble_read() {
+    if(g_dequeBle.empty()) return -1;
+    int const n = g_dequeBle.front();
+    g_dequeBle.pop_front();
+    return n;
+}
+
+void ble_write_bytes(unsigned char* pb, unsigned char cb) {
+    if(g_fnBleWrite) g_fnBleWrite(pb, cb);
+}
+
+void ble_do_events() {
+    mock_advance(g_mockcosts.m_nBleEvents);
+}
+
+// IMU
+void L3G::read() {
+    ++g_mockimu.m_cGyroReads;
+    mock_advance(g_mockcosts.m_nI2CRead + g_mockcosts.m_nAhrsMath);
+    g.x = g_mockimu.m_anGyro[0];
+    g.y = g_mockimu.m_anGyro[1];
+    g.z = g_mockimu.m_anGyro[2];
+}
+
+void LSM303::readAcc() {
+    mock_advance(g_mockcosts.m_nI2CRead);
+    a.x = g_mockimu.m_anAccel[0];
+    a.y = g_mockimu.m_anAccel[1];
+    a.z = g_mockimu.m_anAccel[2];
+}
+
+void LSM303::readMag() {
+    mock_advance(g_mockcosts.m_nI2CRead);
+    m.x = g_mockimu.m_anMagnetometer[0];
+    m.y = g_mockimu.m_anMagnetometer[1];
+    m.z = g_mockimu.m_anMagnetometer[2];
+}
@@ -0,0 +1,45 @@
+//
+//  arduino_mock.h
+//  rover host build
+//
+//  Controls the simulated hardware behind the mocked Arduino API.
+//  Simulated time advances when the firmware waits (delay, pulseIn) and by the
+//  approximate cost of each hardware access on a 16 MHz Arduino Mega.
+//
+
+#ifndef arduino_mock_h
+#define arduino_mock_h
+
+#include <stdint.h>
+#include <functional>
+
+struct SMockCosts { // in us
+    unsigned long m_nDigitalIO = 5; // digitalRead, digitalWrite
+    unsigned long m_nAnalogIO = 110; // analogRead, analogWrite
+    unsigned long m_nI2CRead = 700; // one 6 byte IMU register read at 100 kHz
+    unsigned long m_nAhrsMath = 2500; // float DCM math of updateAHRS, charged to each gyro read
+    unsigned long m_nBleEvents = 200; // ble_do_events
+};
+extern SMockCosts g_mockcosts;
+
+// Raw sensor values returned by the mocked IMU libraries
+struct SMockImu {
+    int16_t m_anGyro[3];
+    int16_t m_anAccel[3];
+    int16_t m_anMagnetometer[3];
+    int m_cGyroReads;
+};
+extern SMockImu g_mockimu;
+
+unsigned long long mock_micros();
+void mock_advance(unsigned long long nMicros);
+
+// When the trigger pin goes low, the echo pin goes high for fnEchoMicros() us
+// after a short delay. No pulse is generated if fnEchoMicros returns 0.
+void mock_add_sonar(int nTriggerPin, int nEchoPin, std::function<unsigned long()> fnEchoMicros);
+
+void mock_ble_connect(bool bConnected);
+void mock_ble_receive(void const* pv, unsigned char cb); // data sent from the controller
+void mock_ble_on_write(std::function<void(unsigned char const* pb, unsigned char cb)> fnWrite);
+
+#endif /* arduino_mock_h */
@@ -0,0 +1,6 @@
+//
+//  boards.h
+//  rover host build
+//
+//  Not needed on the host.
+//
@@ -0,0 +1,78 @@
+//
+//  loop_benchmark.cpp
+//  rover host build
+//
+//  Runs the rover firmware against the mocked Arduino hardware and reports the
+//  main loop rate in simulated time. Build once with and once without SONAR_PULSEIN
+//  to compare blocking and interrupt-driven sonar ranging.
+//
+//  Usage: loop_benchmark [seconds]
+//
+
+#include "Arduino.h"
+#include "arduino_mock.h"
+#include "rover.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+void setup();
+void loop();
+
+int main(int argc, char* argv[]) {
+    double const fSeconds = 1<argc ? std::stod(argv[1]) : 60;
+    
+#if defined(SONAR_PULSEIN)
+    int const anEcho[] = {32, 36, 40};
+    std::cout << "Blocking sonar ranging (SONAR_PULSEIN)" << std::endl;
+#else
+    int const anEcho[] = {A8, A9, A10};
+    std::cout << "Interrupt-driven sonar ranging" << std::endl;
+#endif
+    int const anTrigger[] = {34, 38, 42};
+    int const anDistance[] = {80, 150, 300}; // cm to the left, front and right wall
+    for(int i=0; i<3; ++i) {
+        int const nDistance = anDistance[i];
+        mock_add_sonar(anTrigger[i], anEcho[i], [nDistance] { return nDistance * 58ul; });
+    }
+    
+    long long cPackets = 0;
+    long long cReadings = 0;
+    mock_ble_on_write([&](unsigned char const* pb, unsigned char cb) {
+        ++cPackets;
+        if(2<=cb) cReadings += pb[1]; // SSensorPacket::m_cReadings
+    });
+    
+    setup();
+    mock_ble_connect(true);
+    
+    auto const nStart = mock_micros();
+    auto const nEnd = nStart + static_cast<unsigned long long>(fSeconds * 1e6);
+    auto const cGyroReadsStart = g_mockimu.m_cGyroReads;
+    unsigned long long nNextCommand = nStart;
+    long long cLoops = 0;
+    unsigned long long nMaxLoop = 0;
+    
+    while(mock_micros() < nEnd) {
+        if(nNextCommand <= mock_micros()) { // controller keeps the rover moving
+            mock_ble_receive(&c_rcmdForward, sizeof(c_rcmdForward));
+            nNextCommand += 100000;
+        }
+        
+        auto const nLoopStart = mock_micros();
+        loop();
+        nMaxLoop = std::max(nMaxLoop, mock_micros() - nLoopStart);
+        ++cLoops;
+    }
+    
+    double const fElapsed = (mock_micros() - nStart) / 1e6;
+    std::cout << std::fixed << std::setprecision(1)
+        << fElapsed << " s simulated, " << cLoops / fElapsed << " loops/s"
+        << ", loop avg " << fElapsed * 1000 / cLoops << " ms, max " << nMaxLoop / 1000.0 << " ms" << std::endl
+        << "AHRS updates " << (g_mockimu.m_cGyroReads - cGyroReadsStart) / fElapsed << "/s"
+        << ", sonar readings " << cReadings / fElapsed << "/s"
+        << ", sensor packets " << cPackets / fElapsed << "/s" << std::endl;
+    return 0;
+}
@@ -29,6 +29,7 @@
  */
 
 #include "ahrs.h"
+#include "ahrs_fixed.h"
 
 #include "L3G.h"
 #include "LSM303.h"
@@ -56,8 +57,7 @@ int SENSOR_SIGN[9] = {1,1,1,-1,-1,-1,1,1,1}; //Correct directions x,y,z - gyro,
 #include <Wire.h>
 
 // LSM303 accelerometer: 8 g sensitivity
-// 3.9 mg/digit; 1 g = 256
-#define GRAVITY 256  //this equivalent to 1G in the raw data coming from the accelerometer
+// 3.9 mg/digit; 1 g = 256, see GRAVITY in ahrs.h
 
 #define ToRad(x) ((x)*0.01745329252)  // *pi/180
 #define ToDeg(x) ((x)*57.2957795131)  // *180/pi
@@ -71,20 +71,6 @@ int SENSOR_SIGN[9] = {1,1,1,-1,-1,-1,1,1,1}; //Correct directions x,y,z - gyro,
 #define Gyro_Scaled_Y(x) ((x)*ToRad(Gyro_Gain_Y)) //Return the scaled ADC raw data of the gyro in radians for second
 #define Gyro_Scaled_Z(x) ((x)*ToRad(Gyro_Gain_Z)) //Return the scaled ADC raw data of the gyro in radians for second
 
-// LSM303 magnetometer calibration constants; use the Calibrate example from
-// the Pololu LSM303 library to find the right values for your board
-#define M_X_MIN -2942
-#define M_Y_MIN -2995
-#define M_Z_MIN -1628
-#define M_X_MAX 3086
-#define M_Y_MAX 2941
-#define M_Z_MAX 4307
-
-#define Kp_ROLLPITCH 0.02
-#define Ki_ROLLPITCH 0.00002
-#define Kp_YAW 1.2
-#define Ki_YAW 0.00002
-
 /*For debugging purposes*/
 //OUTPUTMODE=1 will print the corrected data,
 //OUTPUTMODE=0 will print uncorrected data of the gyros (with drift)
@@ -159,6 +145,10 @@ float Temporary_Matrix[3][3]={
 L3G gyro;
 LSM303 compass;
 
+#if defined(AHRS_FIXED_POINT)
+SDcmFixed g_dcmfixed;
+#endif
+
 void I2C_Init()
 {
     Wire.begin();
@@ -487,6 +477,7 @@ void setupAHRS()
 int g_nRoll;
 int g_nPitch;
 int g_nYaw;
+unsigned long g_nYawTime;
 
 bool updateAHRS() //Main Loop
 {
@@ -502,6 +493,7 @@ bool updateAHRS() //Main Loop
         
         // *** DCM algorithm
         // Data adquisition
+        g_nYawTime = micros();
         Read_Gyro();   // This read gyro data
         Read_Accel();     // Read I2C accelerometer
         
@@ -509,9 +501,20 @@ bool updateAHRS() //Main Loop
         {
             counter=0;
             Read_Compass();    // Read I2C magnetometer
+#if defined(AHRS_FIXED_POINT)
+            g_dcmfixed.updateHeading(magnetom_x, magnetom_y, magnetom_z);
+#else
             Compass_Heading(); // Calculate magnetic heading
+#endif
         }
         
+#if defined(AHRS_FIXED_POINT)
+        g_dcmfixed.update(gyro_x, gyro_y, gyro_z, accel_x, accel_y, accel_z, timer>timer_old ? timer-timer_old : 0);
+        
+        g_nRoll = g_dcmfixed.roll();
+        g_nPitch = g_dcmfixed.pitch();
+        g_nYaw = g_dcmfixed.yaw();
+#else
         // Calculations...
         Matrix_update();
         Normalize();
@@ -521,6 +524,7 @@ bool updateAHRS() //Main Loop
         g_nRoll = (int)(roll * 1000 + 0.5);
         g_nPitch = (int)(pitch * 1000 + 0.5);
         g_nYaw = (int)(yaw * 1000 + 0.5);
+#endif
         
         // ***
         return true;
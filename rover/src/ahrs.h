@@ -9,6 +9,8 @@
 #ifndef ____ahrs__
 #define ____ahrs__
 
+// #define AHRS_FIXED_POINT // fixed-point DCM filter in ahrs_fixed.cpp instead of float
+
 void setupAHRS();
 bool updateAHRS();
 
@@ -16,6 +18,7 @@ bool updateAHRS();
 extern int g_nRoll;
 extern int g_nPitch;
 extern int g_nYaw;
+extern unsigned long g_nYawTime; // micros() when the gyro was read for g_nYaw
 
 #include "L3G.h"
 #include "LSM303.h"
@@ -23,4 +26,23 @@ extern int g_nYaw;
 extern L3G gyro;
 extern LSM303 compass;
 
+// Filter parameters, shared by the float and the fixed-point filter
+extern int SENSOR_SIGN[9];
+
+#define GRAVITY 256  //this equivalent to 1G in the raw data coming from the accelerometer
+
+// LSM303 magnetometer calibration constants; use the Calibrate example from
+// the Pololu LSM303 library to find the right values for your board
+#define M_X_MIN -2942
+#define M_Y_MIN -2995
+#define M_Z_MIN -1628
+#define M_X_MAX 3086
+#define M_Y_MAX 2941
+#define M_Z_MAX 4307
+
+#define Kp_ROLLPITCH 0.02
+#define Ki_ROLLPITCH 0.00002
+#define Kp_YAW 1.2
+#define Ki_YAW 0.00002
+
 #endif /* defined(____ahrs__) */
@@ -0,0 +1,253 @@
+//
+//  ahrs_fixed.cpp
+//
+
+#include "ahrs_fixed.h"
+#include "ahrs.h"
+
+#include <stdlib.h>
+
+namespace {
+    const int32_t c_nOne = 1L << 30; // 1.0 in Q30
+
+    // Gains of ahrs.cpp, folded at compile time
+    const int32_t c_nKpRollPitch = (int32_t)(Kp_ROLLPITCH * (1L << 24) + 0.5);
+    const int32_t c_nKiRollPitch = (int32_t)(Ki_ROLLPITCH * (1L << 30) + 0.5);
+    const int32_t c_nKpYaw = (int32_t)(Kp_YAW * (1L << 20) + 0.5);
+    const int32_t c_nKiYaw = (int32_t)(Ki_YAW * (1L << 30) + 0.5);
+
+    // Upper half of Q30 value, i.e., Q14
+    inline int16_t hi(int32_t n) {
+        return (int16_t)((n + 0x8000) >> 16);
+    }
+
+    inline int16_t saturate16(int32_t n) {
+        return n < -32767 ? -32767 : (32767 < n ? 32767 : (int16_t)n);
+    }
+
+    inline int32_t mul(int16_t a, int16_t b) {
+        return (int32_t)a * b;
+    }
+
+    // Binary angle to 1/1000 radians
+    inline int toMilliRadians(int16_t nAngle) {
+        return (int)(((int32_t)nAngle * 25133 + (1L << 17)) >> 18); // 25133 / 2^18 ~ pi / 32.768
+    }
+}
+
+int16_t atan2Fixed(int32_t nY, int32_t nX) {
+    if(0==nX && 0==nY) return 0;
+
+    int32_t nAbsX = labs(nX);
+    int32_t nAbsY = labs(nY);
+    while(32767 < nAbsX || 32767 < nAbsY) {
+        nAbsX >>= 1;
+        nAbsY >>= 1;
+    }
+
+    // atan(z) ~ pi/4 z - z (z - 1) (0.2447 + 0.0663 z) for 0 <= z <= 1, max. error 0.0015 rad
+    bool const bSwap = nAbsX < nAbsY;
+    int32_t const nZ = bSwap ? (nAbsX << 15) / nAbsY : (nAbsY << 15) / nAbsX; // Q15
+    int32_t const nT = (nZ * (32768 - nZ)) >> 15;
+    int32_t const nP = 2552 + ((691 * nZ) >> 15); // 0.2447 and 0.0663 as binary angles
+    int32_t nAngle = (nZ >> 2) + ((nT * nP) >> 15); // pi/4 = 8192
+
+    if(bSwap) nAngle = 16384 - nAngle;
+    if(nX < 0) nAngle = 32768 - nAngle;
+    if(nY < 0) nAngle = -nAngle;
+    return (int16_t)(uint16_t)nAngle; // 32768 wraps to -pi
+}
+
+int16_t sinFixed(int16_t nAngle) {
+    int32_t nX = nAngle;
+    bool const bNegative = nX < 0;
+    if(bNegative) nX = -nX;
+    if(16384 < nX) nX = 32768 - nX;
+
+    // sin(pi/2 t) ~ t (1.5707963 - t^2 (0.6435838 - 0.0727780 t^2)) for 0 <= t <= 1, max. error 0.0002
+    int32_t const nT = nX << 1; // Q15
+    int32_t const nT2 = (nT * nT) >> 15;
+    int32_t const nA = 21089 - ((nT2 * 2385) >> 15);
+    int32_t const nB = 51472 - ((nT2 * nA) >> 15);
+    int32_t nSin = (nT * nB) >> 15;
+    if(32767 < nSin) nSin = 32767;
+    return (int16_t)(bNegative ? -nSin : nSin);
+}
+
+int16_t cosFixed(int16_t nAngle) {
+    return sinFixed((int16_t)(uint16_t)(nAngle + 16384));
+}
+
+uint16_t sqrtFixed(uint32_t n) {
+    uint32_t nRoot = 0;
+    uint32_t nBit = 1UL << 30;
+    while(n < nBit) nBit >>= 2;
+    while(0 != nBit) {
+        if(nRoot + nBit <= n) {
+            n -= nRoot + nBit;
+            nRoot = (nRoot >> 1) + nBit;
+        } else {
+            nRoot >>= 1;
+        }
+        nBit >>= 2;
+    }
+    return (uint16_t)nRoot;
+}
+
+SDcmFixed::SDcmFixed()
+    : m_nHeading(0), m_nRoll(0), m_nPitch(0), m_nYaw(0)
+{
+    for(int x=0; x<3; ++x) {
+        for(int y=0; y<3; ++y) {
+            m_aanDcm[x][y] = x==y ? c_nOne : 0;
+        }
+        m_anOmegaP[x] = 0;
+        m_anOmegaI[x] = 0;
+    }
+}
+
+void SDcmFixed::update(int nGyroX, int nGyroY, int nGyroZ, int nAccelX, int nAccelY, int nAccelZ, unsigned int nDtMillis) {
+    integrate(nGyroX, nGyroY, nGyroZ, nDtMillis);
+    normalize();
+    correctDrift(nAccelX, nAccelY, nAccelZ);
+    eulerAngles();
+}
+
+void SDcmFixed::updateHeading(int nMagX, int nMagY, int nMagZ) {
+    int16_t const nCosRoll = cosFixed(m_nRoll);
+    int16_t const nSinRoll = sinFixed(m_nRoll);
+    int16_t const nCosPitch = cosFixed(m_nPitch);
+    int16_t const nSinPitch = sinFixed(m_nPitch);
+
+    // adjust for LSM303 compass axis offsets/sensitivity differences by scaling to +/-0.5 range, Q15
+    int16_t const nMx = saturate16((int32_t)(nMagX - SENSOR_SIGN[6]*M_X_MIN) * 32768 / (M_X_MAX - M_X_MIN) - SENSOR_SIGN[6]*16384);
+    int16_t const nMy = saturate16((int32_t)(nMagY - SENSOR_SIGN[7]*M_Y_MIN) * 32768 / (M_Y_MAX - M_Y_MIN) - SENSOR_SIGN[7]*16384);
+    int16_t const nMz = saturate16((int32_t)(nMagZ - SENSOR_SIGN[8]*M_Z_MIN) * 32768 / (M_Z_MAX - M_Z_MIN) - SENSOR_SIGN[8]*16384);
+
+    // Tilt compensated magnetic field
+    int32_t const nMagHeadingX = (mul(nMx, nCosPitch) >> 15)
+        + (mul(saturate16(mul(nMy, nSinRoll) >> 15), nSinPitch) >> 15)
+        + (mul(saturate16(mul(nMz, nCosRoll) >> 15), nSinPitch) >> 15);
+    int32_t const nMagHeadingY = (mul(nMy, nCosRoll) >> 15) - (mul(nMz, nSinRoll) >> 15);
+    m_nHeading = atan2Fixed(-nMagHeadingY, nMagHeadingX);
+}
+
+void SDcmFixed::integrate(int nGyroX, int nGyroY, int nGyroZ, unsigned int nDtMillis) {
+    if(1000 < nDtMillis) nDtMillis = 1000;
+
+    // Rotation during nDtMillis in Q15 radians.
+    // Gyro: 0.07 deg/s per digit, i.e., digits * ms * 0.0400337
+    int const anGyro[3] = {nGyroX, nGyroY, nGyroZ};
+    int16_t anTheta[3];
+    for(int i=0; i<3; ++i) {
+        int32_t const nTheta = (((int32_t)anGyro[i] * (int32_t)nDtMillis * 41) >> 10)
+            + ((m_anOmegaI[i] + m_anOmegaP[i]) >> 8) * (int32_t)nDtMillis / 32000; // Q28 rad/s -> Q15 rad
+        anTheta[i] = nTheta < -16384 ? -16384 : (16384 < nTheta ? 16384 : (int16_t)nTheta);
+    }
+
+    // DCM += DCM * Update_Matrix, Update_Matrix is skew symmetric
+    for(int x=0; x<3; ++x) {
+        int16_t const h0 = hi(m_aanDcm[x][0]);
+        int16_t const h1 = hi(m_aanDcm[x][1]);
+        int16_t const h2 = hi(m_aanDcm[x][2]);
+        m_aanDcm[x][0] += (mul(h1, anTheta[2]) - mul(h2, anTheta[1])) << 1; // Q29 -> Q30
+        m_aanDcm[x][1] += (mul(h2, anTheta[0]) - mul(h0, anTheta[2])) << 1;
+        m_aanDcm[x][2] += (mul(h0, anTheta[1]) - mul(h1, anTheta[0])) << 1;
+    }
+}
+
+void SDcmFixed::normalize() {
+    int16_t ah0[3], ah1[3];
+    for(int c=0; c<3; ++c) {
+        ah0[c] = hi(m_aanDcm[0][c]);
+        ah1[c] = hi(m_aanDcm[1][c]);
+    }
+
+    // eq. 19, error is small, Q22
+    int32_t nDot = 0;
+    for(int c=0; c<3; ++c) nDot += mul(ah0[c], ah1[c]); // Q28
+    int16_t const nError = saturate16(-(nDot >> 7));
+
+    int32_t aanTemp[3][3];
+    for(int c=0; c<3; ++c) {
+        aanTemp[0][c] = m_aanDcm[0][c] + (mul(nError, ah1[c]) >> 6); // Q36 -> Q30
+        aanTemp[1][c] = m_aanDcm[1][c] + (mul(nError, ah0[c]) >> 6);
+    }
+
+    // eq. 20
+    int16_t at0[3], at1[3];
+    for(int c=0; c<3; ++c) {
+        at0[c] = hi(aanTemp[0][c]);
+        at1[c] = hi(aanTemp[1][c]);
+    }
+    aanTemp[2][0] = (mul(at0[1], at1[2]) - mul(at0[2], at1[1])) << 2; // Q28 -> Q30
+    aanTemp[2][1] = (mul(at0[2], at1[0]) - mul(at0[0], at1[2])) << 2;
+    aanTemp[2][2] = (mul(at0[0], at1[1]) - mul(at0[1], at1[0])) << 2;
+
+    // eq. 21, renorm = 1 + (1 - |t|^2) / 2
+    for(int x=0; x<3; ++x) {
+        int16_t at[3];
+        int32_t nSqr = 0;
+        for(int c=0; c<3; ++c) {
+            at[c] = hi(aanTemp[x][c]);
+            nSqr += mul(at[c], at[c]); // Q28
+        }
+        int16_t const nRenorm = saturate16(((1L << 28) - nSqr) >> 7); // Q22
+        for(int c=0; c<3; ++c) {
+            m_aanDcm[x][c] = aanTemp[x][c] + (mul(nRenorm, at[c]) >> 6);
+        }
+    }
+}
+
+void SDcmFixed::correctDrift(int nAccelX, int nAccelY, int nAccelZ) {
+    // Dynamic weighting of accelerometer info (reliability filter)
+    // Weight for accelerometer info (<0.5G = 0.0, 1G = 1.0 , >1.5G = 0.0), Q15
+    int32_t const nAccelMagnitude = sqrtFixed((uint32_t)((int32_t)nAccelX*nAccelX + (int32_t)nAccelY*nAccelY + (int32_t)nAccelZ*nAccelZ));
+    int32_t nWeight = 32768 - labs(nAccelMagnitude - GRAVITY) * (32768 / GRAVITY) * 2;
+    nWeight = nWeight < 0 ? 0 : (32767 < nWeight ? 32767 : nWeight);
+
+    int16_t ah2[3];
+    for(int c=0; c<3; ++c) ah2[c] = hi(m_aanDcm[2][c]);
+
+    // Roll and pitch, error in accelerometer digits, Q14
+    int32_t const anErrorRollPitch[3] = {
+        (int32_t)nAccelY * ah2[2] - (int32_t)nAccelZ * ah2[1],
+        (int32_t)nAccelZ * ah2[0] - (int32_t)nAccelX * ah2[2],
+        (int32_t)nAccelX * ah2[1] - (int32_t)nAccelY * ah2[0]
+    };
+    for(int i=0; i<3; ++i) {
+        int64_t const nWeighted = (int64_t)anErrorRollPitch[i] * nWeight; // Q29
+        m_anOmegaP[i] = (int32_t)((nWeighted * c_nKpRollPitch) >> 25);
+        m_anOmegaI[i] += (int32_t)((nWeighted * c_nKiRollPitch) >> 31);
+    }
+
+    // Yaw, drift correction based on compass magnetic heading
+    int16_t const nMagHeadingX = cosFixed(m_nHeading);
+    int16_t const nMagHeadingY = sinFixed(m_nHeading);
+    int16_t const nErrorCourse = saturate16((mul(hi(m_aanDcm[0][0]), nMagHeadingY) - mul(hi(m_aanDcm[1][0]), nMagHeadingX)) >> 15); // Q14
+    for(int i=0; i<3; ++i) {
+        int32_t const nErrorYaw = mul(ah2[i], nErrorCourse); // Q28
+        m_anOmegaP[i] += (int32_t)(((int64_t)nErrorYaw * c_nKpYaw) >> 20);
+        m_anOmegaI[i] += (int32_t)(((int64_t)nErrorYaw * c_nKiYaw) >> 30);
+    }
+}
+
+void SDcmFixed::eulerAngles() {
+    int32_t const nSinPitch = hi(m_aanDcm[2][0]);
+    int32_t const nSqr = (1L << 28) - nSinPitch * nSinPitch;
+    m_nPitch = -atan2Fixed(nSinPitch, sqrtFixed(nSqr < 0 ? 0 : (uint32_t)nSqr)); // -asin
+    m_nRoll = atan2Fixed(hi(m_aanDcm[2][1]), hi(m_aanDcm[2][2]));
+    m_nYaw = atan2Fixed(hi(m_aanDcm[1][0]), hi(m_aanDcm[0][0]));
+}
+
+int SDcmFixed::roll() const {
+    return toMilliRadians(m_nRoll);
+}
+
+int SDcmFixed::pitch() const {
+    return toMilliRadians(m_nPitch);
+}
+
+int SDcmFixed::yaw() const {
+    return toMilliRadians(m_nYaw);
+}
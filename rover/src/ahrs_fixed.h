@@ -0,0 +1,49 @@
+//
+//  ahrs_fixed.h
+//
+//  Fixed-point version of the DCM filter in ahrs.cpp. The AVR has no FPU,
+//  the float filter spends most of updateAHRS in software floating point.
+//
+//  The direction cosine matrix is kept in Q30, all products are 16 x 16 bit
+//  multiplications of the upper halves (Q14) with 32 bit results. Angles are
+//  binary angles, i.e., 32768 = pi.
+//
+
+#ifndef ahrs_fixed_h
+#define ahrs_fixed_h
+
+#include <stdint.h>
+
+struct SDcmFixed {
+    SDcmFixed();
+
+    // Corrected sensor readings as in ahrs.cpp: gyro_x, accel_x etc., nDtMillis since last update
+    void update(int nGyroX, int nGyroY, int nGyroZ, int nAccelX, int nAccelY, int nAccelZ, unsigned int nDtMillis);
+    // Corrected magnetometer readings magnetom_x etc., call before update
+    void updateHeading(int nMagX, int nMagY, int nMagZ);
+
+    // in 1/1000 radians, like g_nRoll etc.
+    int roll() const;
+    int pitch() const;
+    int yaw() const;
+
+private:
+    void integrate(int nGyroX, int nGyroY, int nGyroZ, unsigned int nDtMillis);
+    void normalize();
+    void correctDrift(int nAccelX, int nAccelY, int nAccelZ);
+    void eulerAngles();
+
+    int32_t m_aanDcm[3][3]; // Q30
+    int32_t m_anOmegaP[3]; // Q28 rad/s
+    int32_t m_anOmegaI[3]; // Q28 rad/s
+    int16_t m_nHeading; // magnetic heading, binary angle
+    int16_t m_nRoll, m_nPitch, m_nYaw; // binary angles
+};
+
+// Fixed-point helpers, binary angles
+int16_t atan2Fixed(int32_t nY, int32_t nX);
+int16_t sinFixed(int16_t nAngle); // Q15
+int16_t cosFixed(int16_t nAngle); // Q15
+uint16_t sqrtFixed(uint32_t n);
+
+#endif /* ahrs_fixed_h */
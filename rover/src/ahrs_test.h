@@ -11,8 +11,12 @@ void loop() {
         }
         bFirstRun = false;
     } else if(updateAHRS()) {
-        
+#if defined(AHRS_RECORD) // raw samples for rover/host/ahrs_benchmark
+        snprintf(report, sizeof(report), "%lu,%d,%d,%d,%d,%d,%d,%d,%d,%d", millis(),
+                 gyro.g.x, gyro.g.y, gyro.g.z, compass.a.x, compass.a.y, compass.a.z, compass.m.x, compass.m.y, compass.m.z);
+#else
         snprintf(report, sizeof(report), "roll: %+6d pitch: %+6d yaw: %+6d", g_nRoll, g_nPitch, g_nYaw);
+#endif
         Serial.println(report);
     }
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 // #define PID_TEST
 // #define CALIBRATE
 // #define AHRS_TEST
+// #define AHRS_RECORD // with AHRS_TEST, print raw IMU samples instead of angles
+// #define SONAR_PULSEIN // blocking sonar ranging for sonar echo pins wired to 32, 36, 40
 
 static const int MAX_SPEED = 500; // max encoder ticks per second
 
@@ -128,11 +130,20 @@ struct SSonar {
     const int ANGLE; // 0: front, 90: left, -90 right
 };
 
+#if defined(SONAR_PULSEIN)
 SSonar g_asonar[] = {
     { 32, 34, 90 },
     { 36, 38, 0 },
     { 40, 42, -90 }
 };
+#else
+// Echo pins must support pin change interrupts, see pins.txt
+SSonar g_asonar[] = {
+    { A8, 34, 90 },
+    { A9, 38, 0 },
+    { A10, 42, -90 }
+};
+#endif
 
 #define countof(a) (sizeof(a)/sizeof(a[0]))
 
@@ -159,6 +170,11 @@ void setup()
         pinMode(g_asonar[i].TRIGGER, OUTPUT);
         pinMode(g_asonar[i].ECHO, INPUT);
     }
+#if !defined(SONAR_PULSEIN)
+    // A8 - A10 are PCINT16 - PCINT18
+    PCMSK2 |= _BV(PCINT16) | _BV(PCINT17) | _BV(PCINT18);
+    PCICR |= _BV(PCIE2);
+#endif
     
     // Motor setup
     for(int i=0; i<countof(g_amotors); ++i) {
@@ -266,35 +282,116 @@ struct SPerformanceCounter {
     }
 };
 
+// Sonar readings collected for the next sensor packet
+SSensorPacket g_packet = {c_nSensorPacketVersion, 0};
+unsigned long g_anReadingTime[c_cMaxSonarReadings]; // micros() when each sonar was triggered
+unsigned long g_nLastPacket = 0; // millis() when last packet was sent
+
+void StartSensorPacket() {
+    g_packet.m_cReadings = 0;
+    g_nLastPacket = millis();
+}
+
+void AddSonarReading(int nAngle, unsigned long nEchoMicros, unsigned long nTriggerTime) {
+    SSonarReading& reading = g_packet.m_areading[g_packet.m_cReadings];
+    reading.m_nAngle = nAngle;
+    reading.m_nDistance = (int)((nEchoMicros / 58.0) + 0.5); // in cm
+    g_anReadingTime[g_packet.m_cReadings] = nTriggerTime;
+    ++g_packet.m_cReadings;
+}
+
 int g_iSonar = 0;
+static const unsigned long c_nSonarTimeout = 20000; // us, ~ 3.4 m
+
+#if defined(SONAR_PULSEIN)
+void UpdateSonar() {
+    digitalWrite(g_asonar[g_iSonar].TRIGGER, HIGH);
+    delayMicroseconds(10);
+    digitalWrite(g_asonar[g_iSonar].TRIGGER, LOW);
+    unsigned long const nTriggerTime = micros();
+    AddSonarReading(g_asonar[g_iSonar].ANGLE, pulseIn(g_asonar[g_iSonar].ECHO, HIGH, c_nSonarTimeout), nTriggerTime); // ~ 20 ms
+    
+    g_iSonar = (g_iSonar + 1) % countof(g_asonar);
+}
+#else
+// The sonars are triggered one after the other, so they don't pick up each other's echoes.
+// The echo pulse is timed by the pin change interrupt, the loop never waits for it.
+static const unsigned long c_nSonarInterval = 10000; // us, minimum time between two triggers
+
+volatile bool g_bSonarActive = false; // waiting for echo of g_asonar[g_iSonar]
+volatile unsigned long g_nEchoStart = 0; // micros() at rising edge of echo pulse, 0 if none yet
+volatile unsigned long g_nEchoDuration; // valid if g_bEchoDone
+volatile bool g_bEchoDone = false;
+unsigned long g_nTriggerTime = 0; // micros()
+
+ISR(PCINT2_vect) {
+    if(!g_bSonarActive || g_bEchoDone) return;
+    
+    unsigned long const nNow = micros();
+    if(HIGH==digitalRead(g_asonar[g_iSonar].ECHO)) {
+        if(0==g_nEchoStart) g_nEchoStart = nNow;
+    } else if(0!=g_nEchoStart) {
+        g_nEchoDuration = nNow - g_nEchoStart;
+        g_bEchoDone = true;
+    }
+}
+
+void UpdateSonar() {
+    unsigned long const nNow = micros();
+    if(g_bSonarActive) {
+        unsigned long nEchoMicros;
+        if(g_bEchoDone) {
+            noInterrupts();
+            nEchoMicros = g_nEchoDuration;
+            interrupts();
+        } else if(c_nSonarTimeout < nNow - g_nTriggerTime) {
+            nEchoMicros = 0; // no echo, like pulseIn
+        } else {
+            return;
+        }
+        g_bSonarActive = false;
+        AddSonarReading(g_asonar[g_iSonar].ANGLE, nEchoMicros, g_nTriggerTime);
+        g_iSonar = (g_iSonar + 1) % countof(g_asonar);
+    }
+    
+    if(c_nSonarInterval <= nNow - g_nTriggerTime) {
+        g_nEchoStart = 0;
+        g_bEchoDone = false;
+        digitalWrite(g_asonar[g_iSonar].TRIGGER, HIGH);
+        delayMicroseconds(10);
+        digitalWrite(g_asonar[g_iSonar].TRIGGER, LOW);
+        g_nTriggerTime = micros();
+        g_bSonarActive = true;
+    }
+}
+#endif
+
 void SendSensorData() {
     // TODO: Optimize order in which we accumulate sensor data
     // so sensor data is consistent with each other
     // TODO: Transmit current or make emergency stop if motor current too high
     
-    int nDistance; // in cm
-    int nAngle;
-    {
-        digitalWrite(g_asonar[g_iSonar].TRIGGER, HIGH);
-        delayMicroseconds(10);
-        digitalWrite(g_asonar[g_iSonar].TRIGGER, LOW);
-        unsigned long t = pulseIn(g_asonar[g_iSonar].ECHO, 20000);
-        nDistance = (int)((t / 58.0) + 0.5);
-        nAngle = g_asonar[g_iSonar].ANGLE;
-        
-        g_iSonar = (g_iSonar + 1) % countof(g_asonar);
-    } // ~ 20 ms
+    UpdateSonar();
+    
+    // Collect several readings per BLE write, send at the latest after c_nMaxPacketDuration
+    unsigned long const nNow = millis();
+    if(0==g_packet.m_cReadings) return;
+    if(g_packet.m_cReadings < c_cMaxSonarReadings && nNow - g_nLastPacket < c_nMaxPacketDuration) return;
+    
+    g_packet.m_ecmdLast = g_cmdLastCommand.m_cmd;
+    for(int i=0; i<4; ++i) {
+        g_packet.m_anEncoderTicks[i] = g_amotors[i].Pop();
+    }
+    g_packet.m_nTime = micros();
+    g_packet.m_nYaw = g_nYaw;
+    g_packet.m_nYawAge = sensorAge(g_packet.m_nTime, g_nYawTime);
+    for(int i=0; i<g_packet.m_cReadings; ++i) {
+        g_packet.m_areading[i].m_nAge = sensorAge(g_packet.m_nTime, g_anReadingTime[i]);
+    }
+    ble_write_bytes((byte*)&g_packet, sensorPacketSize(g_packet.m_cReadings));
     
-    SSensorData data = {
-        g_nYaw,
-        nAngle, nDistance,
-        g_amotors[0].Pop(),
-        g_amotors[1].Pop(),
-        g_amotors[2].Pop(),
-        g_amotors[3].Pop(),
-        g_cmdLastCommand.m_cmd
-    };
-    ble_write_bytes((byte*)&data, sizeof(data));
+    g_packet.m_cReadings = 0;
+    g_nLastPacket = nNow;
 }
 
 #if defined(PID_TEST)
@@ -316,6 +413,7 @@ void loop()
         g_bConnected=ble_connected();
         if(g_bConnected) {
             OnConnection();
+            StartSensorPacket();
         } else {
             g_cmdLastCommand = c_rcmdStop;
             OnDisconnection();
@@ -365,7 +463,7 @@ void loop()
         for(int i=0; i<countof(g_amotors); ++i) {
             g_amotors[i].ComputePID(g_apid[i]); // effective sample time ~ 130 ms
         }
-        SendSensorData(); // ~ 40 ms
+        SendSensorData(); // ~ 20 ms with SONAR_PULSEIN, otherwise doesn't block
     }
     
     ble_do_events();
@@ -3,6 +3,8 @@
 
 #include <math.h>
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef short ECommand; // force enum to be 2 bytes for Swift - AVR GCC interop
 const short ecmdSTOP = 0x0;
@@ -60,6 +62,47 @@ struct SSensorData { // must be < 64 bytes
     ECommand m_ecmdLast; // send last processed command so the controller can check when the turn is completed
 };
 
+// Sensor packet, protocol version 2
+// Carries several sonar readings, so the rover can take sonar readings faster than it
+// can send packets. Only the first m_cReadings readings are transmitted, i.e.,
+// packets are sensorPacketSize(m_cReadings) bytes long and never as long as SSensorData.
+// All fields are naturally aligned, so the layout is the same on the AVR and the host.
+//
+// Every field group carries the micros() at which it was sampled on the rover, so the
+// controller can insert each reading at the pose the rover had at that moment.
+// Ages are given in c_nAgeUnit us relative to m_nTime, i.e., up to ~ 260 ms.
+enum { c_cMaxSonarReadings = 7 };
+const unsigned char c_nSensorPacketVersion = 2;
+const unsigned short c_nMaxPacketDuration = 100; // ms, send packet at the latest after this time
+const unsigned short c_nAgeUnit = 4; // us, resolution of micros() on a 16 MHz AVR
+
+struct SSonarReading {
+    unsigned short m_nAge; // between the sonar trigger and m_nTime
+    short m_nAngle; // sonar sensor angle
+    short m_nDistance; // in cm
+};
+
+struct SSensorPacket { // must be < 64 bytes
+    unsigned char m_nVersion; // c_nSensorPacketVersion
+    unsigned char m_cReadings; // 1 <= m_cReadings <= c_cMaxSonarReadings
+    ECommand m_ecmdLast;
+    uint32_t m_nTime; // micros() when the encoder ticks were read, i.e., end of the packet
+    short m_nYaw;
+    unsigned short m_nYawAge; // between the AHRS update that measured m_nYaw and m_nTime
+    short m_anEncoderTicks[4]; // accumulated since the previous packet
+    struct SSonarReading m_areading[c_cMaxSonarReadings];
+};
+
+inline unsigned int sensorPacketSize(unsigned char cReadings) {
+    return offsetof(struct SSensorPacket, m_areading) + cReadings * sizeof(struct SSonarReading);
+}
+
+// Age in c_nAgeUnit of a time nMicros before nTime, saturated
+inline unsigned short sensorAge(uint32_t nTime, uint32_t nMicros) {
+    uint32_t const nAge = (nTime - nMicros) / c_nAgeUnit;
+    return nAge < 0xFFFF ? (unsigned short)nAge : 0xFFFF;
+}
+
 inline double yawToRadians(short nYaw) {
     return -nYaw/1000.0; // on-board yaw measurement is flipped, i.e. not in counter-clockwise direction
 }
@@ -69,6 +112,7 @@ const int c_nRobotWidth = 30; // cm
 const int c_nRobotHeight = 30; // cm
 
 const int c_nWheelRadius = 6; // cm
+const double c_fTrackWidth = 19.0; // cm, distance between left and right tracks
 
 // Distance from robot center in cm
 // for sensor with -90, 0, 90.